@@ -202,6 +202,7 @@ nir_shader_create(void *mem_ctx,
 #ifndef NDEBUG
    nir_process_debug_variable();
 #endif
+   nir_pass_stats_init();
 
    exec_list_make_empty(&shader->variables);
 
@@ -552,6 +553,8 @@ nir_function_impl_create_bare(nir_shader *shader)
    impl->num_blocks = 0;
    impl->valid_metadata = nir_metadata_none;
    impl->structured = true;
+   impl->change_seq = 1;
+   memset(impl->clean_seq, 0, sizeof(impl->clean_seq));
 
    /* create start & end blocks */
    nir_block *start_block = nir_block_create(shader);
@@ -654,8 +657,9 @@ nir_loop_create(nir_shader *shader)
 }
 
 static void
-instr_init(nir_instr *instr, nir_instr_type type)
+instr_init(nir_shader *shader, nir_instr *instr, nir_instr_type type)
 {
+   shader->num_instrs_allocated++;
    instr->type = type;
    instr->block = NULL;
    exec_node_init(&instr->node);
@@ -675,7 +679,7 @@ nir_alu_instr_create(nir_shader *shader, nir_op op)
    unsigned num_srcs = nir_op_infos[op].num_inputs;
    nir_alu_instr *instr = gc_zalloc_zla(shader->gctx, nir_alu_instr, nir_alu_src, num_srcs);
 
-   instr_init(&instr->instr, nir_instr_type_alu);
+   instr_init(shader, &instr->instr, nir_instr_type_alu);
    instr->op = op;
    for (unsigned i = 0; i < num_srcs; i++)
       alu_src_init(&instr->src[i]);
@@ -688,7 +692,7 @@ nir_deref_instr_create(nir_shader *shader, nir_deref_type deref_type)
 {
    nir_deref_instr *instr = gc_zalloc(shader->gctx, nir_deref_instr, 1);
 
-   instr_init(&instr->instr, nir_instr_type_deref);
+   instr_init(shader, &instr->instr, nir_instr_type_deref);
 
    instr->deref_type = deref_type;
    if (deref_type != nir_deref_type_var)
@@ -705,7 +709,7 @@ nir_jump_instr *
 nir_jump_instr_create(nir_shader *shader, nir_jump_type type)
 {
    nir_jump_instr *instr = gc_alloc(shader->gctx, nir_jump_instr, 1);
-   instr_init(&instr->instr, nir_instr_type_jump);
+   instr_init(shader, &instr->instr, nir_instr_type_jump);
    src_init(&instr->condition);
    instr->type = type;
    instr->target = NULL;
@@ -720,7 +724,7 @@ nir_load_const_instr_create(nir_shader *shader, unsigned num_components,
 {
    nir_load_const_instr *instr =
       gc_zalloc_zla(shader->gctx, nir_load_const_instr, nir_const_value, num_components);
-   instr_init(&instr->instr, nir_instr_type_load_const);
+   instr_init(shader, &instr->instr, nir_instr_type_load_const);
 
    nir_def_init(&instr->instr, &instr->def, num_components, bit_size);
 
@@ -734,7 +738,7 @@ nir_intrinsic_instr_create(nir_shader *shader, nir_intrinsic_op op)
    nir_intrinsic_instr *instr =
       gc_zalloc_zla(shader->gctx, nir_intrinsic_instr, nir_src, num_srcs);
 
-   instr_init(&instr->instr, nir_instr_type_intrinsic);
+   instr_init(shader, &instr->instr, nir_instr_type_intrinsic);
    instr->intrinsic = op;
 
    for (unsigned i = 0; i < num_srcs; i++)
@@ -750,7 +754,7 @@ nir_call_instr_create(nir_shader *shader, nir_function *callee)
    nir_call_instr *instr =
       gc_zalloc_zla(shader->gctx, nir_call_instr, nir_src, num_params);
 
-   instr_init(&instr->instr, nir_instr_type_call);
+   instr_init(shader, &instr->instr, nir_instr_type_call);
    instr->callee = callee;
    instr->num_params = num_params;
    for (unsigned i = 0; i < num_params; i++)
@@ -770,7 +774,7 @@ nir_tex_instr *
 nir_tex_instr_create(nir_shader *shader, unsigned num_srcs)
 {
    nir_tex_instr *instr = gc_zalloc(shader->gctx, nir_tex_instr, 1);
-   instr_init(&instr->instr, nir_instr_type_tex);
+   instr_init(shader, &instr->instr, nir_instr_type_tex);
 
    instr->num_srcs = num_srcs;
    instr->src = gc_alloc(shader->gctx, nir_tex_src, num_srcs);
@@ -834,7 +838,7 @@ nir_phi_instr *
 nir_phi_instr_create(nir_shader *shader)
 {
    nir_phi_instr *instr = gc_alloc(shader->gctx, nir_phi_instr, 1);
-   instr_init(&instr->instr, nir_instr_type_phi);
+   instr_init(shader, &instr->instr, nir_instr_type_phi);
 
    exec_list_make_empty(&instr->srcs);
 
@@ -867,7 +871,7 @@ nir_parallel_copy_instr *
 nir_parallel_copy_instr_create(nir_shader *shader)
 {
    nir_parallel_copy_instr *instr = gc_alloc(shader->gctx, nir_parallel_copy_instr, 1);
-   instr_init(&instr->instr, nir_instr_type_parallel_copy);
+   instr_init(shader, &instr->instr, nir_instr_type_parallel_copy);
 
    exec_list_make_empty(&instr->entries);
 
@@ -880,7 +884,7 @@ nir_undef_instr_create(nir_shader *shader,
                        unsigned bit_size)
 {
    nir_undef_instr *instr = gc_alloc(shader->gctx, nir_undef_instr, 1);
-   instr_init(&instr->instr, nir_instr_type_undef);
+   instr_init(shader, &instr->instr, nir_instr_type_undef);
 
    nir_def_init(&instr->instr, &instr->def, num_components, bit_size);
 
@@ -1112,6 +1116,7 @@ nir_instr_insert(nir_cursor cursor, nir_instr *instr)
 
    nir_function_impl *impl = nir_cf_node_get_function(&instr->block->cf_node);
    impl->valid_metadata &= ~nir_metadata_instr_index;
+   nir_impl_mark_changed(impl);
 }
 
 bool
@@ -1136,6 +1141,32 @@ src_is_valid(const nir_src *src)
    return (src->ssa != NULL);
 }
 
+/* Blocks of CF lists being built or extracted may not be in an impl */
+static void
+block_impl_mark_changed(nir_block *block)
+{
+   nir_cf_node *node = &block->cf_node;
+   while (node && node->type != nir_cf_node_function)
+      node = node->parent;
+
+   if (node)
+      nir_impl_mark_changed(nir_cf_node_as_function(node));
+}
+
+void
+nir_src_mark_changed(const nir_src *src)
+{
+   if (nir_src_is_if(src)) {
+      nir_if *nif = nir_src_parent_if(src);
+      if (nif->cf_node.parent)
+         block_impl_mark_changed(nir_cf_node_as_block(nir_cf_node_prev(&nif->cf_node)));
+   } else {
+      nir_instr *instr = nir_src_parent_instr(src);
+      if (instr->block)
+         block_impl_mark_changed(instr->block);
+   }
+}
+
 static bool
 remove_use_cb(nir_src *src, void *state)
 {
@@ -1158,6 +1189,7 @@ nir_instr_remove_v(nir_instr *instr)
 {
    remove_defs_uses(instr);
    exec_node_remove(&instr->node);
+   block_impl_mark_changed(instr->block);
 
    if (instr->type == nir_instr_type_jump) {
       nir_jump_instr *jump_instr = nir_instr_as_jump(instr);
@@ -1474,6 +1506,8 @@ nir_instr_init_src(nir_instr *instr, nir_src *src, nir_def *def)
 {
    *src = nir_src_for_ssa(def);
    src_add_all_uses(src, instr, NULL);
+   if (instr->block)
+      block_impl_mark_changed(instr->block);
 }
 
 void
@@ -1481,6 +1515,8 @@ nir_instr_clear_src(nir_instr *instr, nir_src *src)
 {
    src_remove_all_uses(src);
    *src = NIR_SRC_INIT;
+   if (instr->block)
+      block_impl_mark_changed(instr->block);
 }
 
 void
@@ -1493,6 +1529,8 @@ nir_instr_move_src(nir_instr *dest_instr, nir_src *dest, nir_src *src)
    *dest = *src;
    *src = NIR_SRC_INIT;
    src_add_all_uses(dest, dest_instr, NULL);
+   if (dest_instr->block)
+      block_impl_mark_changed(dest_instr->block);
 }
 
 void
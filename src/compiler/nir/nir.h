@@ -3215,6 +3215,19 @@ typedef enum {
 } nir_metadata;
 MESA_DEFINE_CPP_ENUM_BITFIELD_OPERATORS(nir_metadata)
 
+/**
+ * Passes which skip a nir_function_impl if it hasn't changed since they
+ * last ran on it without making progress, see nir_function_impl::clean_seq.
+ */
+typedef enum {
+   nir_incremental_pass_copy_prop,
+   nir_incremental_pass_opt_cse,
+   nir_incremental_pass_opt_dce,
+   nir_incremental_pass_opt_dead_cf,
+   nir_incremental_pass_opt_remove_phis,
+   nir_num_incremental_passes,
+} nir_incremental_pass;
+
 typedef struct {
    nir_cf_node cf_node;
 
@@ -3248,6 +3261,19 @@ typedef struct {
    bool structured;
 
    nir_metadata valid_metadata;
+
+   /** Incremented on every change to the impl.
+    *
+    * Instruction insertion and removal and source rewrites through the core
+    * helpers bump it, as do nir_metadata_preserve() called with less than
+    * nir_metadata_all and nir_impl_mark_changed().
+    */
+   uint32_t change_seq;
+
+   /** Value of change_seq when each nir_incremental_pass last ran on the
+    * impl without making progress
+    */
+   uint32_t clean_seq[nir_num_incremental_passes];
 } nir_function_impl;
 
 #define nir_foreach_function_temp_variable(var, impl) \
@@ -3972,6 +3998,11 @@ typedef struct nir_shader_compiler_options {
 typedef struct nir_shader {
    gc_ctx *gctx;
 
+   /** Number of instructions allocated from gctx since it was created,
+    * live or not, see nir_sweep()
+    */
+   unsigned num_instrs_allocated;
+
    /** list of uniforms (nir_variable) */
    struct exec_list variables;
 
@@ -4195,6 +4226,41 @@ nir_function_impl *nir_cf_node_get_function(nir_cf_node *node);
 void nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...);
 /** dirties all but the preserved metadata */
 void nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved);
+
+/** Records a change to impl which may not be reflected in its metadata,
+ * such as a pass reporting progress while preserving all of it.
+ */
+static inline void
+nir_impl_mark_changed(nir_function_impl *impl)
+{
+   impl->change_seq++;
+}
+
+/** Returns true if pass can skip impl because impl hasn't changed since
+ * the last time pass ran on it without making progress.
+ *
+ * Skipped impls count as visited without progress, so this preserves all
+ * metadata.
+ */
+static inline bool
+nir_impl_pass_can_skip(nir_function_impl *impl, nir_incremental_pass pass)
+{
+   if (impl->clean_seq[pass] != impl->change_seq)
+      return false;
+
+   nir_metadata_preserve(impl, nir_metadata_all);
+   return true;
+}
+
+/** To be called by pass after running on impl.  Must come after the
+ * nir_metadata_preserve() of the pass.
+ */
+static inline void
+nir_impl_pass_done(nir_function_impl *impl, nir_incremental_pass pass,
+                   bool progress)
+{
+   impl->clean_seq[pass] = progress ? 0 : impl->change_seq;
+}
 /** Preserves all metadata for the given shader */
 void nir_shader_preserve_all_metadata(nir_shader *shader);
 
@@ -4539,6 +4605,9 @@ bool nir_src_is_always_uniform(nir_src src);
 bool nir_srcs_equal(nir_src src1, nir_src src2);
 bool nir_instrs_equal(const nir_instr *instr1, const nir_instr *instr2);
 
+/** Records a change to src in the change_seq of its function impl */
+void nir_src_mark_changed(const nir_src *src);
+
 static inline void
 nir_src_rewrite(nir_src *src, nir_def *new_ssa)
 {
@@ -4547,6 +4616,7 @@ nir_src_rewrite(nir_src *src, nir_def *new_ssa)
    list_del(&src->use_link);
    src->ssa = new_ssa;
    list_addtail(&src->use_link, &new_ssa->uses);
+   nir_src_mark_changed(src);
 }
 
 /** Initialize a nir_src
@@ -4800,13 +4870,45 @@ should_print_nir(UNUSED nir_shader *shader)
 }
 #endif /* NDEBUG */
 
+/* Flags of NIR_PASS_STATS, see nir_pass_stats.c */
+#define NIR_PASS_STATS_REPORT   (1u << 0)
+#define NIR_PASS_STATS_PERFETTO (1u << 1)
+
+extern uint32_t nir_pass_stats;
+
+struct nir_pass_stats_sample {
+   int64_t start;
+   int64_t end;
+   unsigned instrs;
+   unsigned defs;
+};
+
+void nir_pass_stats_init(void);
+void nir_pass_stats_begin(nir_shader *shader, const char *pass,
+                          struct nir_pass_stats_sample *sample);
+/* called as soon as the pass returns, so validation isn't timed */
+void nir_pass_stats_stop(struct nir_pass_stats_sample *sample);
+/* progress is -1 when unknown */
+void nir_pass_stats_end(nir_shader *shader, const char *pass, const char *file,
+                        int progress, const struct nir_pass_stats_sample *sample);
+
 #define _PASS(pass, nir, do_pass)                                       \
    do {                                                                 \
       if (should_skip_nir(#pass)) {                                     \
          printf("skipping %s\n", #pass);                                \
          break;                                                         \
       }                                                                 \
-      do_pass if (NIR_DEBUG(CLONE))                                     \
+      struct nir_pass_stats_sample _pass_sample;                        \
+      int _pass_progress = -1;                                          \
+      if (unlikely(nir_pass_stats))                                     \
+         nir_pass_stats_begin(nir, #pass, &_pass_sample);               \
+      do_pass if (unlikely(nir_pass_stats))                             \
+      {                                                                 \
+         nir_pass_stats_end(nir, #pass, __FILE__, _pass_progress,       \
+                            &_pass_sample);                             \
+      }                                                                 \
+      (void)_pass_progress;                                             \
+      if (NIR_DEBUG(CLONE))                                             \
       {                                                                 \
          nir_shader *_clone = nir_shader_clone(ralloc_parent(nir), nir);\
          nir_shader_replace(nir, _clone);                               \
@@ -4820,10 +4922,15 @@ should_print_nir(UNUSED nir_shader *shader)
    nir_metadata_set_validation_flag(nir);                       \
    if (should_print_nir(nir))                                   \
       printf("%s\n", #pass);                                    \
-   if (pass(nir, ##__VA_ARGS__)) {                              \
+   _pass_progress = 0;                                          \
+   bool _pass_result = pass(nir, ##__VA_ARGS__);                \
+   if (unlikely(nir_pass_stats))                                \
+      nir_pass_stats_stop(&_pass_sample);                       \
+   if (_pass_result) {                                          \
       nir_validate_shader(nir, "after " #pass " in " __FILE__); \
       UNUSED bool _;                                            \
       progress = true;                                          \
+      _pass_progress = 1;                                       \
       if (should_print_nir(nir))                                \
          nir_print_shader(nir, stdout);                         \
       nir_metadata_check_validation_flag(nir);                  \
@@ -4834,6 +4941,8 @@ should_print_nir(UNUSED nir_shader *shader)
    if (should_print_nir(nir))                                \
       printf("%s\n", #pass);                                 \
    pass(nir, ##__VA_ARGS__);                                 \
+   if (unlikely(nir_pass_stats))                             \
+      nir_pass_stats_stop(&_pass_sample);                    \
    nir_validate_shader(nir, "after " #pass " in " __FILE__); \
    if (should_print_nir(nir))                                \
       nir_print_shader(nir, stdout);                         \
@@ -6227,6 +6336,14 @@ bool nir_opt_ray_query_ranges(nir_shader *shader);
 
 bool nir_opt_reuse_constants(nir_shader *shader);
 
+/** Frees the memory of everything no longer part of the shader.
+ *
+ * If most instructions allocated in the shader are dead, the function impls
+ * are also re-packed, which replaces every nir_function_impl, instruction,
+ * nir_def and function temporary variable with a copy and reindexes the
+ * defs.  Pointers into the IR of the impls and def indices must not be held
+ * across a call.
+ */
 void nir_sweep(nir_shader *shader);
 
 void nir_remap_dual_slot_attributes(nir_shader *shader,
@@ -105,6 +105,8 @@ nir_function_instructions_pass(nir_function_impl *impl,
    }
 
    if (progress) {
+      /* The callback may have changed things no metadata depends on. */
+      nir_impl_mark_changed(impl);
       nir_metadata_preserve(impl, preserved);
    } else {
       nir_metadata_preserve(impl, nir_metadata_all);
@@ -171,6 +173,7 @@ nir_shader_intrinsics_pass(nir_shader *shader,
       }
 
       if (func_progress) {
+         nir_impl_mark_changed(impl);
          nir_metadata_preserve(impl, preserved);
          progress = true;
       } else {
@@ -207,6 +207,7 @@ __clone_def(clone_state *state, nir_instr *ninstr,
             nir_def *ndef, const nir_def *def)
 {
    nir_def_init(ninstr, ndef, def->num_components, def->bit_size);
+   ndef->divergent = def->divergent;
    if (likely(state->remap_table))
       add_remap(state, ndef, def);
 }
@@ -315,6 +316,7 @@ clone_load_const(clone_state *state, const nir_load_const_instr *lc)
                                   lc->def.bit_size);
 
    memcpy(&nlc->value, &lc->value, sizeof(*nlc->value) * lc->def.num_components);
+   nlc->def.divergent = lc->def.divergent;
 
    add_remap(state, &nlc->def, &lc->def);
 
@@ -327,6 +329,7 @@ clone_ssa_undef(clone_state *state, const nir_undef_instr *sa)
    nir_undef_instr *nsa =
       nir_undef_instr_create(state->ns, sa->def.num_components,
                              sa->def.bit_size);
+   nsa->def.divergent = sa->def.divergent;
 
    add_remap(state, &nsa->def, &sa->def);
 
@@ -532,6 +535,7 @@ clone_loop(clone_state *state, struct exec_list *cf_list, const nir_loop *loop)
    nir_loop *nloop = nir_loop_create(state->ns);
    nloop->control = loop->control;
    nloop->partially_unrolled = loop->partially_unrolled;
+   nloop->divergent = loop->divergent;
 
    nir_cf_node_insert_end(cf_list, &nloop->cf_node);
 
@@ -62,6 +62,9 @@ void
 nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved)
 {
    impl->valid_metadata &= preserved;
+
+   if (preserved != nir_metadata_all)
+      nir_impl_mark_changed(impl);
 }
 
 void
@@ -151,6 +151,9 @@ nir_copy_prop_impl(nir_function_impl *impl)
 {
    bool progress = false;
 
+   if (nir_impl_pass_can_skip(impl, nir_incremental_pass_copy_prop))
+      return false;
+
    nir_foreach_block(block, impl) {
       nir_foreach_instr_safe(instr, block) {
          progress |= copy_prop_instr(instr);
@@ -164,6 +167,7 @@ nir_copy_prop_impl(nir_function_impl *impl)
       nir_metadata_preserve(impl, nir_metadata_all);
    }
 
+   nir_impl_pass_done(impl, nir_incremental_pass_copy_prop, progress);
    return progress;
 }
 
@@ -36,6 +36,9 @@ dominates(const nir_instr *old_instr, const nir_instr *new_instr)
 static bool
 nir_opt_cse_impl(nir_function_impl *impl)
 {
+   if (nir_impl_pass_can_skip(impl, nir_incremental_pass_opt_cse))
+      return false;
+
    struct set *instr_set = nir_instr_set_create(NULL);
 
    _mesa_set_resize(instr_set, impl->ssa_alloc);
@@ -56,6 +59,7 @@ nir_opt_cse_impl(nir_function_impl *impl)
    }
 
    nir_instr_set_destroy(instr_set);
+   nir_impl_pass_done(impl, nir_incremental_pass_opt_cse, progress);
    return progress;
 }
 
@@ -223,6 +223,9 @@ nir_opt_dce_impl(nir_function_impl *impl)
 {
    assert(impl->structured);
 
+   if (nir_impl_pass_can_skip(impl, nir_incremental_pass_opt_dce))
+      return false;
+
    BITSET_WORD *defs_live = rzalloc_array(NULL, BITSET_WORD,
                                           BITSET_WORDS(impl->ssa_alloc));
 
@@ -244,6 +247,7 @@ nir_opt_dce_impl(nir_function_impl *impl)
       nir_metadata_preserve(impl, nir_metadata_all);
    }
 
+   nir_impl_pass_done(impl, nir_incremental_pass_opt_dce, progress);
    return progress;
 }
 
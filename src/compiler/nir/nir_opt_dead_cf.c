@@ -395,6 +395,9 @@ dead_cf_list(struct exec_list *list, bool *list_ends_in_jump)
 static bool
 opt_dead_cf_impl(nir_function_impl *impl)
 {
+   if (nir_impl_pass_can_skip(impl, nir_incremental_pass_opt_dead_cf))
+      return false;
+
    bool dummy;
    bool progress = dead_cf_list(&impl->body, &dummy);
 
@@ -416,6 +419,7 @@ opt_dead_cf_impl(nir_function_impl *impl)
       nir_metadata_preserve(impl, nir_metadata_all);
    }
 
+   nir_impl_pass_done(impl, nir_incremental_pass_opt_dead_cf, progress);
    return progress;
 }
 
@@ -144,6 +144,10 @@ static bool
 nir_opt_remove_phis_impl(nir_function_impl *impl)
 {
    bool progress = false;
+
+   if (nir_impl_pass_can_skip(impl, nir_incremental_pass_opt_remove_phis))
+      return false;
+
    nir_builder bld = nir_builder_create(impl);
 
    nir_metadata_require(impl, nir_metadata_dominance);
@@ -159,6 +163,7 @@ nir_opt_remove_phis_impl(nir_function_impl *impl)
       nir_metadata_preserve(impl, nir_metadata_all);
    }
 
+   nir_impl_pass_done(impl, nir_incremental_pass_opt_remove_phis, progress);
    return progress;
 }
 
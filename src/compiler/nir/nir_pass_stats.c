@@ -0,0 +1,235 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Per pass compile time statistics, enabled with NIR_PASS_STATS.
+ *
+ * Every pass run through NIR_PASS or NIR_PASS_V records its wall time, if
+ * it made progress and how much it changed the number of instructions and
+ * SSA defs.  The numbers are aggregated per pass, shader stage and the
+ * directory of the file running the pass, which tells the drivers apart,
+ * and printed sorted by time at exit.  Passes can also be emitted as
+ * perfetto slices.
+ */
+
+#include <inttypes.h>
+
+#include "nir.h"
+#include "c11/threads.h"
+#include "util/hash_table.h"
+#include "util/os_time.h"
+#include "util/simple_mtx.h"
+#include "util/u_debug.h"
+#include "util/perf/cpu_trace.h"
+
+uint32_t nir_pass_stats = 0;
+
+static const struct debug_named_value nir_pass_stats_control[] = {
+   { "report", NIR_PASS_STATS_REPORT,
+     "Print the time spent in and changes made by each pass at exit" },
+   { "perfetto", NIR_PASS_STATS_PERFETTO,
+     "Emit a perfetto slice for each pass" },
+   DEBUG_NAMED_VALUE_END
+};
+
+DEBUG_GET_ONCE_FLAGS_OPTION(nir_pass_stats, "NIR_PASS_STATS", nir_pass_stats_control, 0)
+
+struct pass_stats {
+   const char *pass;
+   const char *file;
+   /* length of the directory part of file */
+   unsigned dir_len;
+   gl_shader_stage stage;
+
+   uint64_t calls;
+   uint64_t progress;
+   /* calls through NIR_PASS_V, where progress is not known */
+   uint64_t unknown;
+   int64_t time_ns;
+   int64_t instr_delta;
+   int64_t def_delta;
+};
+
+static simple_mtx_t stats_lock = SIMPLE_MTX_INITIALIZER;
+static struct hash_table *stats_table;
+
+static uint32_t
+pass_stats_hash(const void *key)
+{
+   const struct pass_stats *stats = key;
+   uint32_t hash = _mesa_hash_string(stats->pass);
+   hash = _mesa_hash_data_with_seed(stats->file, stats->dir_len, hash);
+   return _mesa_hash_data_with_seed(&stats->stage, sizeof(stats->stage), hash);
+}
+
+static bool
+pass_stats_equal(const void *a, const void *b)
+{
+   const struct pass_stats *sa = a, *sb = b;
+   return sa->stage == sb->stage &&
+          sa->dir_len == sb->dir_len &&
+          !strcmp(sa->pass, sb->pass) &&
+          !memcmp(sa->file, sb->file, sa->dir_len);
+}
+
+static int
+pass_stats_compare(const void *a, const void *b)
+{
+   const struct pass_stats *sa = *(const struct pass_stats **)a;
+   const struct pass_stats *sb = *(const struct pass_stats **)b;
+   if (sa->time_ns != sb->time_ns)
+      return sa->time_ns < sb->time_ns ? 1 : -1;
+   return strcmp(sa->pass, sb->pass);
+}
+
+static void
+nir_pass_stats_report(void)
+{
+   simple_mtx_lock(&stats_lock);
+
+   unsigned count = stats_table ? _mesa_hash_table_num_entries(stats_table) : 0;
+   struct pass_stats **sorted = malloc(count * sizeof(*sorted));
+   if (!sorted)
+      count = 0;
+
+   unsigned i = 0;
+   int64_t total_ns = 0;
+   if (count) {
+      hash_table_foreach(stats_table, entry) {
+         sorted[i++] = (struct pass_stats *)entry->key;
+         total_ns += ((struct pass_stats *)entry->key)->time_ns;
+      }
+      qsort(sorted, count, sizeof(*sorted), pass_stats_compare);
+   }
+
+   fprintf(stderr, "NIR pass statistics, %.3f ms in total:\n", total_ns / 1e6);
+   fprintf(stderr, "%10s %6s %8s %9s %10s %10s  %-6s %-32s %s\n",
+           "time (ms)", "%", "calls", "progress", "instrs", "defs",
+           "stage", "component", "pass");
+   for (i = 0; i < count; i++) {
+      const struct pass_stats *stats = sorted[i];
+      char progress[24];
+      if (stats->unknown == stats->calls)
+         snprintf(progress, sizeof(progress), "-");
+      else
+         snprintf(progress, sizeof(progress), "%" PRIu64, stats->progress);
+
+      fprintf(stderr, "%10.3f %6.2f %8" PRIu64 " %9s %+10" PRId64 " %+10" PRId64 "  %-6s %-32.*s %s\n",
+              stats->time_ns / 1e6,
+              total_ns ? stats->time_ns * 100.0 / total_ns : 0.0,
+              stats->calls, progress, stats->instr_delta, stats->def_delta,
+              _mesa_shader_stage_to_abbrev(stats->stage),
+              (int)stats->dir_len, stats->file, stats->pass);
+   }
+
+   free(sorted);
+   simple_mtx_unlock(&stats_lock);
+}
+
+static void
+nir_pass_stats_init_once(void)
+{
+   nir_pass_stats = debug_get_option_nir_pass_stats();
+
+   if (nir_pass_stats & NIR_PASS_STATS_PERFETTO)
+      util_cpu_trace_init();
+   if (nir_pass_stats & NIR_PASS_STATS_REPORT)
+      atexit(nir_pass_stats_report);
+}
+
+void
+nir_pass_stats_init(void)
+{
+   static once_flag flag = ONCE_FLAG_INIT;
+   call_once(&flag, nir_pass_stats_init_once);
+}
+
+static void
+count_ir(nir_shader *shader, unsigned *instrs, unsigned *defs)
+{
+   *instrs = 0;
+   *defs = 0;
+   nir_foreach_function_impl(impl, shader) {
+      nir_foreach_block(block, impl) {
+         nir_foreach_instr(instr, block) {
+            (*instrs)++;
+            if (nir_instr_def(instr))
+               (*defs)++;
+         }
+      }
+   }
+}
+
+void
+nir_pass_stats_begin(nir_shader *shader, const char *pass,
+                     struct nir_pass_stats_sample *sample)
+{
+   if (nir_pass_stats & NIR_PASS_STATS_REPORT)
+      count_ir(shader, &sample->instrs, &sample->defs);
+
+   if (nir_pass_stats & NIR_PASS_STATS_PERFETTO)
+      MESA_TRACE_BEGIN(pass);
+
+   sample->start = os_time_get_nano();
+}
+
+void
+nir_pass_stats_stop(struct nir_pass_stats_sample *sample)
+{
+   sample->end = os_time_get_nano();
+
+   if (nir_pass_stats & NIR_PASS_STATS_PERFETTO)
+      MESA_TRACE_END();
+}
+
+void
+nir_pass_stats_end(nir_shader *shader, const char *pass, const char *file,
+                   int progress, const struct nir_pass_stats_sample *sample)
+{
+   int64_t time_ns = sample->end - sample->start;
+
+   if (!(nir_pass_stats & NIR_PASS_STATS_REPORT))
+      return;
+
+   unsigned instrs, defs;
+   count_ir(shader, &instrs, &defs);
+
+   const char *slash = strrchr(file, '/');
+   struct pass_stats key = {
+      .pass = pass,
+      .file = file,
+      .dir_len = slash ? slash - file : 0,
+      .stage = shader->info.stage,
+   };
+
+   simple_mtx_lock(&stats_lock);
+
+   if (!stats_table)
+      stats_table = _mesa_hash_table_create(NULL, pass_stats_hash, pass_stats_equal);
+
+   struct hash_entry *entry = stats_table ? _mesa_hash_table_search(stats_table, &key) : NULL;
+   struct pass_stats *stats = entry ? (struct pass_stats *)entry->key : NULL;
+   if (!stats && stats_table) {
+      stats = rzalloc(stats_table, struct pass_stats);
+      if (stats) {
+         *stats = key;
+         _mesa_hash_table_insert(stats_table, stats, stats);
+      }
+   }
+
+   if (stats) {
+      stats->calls++;
+      if (progress < 0)
+         stats->unknown++;
+      else if (progress)
+         stats->progress++;
+      stats->time_ns += time_ns;
+      stats->instr_delta += (int64_t)instrs - sample->instrs;
+      stats->def_delta += (int64_t)defs - sample->defs;
+   }
+
+   simple_mtx_unlock(&stats_lock);
+}
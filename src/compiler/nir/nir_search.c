@@ -41,6 +41,11 @@ struct match_state {
    const struct per_op_table *pass_op_table;
    const nir_algebraic_table *table;
 
+   /* If non-NULL, newly-constructed instructions are queued here so that
+    * they are matched against the table again in the same pass.
+    */
+   nir_instr_worklist *worklist;
+
    nir_alu_src variables[NIR_SEARCH_MAX_VARIABLES];
    struct hash_table *range_ht;
 };
@@ -480,6 +485,11 @@ construct_value(nir_builder *build,
       util_dynarray_append(state->states, uint16_t, 0);
       nir_algebraic_automaton(&alu->instr, state->states, state->pass_op_table);
 
+      if (state->worklist) {
+         alu->instr.pass_flags = 0;
+         nir_instr_worklist_push_tail(state->worklist, &alu->instr);
+      }
+
       nir_alu_src val;
       val.src = nir_src_for_ssa(&alu->def);
       memcpy(val.swizzle, identity_swizzle, sizeof val.swizzle);
@@ -658,6 +668,7 @@ nir_replace_instr(nir_builder *build, nir_alu_instr *instr,
                   const nir_search_expression *search,
                   const nir_search_value *replace,
                   nir_instr_worklist *algebraic_worklist,
+                  bool requeue,
                   struct exec_list *dead_instrs)
 {
    uint8_t swizzle[NIR_MAX_VEC_COMPONENTS] = { 0 };
@@ -740,6 +751,7 @@ nir_replace_instr(nir_builder *build, nir_alu_instr *instr,
    }
 
    state.states = states;
+   state.worklist = requeue ? algebraic_worklist : NULL;
 
    nir_alu_src val = construct_value(build, replace,
                                      instr->def.num_components,
@@ -763,6 +775,17 @@ nir_replace_instr(nir_builder *build, nir_alu_instr *instr,
    nir_algebraic_update_automaton(ssa_val->parent_instr, algebraic_worklist,
                                   states, table->pass_op_table);
 
+   /* The automaton state of a use may not change even though it now matches
+    * a different constant or variable, so requeue all direct uses as well.
+    */
+   if (requeue) {
+      nir_foreach_use(use_src, ssa_val) {
+         nir_instr *use = nir_src_parent_instr(use_src);
+         if (use->type == nir_instr_type_alu)
+            nir_instr_worklist_push_tail(algebraic_worklist, use);
+      }
+   }
+
    /* Nothing uses the instr any more, so drop it out of the program.  Note
     * that the instr may be in the worklist still, so we can't free it
     * directly.
@@ -833,6 +856,7 @@ nir_algebraic_instr(nir_builder *build, nir_instr *instr,
                     const nir_algebraic_table *table,
                     struct util_dynarray *states,
                     nir_instr_worklist *worklist,
+                    bool requeue,
                     struct exec_list *dead_instrs)
 {
 
@@ -857,7 +881,8 @@ nir_algebraic_instr(nir_builder *build, nir_instr *instr,
           !(table->values[xform->search].expression.inexact && ignore_inexact) &&
           nir_replace_instr(build, alu, range_ht, states, table,
                             &table->values[xform->search].expression,
-                            &table->values[xform->replace].value, worklist, dead_instrs)) {
+                            &table->values[xform->replace].value, worklist,
+                            requeue, dead_instrs)) {
          _mesa_hash_table_clear(range_ht, NULL);
          return true;
       }
@@ -901,14 +926,33 @@ nir_algebraic_impl(nir_function_impl *impl,
     * first.  This will encourage us to match the biggest source patterns when
     * possible.
     */
+   unsigned num_alu = 0;
    nir_foreach_block_reverse(block, impl) {
       nir_foreach_instr_reverse(instr, block) {
          instr->pass_flags = 0;
-         if (instr->type == nir_instr_type_alu)
+         if (instr->type == nir_instr_type_alu) {
             nir_instr_worklist_push_tail(worklist, instr);
+            num_alu++;
+         }
       }
    }
 
+   /* Replacements queue the instructions they create and their uses, so
+    * that a single call reaches a fixed point for the table instead of
+    * relying on the caller's optimization loop.  Should a table contain a
+    * cycle of rules, stop requeueing after a generous number of
+    * replacements so that we still terminate.
+    *
+    * Requeued instructions go to the tail, after everything that is still
+    * pending, and the instructions a replacement builds are queued inner
+    * ones first.  So, unlike the initial bottom-to-top order above, a newly
+    * built instruction is matched before its uses and can be folded into a
+    * smaller pattern before an outer use gets the chance to match a bigger
+    * one.
+    */
+   unsigned replacements = 0;
+   const unsigned max_requeue_replacements = 16 * num_alu + 256;
+
    struct exec_list dead_instrs;
    exec_list_make_empty(&dead_instrs);
 
@@ -921,9 +965,14 @@ nir_algebraic_impl(nir_function_impl *impl,
       if (instr->pass_flags)
          continue;
 
-      progress |= nir_algebraic_instr(&build, instr,
-                                      range_ht, condition_flags,
-                                      table, &states, worklist, &dead_instrs);
+      if (nir_algebraic_instr(&build, instr,
+                              range_ht, condition_flags,
+                              table, &states, worklist,
+                              replacements < max_requeue_replacements,
+                              &dead_instrs)) {
+         progress = true;
+         replacements++;
+      }
    }
 
    nir_instr_free_list(&dead_instrs);
@@ -1965,6 +1965,32 @@ read_xfb_info(read_ctx *ctx)
    return xfb;
 }
 
+/* Every serialized shader starts with this header, followed by the
+ * declarations (shader_info, variables, constant data, xfb and printf info
+ * and the functions without their bodies) and finally the function impls.
+ * The offsets are relative to the start of the header, which allows reading
+ * the declarations without the function impls and the other way around.
+ */
+#define NIR_SERIALIZE_MAGIC 0x4e495201 /* "NIR" and the format version */
+
+struct nir_serialize_header {
+   uint32_t magic;
+   /* total number of objects, see read_ctx::idx_table_len */
+   uint32_t num_objects;
+   /* number of objects added by the declarations */
+   uint32_t num_decl_objects;
+   uint32_t impls_offset;
+   uint32_t size;
+};
+
+static void
+reset_var_state(write_ctx *ctx)
+{
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+}
+
 /**
  * Serialize NIR into a binary blob.
  *
@@ -1982,7 +2008,12 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
    ctx.strip = strip;
    util_dynarray_init(&ctx.phi_fixups, NULL);
 
+   size_t start = blob->size;
+   blob_write_uint32(blob, NIR_SERIALIZE_MAGIC);
    size_t idx_size_offset = blob_reserve_uint32(blob);
+   size_t decl_idx_size_offset = blob_reserve_uint32(blob);
+   size_t impls_offset_offset = blob_reserve_uint32(blob);
+   size_t size_offset = blob_reserve_uint32(blob);
 
    struct shader_info info = nir->info;
    uint32_t strings = 0;
@@ -2005,15 +2036,6 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
    blob_write_uint32(blob, nir->num_outputs);
    blob_write_uint32(blob, nir->scratch_size);
 
-   blob_write_uint32(blob, exec_list_length(&nir->functions));
-   nir_foreach_function(fxn, nir) {
-      write_function(&ctx, fxn);
-   }
-
-   nir_foreach_function_impl(impl, nir) {
-      write_function_impl(&ctx, impl);
-   }
-
    blob_write_uint32(blob, nir->constant_data_size);
    if (nir->constant_data_size > 0)
       blob_write_bytes(blob, nir->constant_data, nir->constant_data_size);
@@ -2035,22 +2057,68 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
       }
    }
 
+   blob_write_uint32(blob, exec_list_length(&nir->functions));
+   nir_foreach_function(fxn, nir) {
+      write_function(&ctx, fxn);
+   }
+
+   blob_overwrite_uint32(blob, decl_idx_size_offset, ctx.next_idx);
+   blob_overwrite_uint32(blob, impls_offset_offset, blob->size - start);
+
+   /* The impls may be read without the declarations having been read just
+    * before, so they can't be delta-encoded against the global variables.
+    */
+   reset_var_state(&ctx);
+
+   uint32_t num_impls = 0;
+   nir_foreach_function_impl(impl, nir)
+      num_impls++;
+
+   blob_write_uint32(blob, num_impls);
+   nir_foreach_function_impl(impl, nir) {
+      blob_write_uint32(blob, write_lookup_object(&ctx, impl->function));
+      write_function_impl(&ctx, impl);
+   }
+
    blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
+   blob_overwrite_uint32(blob, size_offset, blob->size - start);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
    util_dynarray_fini(&ctx.phi_fixups);
 }
 
-nir_shader *
-nir_deserialize(void *mem_ctx,
-                const struct nir_shader_compiler_options *options,
-                struct blob_reader *blob)
+static bool
+read_header(read_ctx *ctx, struct nir_serialize_header *header)
+{
+   header->magic = blob_read_uint32(ctx->blob);
+   header->num_objects = blob_read_uint32(ctx->blob);
+   header->num_decl_objects = blob_read_uint32(ctx->blob);
+   header->impls_offset = blob_read_uint32(ctx->blob);
+   header->size = blob_read_uint32(ctx->blob);
+
+   if (ctx->blob->overrun || header->magic != NIR_SERIALIZE_MAGIC ||
+       header->num_decl_objects > header->num_objects ||
+       header->impls_offset > header->size) {
+      ctx->blob->overrun = true;
+      return false;
+   }
+
+   return true;
+}
+
+static bool
+alloc_idx_table(read_ctx *ctx, const struct nir_serialize_header *header)
 {
-   read_ctx ctx = { 0 };
-   ctx.blob = blob;
-   list_inithead(&ctx.phi_srcs);
-   ctx.idx_table_len = blob_read_uint32(blob);
-   ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
+   ctx->idx_table_len = header->num_objects;
+   ctx->idx_table = calloc(ctx->idx_table_len, sizeof(uintptr_t));
+   return ctx->idx_table != NULL || ctx->idx_table_len == 0;
+}
+
+static void
+read_decls(read_ctx *ctx, void *mem_ctx,
+           const struct nir_shader_compiler_options *options)
+{
+   struct blob_reader *blob = ctx->blob;
 
    uint32_t strings = blob_read_uint32(blob);
    char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
@@ -2059,57 +2127,96 @@ nir_deserialize(void *mem_ctx,
    struct shader_info info;
    blob_copy_bytes(blob, (uint8_t *)&info, sizeof(info));
 
-   ctx.nir = nir_shader_create(mem_ctx, info.stage, options, NULL);
-
-   info.name = name ? ralloc_strdup(ctx.nir, name) : NULL;
-   info.label = label ? ralloc_strdup(ctx.nir, label) : NULL;
-
-   ctx.nir->info = info;
+   ctx->nir = nir_shader_create(mem_ctx, info.stage, options, NULL);
 
-   read_var_list(&ctx, &ctx.nir->variables);
+   info.name = name ? ralloc_strdup(ctx->nir, name) : NULL;
+   info.label = label ? ralloc_strdup(ctx->nir, label) : NULL;
 
-   ctx.nir->num_inputs = blob_read_uint32(blob);
-   ctx.nir->num_uniforms = blob_read_uint32(blob);
-   ctx.nir->num_outputs = blob_read_uint32(blob);
-   ctx.nir->scratch_size = blob_read_uint32(blob);
+   ctx->nir->info = info;
 
-   unsigned num_functions = blob_read_uint32(blob);
-   for (unsigned i = 0; i < num_functions; i++)
-      read_function(&ctx);
+   read_var_list(ctx, &ctx->nir->variables);
 
-   nir_foreach_function(fxn, ctx.nir) {
-      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
-         nir_function_set_impl(fxn, read_function_impl(&ctx));
-   }
+   ctx->nir->num_inputs = blob_read_uint32(blob);
+   ctx->nir->num_uniforms = blob_read_uint32(blob);
+   ctx->nir->num_outputs = blob_read_uint32(blob);
+   ctx->nir->scratch_size = blob_read_uint32(blob);
 
-   ctx.nir->constant_data_size = blob_read_uint32(blob);
-   if (ctx.nir->constant_data_size > 0) {
-      ctx.nir->constant_data =
-         ralloc_size(ctx.nir, ctx.nir->constant_data_size);
-      blob_copy_bytes(blob, ctx.nir->constant_data,
-                      ctx.nir->constant_data_size);
+   ctx->nir->constant_data_size = blob_read_uint32(blob);
+   if (ctx->nir->constant_data_size > 0) {
+      ctx->nir->constant_data =
+         ralloc_size(ctx->nir, ctx->nir->constant_data_size);
+      blob_copy_bytes(blob, ctx->nir->constant_data,
+                      ctx->nir->constant_data_size);
    }
 
-   ctx.nir->xfb_info = read_xfb_info(&ctx);
+   ctx->nir->xfb_info = read_xfb_info(ctx);
 
-   if (ctx.nir->info.stage == MESA_SHADER_KERNEL) {
-      ctx.nir->printf_info_count = blob_read_uint32(blob);
-      ctx.nir->printf_info =
-         ralloc_array(ctx.nir, u_printf_info, ctx.nir->printf_info_count);
+   if (ctx->nir->info.stage == MESA_SHADER_KERNEL) {
+      ctx->nir->printf_info_count = blob_read_uint32(blob);
+      ctx->nir->printf_info =
+         ralloc_array(ctx->nir, u_printf_info, ctx->nir->printf_info_count);
 
-      for (int i = 0; i < ctx.nir->printf_info_count; i++) {
-         u_printf_info *info = &ctx.nir->printf_info[i];
+      for (int i = 0; i < ctx->nir->printf_info_count; i++) {
+         u_printf_info *info = &ctx->nir->printf_info[i];
          info->num_args = blob_read_uint32(blob);
          info->string_size = blob_read_uint32(blob);
-         info->arg_sizes = ralloc_array(ctx.nir, unsigned, info->num_args);
+         info->arg_sizes = ralloc_array(ctx->nir, unsigned, info->num_args);
          blob_copy_bytes(blob, info->arg_sizes,
                          info->num_args * sizeof(*info->arg_sizes));
-         info->strings = ralloc_array(ctx.nir, char, info->string_size);
+         info->strings = ralloc_array(ctx->nir, char, info->string_size);
          blob_copy_bytes(blob, info->strings,
                          info->string_size * sizeof(*info->strings));
       }
    }
 
+   unsigned num_functions = blob_read_uint32(blob);
+   for (unsigned i = 0; i < num_functions; i++)
+      read_function(ctx);
+}
+
+static void
+read_impls(read_ctx *ctx)
+{
+   /* See nir_serialize() */
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
+   unsigned num_impls = blob_read_uint32(ctx->blob);
+   for (unsigned i = 0; i < num_impls && !ctx->blob->overrun; i++) {
+      nir_function *fxn = read_object(ctx);
+      assert(fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL);
+      nir_function_set_impl(fxn, read_function_impl(ctx));
+   }
+}
+
+/**
+ * Deserialize a shader written by nir_serialize().
+ *
+ * Returns NULL if we run out of memory.
+ */
+nir_shader *
+nir_deserialize(void *mem_ctx,
+                const struct nir_shader_compiler_options *options,
+                struct blob_reader *blob)
+{
+   read_ctx ctx = { 0 };
+   ctx.blob = blob;
+   list_inithead(&ctx.phi_srcs);
+
+   /* Callers hand in data they serialized themselves, so unlike
+    * nir_deserialize_lazy() this doesn't check for a bad header.
+    */
+   struct nir_serialize_header header;
+   if (!read_header(&ctx, &header))
+      unreachable("invalid serialized NIR");
+
+   if (!alloc_idx_table(&ctx, &header))
+      return NULL;
+
+   read_decls(&ctx, mem_ctx, options);
+   read_impls(&ctx);
+
    free(ctx.idx_table);
 
    nir_validate_shader(ctx.nir, "after deserialize");
@@ -2117,6 +2224,120 @@ nir_deserialize(void *mem_ctx,
    return ctx.nir;
 }
 
+/**
+ * Deserialize everything but the function impls.
+ *
+ * This is enough to look at the shader_info and the variables, for example
+ * to build a shader key, without paying for rebuilding the instructions.
+ * The functions of the returned shader have a NULL impl until
+ * nir_deserialize_function_impls() is called with a reader over the same
+ * data.  The reader is left at the end of the serialized shader.
+ *
+ * Returns NULL if the data doesn't start with a valid header or if we run
+ * out of memory.
+ */
+nir_shader *
+nir_deserialize_lazy(void *mem_ctx,
+                     const struct nir_shader_compiler_options *options,
+                     struct blob_reader *blob)
+{
+   const uint8_t *start = blob->current;
+
+   read_ctx ctx = { 0 };
+   ctx.blob = blob;
+   list_inithead(&ctx.phi_srcs);
+
+   struct nir_serialize_header header;
+   if (!read_header(&ctx, &header) || !alloc_idx_table(&ctx, &header))
+      return NULL;
+
+   read_decls(&ctx, mem_ctx, options);
+
+   free(ctx.idx_table);
+
+   nir_foreach_function(fxn, ctx.nir) {
+      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
+         fxn->impl = NULL;
+   }
+
+   if (header.size > (size_t)(blob->end - start))
+      blob->overrun = true;
+   else
+      blob->current = start + header.size;
+
+   return ctx.nir;
+}
+
+/**
+ * Materialize the function impls of a shader returned by
+ * nir_deserialize_lazy().
+ *
+ * The shader must not have been modified in between, as the impls refer to
+ * the global variables and functions by their position.  Returns false if
+ * the data doesn't match the shader or if we run out of memory.
+ */
+bool
+nir_deserialize_function_impls(nir_shader *nir, struct blob_reader *blob)
+{
+   const uint8_t *start = blob->current;
+
+   read_ctx ctx = { 0 };
+   ctx.blob = blob;
+   ctx.nir = nir;
+   list_inithead(&ctx.phi_srcs);
+
+   struct nir_serialize_header header;
+   if (!read_header(&ctx, &header) || !alloc_idx_table(&ctx, &header))
+      return false;
+
+   if (header.size > (size_t)(blob->end - start)) {
+      free(ctx.idx_table);
+      blob->overrun = true;
+      return false;
+   }
+
+   if (exec_list_length(&nir->variables) +
+       exec_list_length(&nir->functions) != header.num_decl_objects) {
+      free(ctx.idx_table);
+      return false;
+   }
+
+   nir_foreach_function(fxn, nir) {
+      if (fxn->impl) {
+         free(ctx.idx_table);
+         return false;
+      }
+   }
+
+   /* Rebuild the objects of the declarations in the order read_decls()
+    * added them.
+    */
+   nir_foreach_variable_in_shader(var, nir)
+      read_add_object(&ctx, var);
+   nir_foreach_function(fxn, nir) {
+      read_add_object(&ctx, fxn);
+      fxn->impl = NIR_SERIALIZE_FUNC_HAS_IMPL;
+   }
+
+   blob->current = start + header.impls_offset;
+   read_impls(&ctx);
+
+   /* Functions which were only declared */
+   nir_foreach_function(fxn, nir) {
+      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
+         fxn->impl = NULL;
+   }
+
+   free(ctx.idx_table);
+
+   if (blob->overrun)
+      return false;
+
+   nir_validate_shader(nir, "after deserializing function impls");
+
+   return true;
+}
+
 void
 nir_shader_serialize_deserialize(nir_shader *shader)
 {
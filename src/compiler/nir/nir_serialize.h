@@ -35,6 +35,10 @@ void nir_serialize(struct blob *blob, const nir_shader *nir, bool strip);
 nir_shader *nir_deserialize(void *mem_ctx,
                             const struct nir_shader_compiler_options *options,
                             struct blob_reader *blob);
+nir_shader *nir_deserialize_lazy(void *mem_ctx,
+                                 const struct nir_shader_compiler_options *options,
+                                 struct blob_reader *blob);
+bool nir_deserialize_function_impls(nir_shader *nir, struct blob_reader *blob);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -33,6 +33,13 @@
  * The expectation is that drivers should call this when finished compiling the shader
  * (after any optimization, lowering, and so on).  However, it's also fine to call it
  * earlier, and even many times, trading CPU cycles for memory savings.
+ *
+ * If passes have freed most of the instructions they created, the live
+ * instructions are spread thinly over the gc_ctx slabs.  In that case the
+ * function impls are first cloned into a fresh gc_ctx, which re-packs the
+ * instructions in program order so that later walks over the IR touch fewer
+ * cache lines.  This replaces all of the IR inside the impls, see the
+ * comment on nir_sweep() in nir.h.
  */
 
 #define steal_list(mem_ctx, type, list)        \
@@ -143,9 +150,49 @@ sweep_function(nir_shader *nir, nir_function *f)
       sweep_impl(nir, f->impl);
 }
 
+static bool
+should_compact(nir_shader *nir)
+{
+   unsigned num_instrs = 0;
+
+   nir_foreach_function_impl(impl, nir) {
+      /* nir_function_impl_clone() can't handle these. */
+      if (!impl->structured)
+         return false;
+
+      nir_foreach_block(block, impl) {
+         nir_foreach_instr(instr, block) {
+            if (instr->type == nir_instr_type_parallel_copy)
+               return false;
+            num_instrs++;
+         }
+      }
+   }
+
+   return num_instrs * 2 < nir->num_instrs_allocated;
+}
+
+static void
+compact_impls(nir_shader *nir)
+{
+   /* Everything still in the old gc_ctx is freed with the rest of the
+    * rubbish.
+    */
+   nir->gctx = gc_context(nir);
+   nir->num_instrs_allocated = 0;
+
+   nir_foreach_function(func, nir) {
+      if (func->impl)
+         nir_function_set_impl(func, nir_function_impl_clone(nir, func->impl));
+   }
+}
+
 void
 nir_sweep(nir_shader *nir)
 {
+   if (should_compact(nir))
+      compact_impls(nir);
+
    void *rubbish = ralloc_context(NULL);
 
    struct list_head instr_gc_list;
@@ -132,6 +132,29 @@ TEST_F(nir_opt_algebraic_test, irem_pow2_src2)
    test_2src_op(nir_op_irem, INT32_MIN, -4);
 }
 
+TEST_F(nir_opt_algebraic_test, requeue_replacement)
+{
+   nir_def *x = nir_load_local_invocation_index(b);
+   nir_def *y = nir_load_subgroup_invocation(b);
+
+   /* The outer iand is replaced first, by a new iand(iand(x, y), y) that
+    * only gets simplified if the new instruction is matched again.
+    */
+   nir_def *res = nir_iand(b, nir_iand(b, nir_iand(b, x, y), y), y);
+   nir_intrinsic_instr *store =
+      nir_build_store_deref(b, &nir_build_deref_var(b, res_var)->def, res, 0x1);
+
+   ASSERT_TRUE(nir_opt_algebraic(b->shader));
+   nir_opt_dce(b->shader);
+   EXPECT_FALSE(nir_opt_algebraic(b->shader));
+
+   nir_alu_instr *alu = nir_src_as_alu_instr(store->src[1]);
+   ASSERT_NE(alu, nullptr);
+   EXPECT_EQ(alu->op, nir_op_iand);
+   EXPECT_EQ(nir_src_as_alu_instr(alu->src[0].src), nullptr);
+   EXPECT_EQ(nir_src_as_alu_instr(alu->src[1].src), nullptr);
+}
+
 TEST_F(nir_opt_idiv_const_test, umod)
 {
    for (uint32_t d : {16u, 17u, 0u, UINT32_MAX}) {
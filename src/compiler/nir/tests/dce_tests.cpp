@@ -137,3 +137,45 @@ TEST_F(nir_opt_dead_cf_test, jump_before_constant_if)
 
    nir_validate_shader(b->shader, NULL);
 }
+
+static bool
+mark_alu_exact(nir_builder *b, nir_instr *instr, void *data)
+{
+   if (instr->type != nir_instr_type_alu)
+      return false;
+
+   nir_instr_as_alu(instr)->exact = true;
+   return true;
+}
+
+TEST_F(nir_opt_dce_test, skip_unchanged_impl)
+{
+   /* Test that nir_opt_dce() skips an impl it already cleaned up, and runs
+    * again once anything changes, even if the change preserves all metadata.
+    */
+   nir_variable *var = nir_variable_create(b->shader, nir_var_shader_out, glsl_int_type(), "out");
+
+   nir_store_var(b, var, nir_iadd(b, nir_imm_int(b, 1), nir_imm_int(b, 2)), 0x1);
+   nir_imm_int(b, 3);
+
+   ASSERT_TRUE(nir_opt_dce(b->shader));
+   ASSERT_FALSE(nir_opt_dce(b->shader));
+   EXPECT_TRUE(nir_impl_pass_can_skip(b->impl, nir_incremental_pass_opt_dce));
+
+   /* Progress with nir_metadata_all still counts as a change. */
+   ASSERT_TRUE(nir_shader_instructions_pass(b->shader, mark_alu_exact,
+                                            nir_metadata_all, NULL));
+   EXPECT_FALSE(nir_impl_pass_can_skip(b->impl, nir_incremental_pass_opt_dce));
+
+   ASSERT_FALSE(nir_opt_dce(b->shader));
+   EXPECT_TRUE(nir_impl_pass_can_skip(b->impl, nir_incremental_pass_opt_dce));
+
+   /* So does new dead code, which the next run removes. */
+   b->cursor = nir_after_impl(b->impl);
+   nir_imm_int(b, 4);
+   EXPECT_FALSE(nir_impl_pass_can_skip(b->impl, nir_incremental_pass_opt_dce));
+
+   ASSERT_TRUE(nir_opt_dce(b->shader));
+
+   nir_validate_shader(b->shader, NULL);
+}
@@ -195,3 +195,69 @@ TEST_P(nir_serialize_all_but_one_test, single_channel)
 
    ASSERT_SWIZZLE_EQ(vec_alu, vec_alu_dup, 1, 0);
 }
+
+TEST_P(nir_serialize_all_test, lazy_function_impls)
+{
+   nir_variable *var = nir_variable_create(b->shader, nir_var_shader_out,
+                                           glsl_vec_type(GetParam()), "out");
+   nir_def *zero = nir_imm_zero(b, GetParam(), 32);
+   nir_store_var(b, var, zero, BITFIELD_MASK(GetParam()));
+   nir_def *fmax = nir_fmax(b, nir_load_var(b, var), zero);
+   nir_alu_instr *fmax_alu = nir_instr_as_alu(fmax->parent_instr);
+
+   struct blob blob;
+   struct blob_reader reader;
+
+   blob_init(&blob);
+   nir_serialize(&blob, b->shader, false);
+
+   blob_reader_init(&reader, blob.data, blob.size);
+   dup = nir_deserialize_lazy(b->shader, &options, &reader);
+   ASSERT_FALSE(reader.overrun);
+   ASSERT_EQ(reader.current, reader.end);
+   ASSERT_EQ(dup->info.stage, MESA_SHADER_COMPUTE);
+   ASSERT_EQ(exec_list_length(&dup->variables), 1);
+   nir_function *entrypoint = NULL;
+   nir_foreach_function(func, dup) {
+      if (func->is_entrypoint)
+         entrypoint = func;
+   }
+   ASSERT_NE(entrypoint, nullptr);
+   ASSERT_EQ(entrypoint->impl, nullptr);
+
+   blob_reader_init(&reader, blob.data, blob.size);
+   ASSERT_TRUE(nir_deserialize_function_impls(dup, &reader));
+   ASSERT_FALSE(reader.overrun);
+   ASSERT_EQ(reader.current, reader.end);
+   blob_finish(&blob);
+
+   nir_alu_instr *fmax_alu_dup = get_last_alu(dup);
+   ASSERT_EQ(fmax_alu_dup->op, nir_op_fmax);
+   ASSERT_SWIZZLE_EQ(fmax_alu, fmax_alu_dup, GetParam(), 0);
+
+   nir_intrinsic_instr *load =
+      nir_src_as_intrinsic(fmax_alu_dup->src[0].src);
+   nir_variable *var_dup =
+      exec_node_data(nir_variable, exec_list_get_head(&dup->variables), node);
+   ASSERT_EQ(nir_intrinsic_get_var(load, 0), var_dup);
+}
+
+TEST_F(nir_serialize_test, lazy_bad_header)
+{
+   struct blob blob;
+   struct blob_reader reader;
+
+   blob_init(&blob);
+   nir_serialize(&blob, b->shader, false);
+
+   /* Clobber the magic number */
+   uint32_t magic = 0;
+   blob_overwrite_bytes(&blob, 0, &magic, sizeof(magic));
+
+   blob_reader_init(&reader, blob.data, blob.size);
+   dup = nir_deserialize_lazy(b->shader, &options, &reader);
+   EXPECT_EQ(dup, nullptr);
+   EXPECT_TRUE(reader.overrun);
+
+   blob_finish(&blob);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright © 2026 agent
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "nir_test.h"
+#include "util/os_time.h"
+
+class nir_sweep_test : public nir_test {
+protected:
+   nir_sweep_test()
+      : nir_test::nir_test("nir_sweep_test")
+   {
+   }
+
+   void build_chain(unsigned length, unsigned dead_per_link);
+   unsigned count_instrs();
+   void set_uniform();
+};
+
+/* A chain of dependent ALU ops, each followed by dead_per_link instructions
+ * nothing uses, so that nir_opt_dce() leaves the live ones scattered over
+ * the gc_ctx slabs.
+ */
+void
+nir_sweep_test::build_chain(unsigned length, unsigned dead_per_link)
+{
+   nir_variable *in = nir_variable_create(b->shader, nir_var_shader_in,
+                                          glsl_vec4_type(), "in");
+   nir_variable *out = nir_variable_create(b->shader, nir_var_shader_out,
+                                           glsl_vec4_type(), "out");
+
+   nir_def *x = nir_load_var(b, in);
+   for (unsigned i = 0; i < length; i++) {
+      x = nir_ffma(b, x, nir_fadd_imm(b, x, i), nir_fmul_imm(b, x, 0.5));
+      for (unsigned j = 0; j < dead_per_link; j++)
+         nir_fmul(b, x, nir_fadd_imm(b, x, j));
+      if (i % 64 == 63)
+         nir_store_var(b, out, x, 0xf);
+   }
+   nir_store_var(b, out, x, 0xf);
+}
+
+unsigned
+nir_sweep_test::count_instrs()
+{
+   unsigned count = 0;
+   nir_foreach_block(block, nir_shader_get_entrypoint(b->shader)) {
+      nir_foreach_instr(instr, block)
+         count++;
+   }
+   return count;
+}
+
+void
+nir_sweep_test::set_uniform()
+{
+   nir_foreach_block(block, nir_shader_get_entrypoint(b->shader)) {
+      nir_foreach_instr(instr, block) {
+         nir_def *def = nir_instr_def(instr);
+         if (def)
+            def->divergent = false;
+      }
+   }
+}
+
+TEST_F(nir_sweep_test, compact_fragmented)
+{
+   build_chain(256, 4);
+   ASSERT_TRUE(nir_opt_dce(b->shader));
+   set_uniform();
+
+   nir_function_impl *old_impl = nir_shader_get_entrypoint(b->shader);
+   unsigned num_instrs = count_instrs();
+
+   nir_sweep(b->shader);
+   nir_validate_shader(b->shader, NULL);
+
+   /* The impl was replaced by a copy holding just the live instructions. */
+   nir_function_impl *impl = nir_shader_get_entrypoint(b->shader);
+   EXPECT_NE(impl, old_impl);
+   EXPECT_EQ(count_instrs(), num_instrs);
+   EXPECT_EQ(b->shader->num_instrs_allocated, num_instrs);
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         nir_def *def = nir_instr_def(instr);
+         if (def)
+            EXPECT_FALSE(def->divergent);
+      }
+   }
+}
+
+TEST_F(nir_sweep_test, keep_dense)
+{
+   build_chain(256, 0);
+   nir_opt_dce(b->shader);
+
+   nir_function_impl *old_impl = nir_shader_get_entrypoint(b->shader);
+
+   nir_sweep(b->shader);
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_EQ(nir_shader_get_entrypoint(b->shader), old_impl);
+}
+
+/* Run with --gtest_also_run_disabled_tests to compare an optimization loop
+ * over a fragmented shader with the same loop once nir_sweep() re-packed it.
+ */
+static int64_t
+time_opt_loop(nir_shader *shader, unsigned iterations)
+{
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      nir_opt_algebraic(shader);
+      nir_opt_constant_folding(shader);
+      nir_index_ssa_defs(nir_shader_get_entrypoint(shader));
+      nir_opt_cse(shader);
+   }
+   return os_time_get_nano() - start;
+}
+
+TEST_F(nir_sweep_test, DISABLED_benchmark)
+{
+   const unsigned dead_counts[] = { 0, 1, 2, 4, 8 };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(dead_counts); i++) {
+      build_chain(20000, dead_counts[i]);
+      nir_opt_dce(b->shader);
+
+      /* The first run does the actual optimizing, only time the later ones. */
+      time_opt_loop(b->shader, 1);
+      int64_t fragmented = time_opt_loop(b->shader, 20);
+
+      int64_t start = os_time_get_nano();
+      nir_sweep(b->shader);
+      int64_t sweep = os_time_get_nano() - start;
+
+      int64_t packed = time_opt_loop(b->shader, 20);
+
+      printf("%u dead per link: loop %.1f ms fragmented, %.1f ms after "
+             "sweep, sweep %.1f ms\n", dead_counts[i], fragmented / 1e6,
+             packed / 1e6, sweep / 1e6);
+
+      /* Start over with an empty shader. */
+      const nir_shader_compiler_options *options = b->shader->options;
+      ralloc_free(b->shader);
+      _b = nir_builder_init_simple_shader(MESA_SHADER_COMPUTE, options,
+                                          "nir_sweep_test");
+   }
+}
@@ -1308,6 +1308,20 @@ draw_set_disk_cache_callbacks(struct draw_context *draw,
 }
 
 
+/**
+ * Limit the JIT code held by shader variants to roughly this many bytes,
+ * evicting the least recently used ones beyond it.  Zero means no limit.
+ */
+void
+draw_set_shader_code_budget(struct draw_context *draw, size_t bytes)
+{
+#ifdef DRAW_LLVM_AVAILABLE
+   if (draw->llvm)
+      draw->llvm->code_budget = bytes;
+#endif
+}
+
+
 void
 draw_set_constant_buffer_stride(struct draw_context *draw, unsigned num_bytes)
 {
@@ -429,5 +429,8 @@ draw_set_disk_cache_callbacks(struct draw_context *draw,
                                                     struct lp_cached_code *cache,
                                                     unsigned char ir_sha1_cache_key[20]));
 
+void
+draw_set_shader_code_budget(struct draw_context *draw, size_t bytes);
+
 
 #endif /* DRAW_CONTEXT_H */
@@ -536,6 +536,8 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
       llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
                                            &cached,
                                            ir_sha1_cache_key);
+   variant->code_size = gallivm_code_size(variant->gallivm);
+   variant->llvm->code_size += variant->code_size;
    gallivm_free_ir(variant->gallivm);
 
    variant->list_item_global.base = variant;
@@ -2241,6 +2243,7 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_variants--;
+   llvm->code_size -= variant->code_size;
    FREE(variant);
 }
 
@@ -2533,6 +2536,8 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
       llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
                                            &cached,
                                            ir_sha1_cache_key);
+   variant->code_size = gallivm_code_size(variant->gallivm);
+   variant->llvm->code_size += variant->code_size;
    gallivm_free_ir(variant->gallivm);
 
    variant->list_item_global.base = variant;
@@ -2560,6 +2565,7 @@ draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant)
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_gs_variants--;
+   llvm->code_size -= variant->code_size;
    FREE(variant);
 }
 
@@ -3189,6 +3195,8 @@ draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
       llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
                                            &cached,
                                            ir_sha1_cache_key);
+   variant->code_size = gallivm_code_size(variant->gallivm);
+   variant->llvm->code_size += variant->code_size;
    gallivm_free_ir(variant->gallivm);
 
    variant->list_item_global.base = variant;
@@ -3216,6 +3224,7 @@ draw_tcs_llvm_destroy_variant(struct draw_tcs_llvm_variant *variant)
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_tcs_variants--;
+   llvm->code_size -= variant->code_size;
    FREE(variant);
 }
 
@@ -3711,6 +3720,8 @@ draw_tes_llvm_create_variant(struct draw_llvm *llvm,
       llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
                                            &cached,
                                            ir_sha1_cache_key);
+   variant->code_size = gallivm_code_size(variant->gallivm);
+   variant->llvm->code_size += variant->code_size;
    gallivm_free_ir(variant->gallivm);
 
    variant->list_item_global.base = variant;
@@ -3738,6 +3749,7 @@ draw_tes_llvm_destroy_variant(struct draw_tes_llvm_variant *variant)
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_tes_variants--;
+   llvm->code_size -= variant->code_size;
    FREE(variant);
 }
 
@@ -403,6 +403,8 @@ struct draw_llvm_variant
    struct llvm_vertex_shader *shader;
 
    struct draw_llvm *llvm;
+   /* Bytes of JIT code and data */
+   size_t code_size;
    struct draw_llvm_variant_list_item list_item_global;
    struct draw_llvm_variant_list_item list_item_local;
 
@@ -436,6 +438,8 @@ struct draw_gs_llvm_variant
    struct llvm_geometry_shader *shader;
 
    struct draw_llvm *llvm;
+   /* Bytes of JIT code and data */
+   size_t code_size;
    struct draw_gs_llvm_variant_list_item list_item_global;
    struct draw_gs_llvm_variant_list_item list_item_local;
 
@@ -462,6 +466,8 @@ struct draw_tcs_llvm_variant
    struct llvm_tess_ctrl_shader *shader;
 
    struct draw_llvm *llvm;
+   /* Bytes of JIT code and data */
+   size_t code_size;
    struct draw_tcs_llvm_variant_list_item list_item_global;
    struct draw_tcs_llvm_variant_list_item list_item_local;
 
@@ -492,6 +498,8 @@ struct draw_tes_llvm_variant
    struct llvm_tess_eval_shader *shader;
 
    struct draw_llvm *llvm;
+   /* Bytes of JIT code and data */
+   size_t code_size;
    struct draw_tes_llvm_variant_list_item list_item_global;
    struct draw_tes_llvm_variant_list_item list_item_local;
 
@@ -557,9 +565,23 @@ struct draw_llvm {
 
    struct draw_tes_llvm_variant_list_item tes_variants_list;
    int nr_tes_variants;
+
+   /* JIT code held by all variants, in bytes, and its limit (0 if none) */
+   size_t code_size;
+   size_t code_budget;
 };
 
 
+/**
+ * Whether variants need to be evicted beyond the count limits.
+ */
+static inline bool
+draw_llvm_over_code_budget(const struct draw_llvm *llvm)
+{
+   return llvm->code_budget && llvm->code_size > llvm->code_budget;
+}
+
+
 static inline struct llvm_vertex_shader *
 llvm_vertex_shader(struct draw_vertex_shader *vs)
 {
@@ -96,9 +96,11 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
       /* Need to create new variant */
 
       /* First check if we've created too many variants.  If so, free
-       * 3.125% of the LRU to avoid using too much memory.
+       * 3.125% of the LRU to avoid using too much memory, or more if the
+       * code they hold exceeds the budget.
        */
-      if (llvm->nr_gs_variants >= DRAW_MAX_SHADER_VARIANTS) {
+      if (llvm->nr_gs_variants >= DRAW_MAX_SHADER_VARIANTS ||
+          draw_llvm_over_code_budget(llvm)) {
          if (gallivm_debug & GALLIVM_DEBUG_PERF) {
             debug_printf("Evicting GS: %u gs variants,\t%u total variants\n",
                       shader->variants_cached, llvm->nr_gs_variants);
@@ -108,7 +110,10 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
           * XXX: should we flush here ?
           */
          struct draw_gs_llvm_variant_list_item *item;
-         for (unsigned i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+         for (unsigned i = 0;
+              i < DRAW_MAX_SHADER_VARIANTS / 32 ||
+                 draw_llvm_over_code_budget(llvm);
+              i++) {
             if (list_is_empty(&llvm->gs_variants_list.list)) {
                break;
             }
@@ -163,9 +168,11 @@ llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
       /* Need to create new variant */
 
       /* First check if we've created too many variants.  If so, free
-       * 3.125% of the LRU to avoid using too much memory.
+       * 3.125% of the LRU to avoid using too much memory, or more if the
+       * code they hold exceeds the budget.
        */
-      if (llvm->nr_tcs_variants >= DRAW_MAX_SHADER_VARIANTS) {
+      if (llvm->nr_tcs_variants >= DRAW_MAX_SHADER_VARIANTS ||
+          draw_llvm_over_code_budget(llvm)) {
          if (gallivm_debug & GALLIVM_DEBUG_PERF) {
             debug_printf("Evicting TCS: %u tcs variants,\t%u total variants\n",
                       shader->variants_cached, llvm->nr_tcs_variants);
@@ -174,7 +181,10 @@ llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
          /*
           * XXX: should we flush here ?
           */
-         for (unsigned i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+         for (unsigned i = 0;
+              i < DRAW_MAX_SHADER_VARIANTS / 32 ||
+                 draw_llvm_over_code_budget(llvm);
+              i++) {
             struct draw_tcs_llvm_variant_list_item *item;
             if (list_is_empty(&llvm->tcs_variants_list.list)) {
                break;
@@ -230,9 +240,11 @@ llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
       /* Need to create new variant */
 
       /* First check if we've created too many variants.  If so, free
-       * 3.125% of the LRU to avoid using too much memory.
+       * 3.125% of the LRU to avoid using too much memory, or more if the
+       * code they hold exceeds the budget.
        */
-      if (llvm->nr_tes_variants >= DRAW_MAX_SHADER_VARIANTS) {
+      if (llvm->nr_tes_variants >= DRAW_MAX_SHADER_VARIANTS ||
+          draw_llvm_over_code_budget(llvm)) {
          if (gallivm_debug & GALLIVM_DEBUG_PERF) {
             debug_printf("Evicting TES: %u tes variants,\t%u total variants\n",
                       shader->variants_cached, llvm->nr_tes_variants);
@@ -241,7 +253,10 @@ llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
          /*
           * XXX: should we flush here ?
           */
-         for (unsigned i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+         for (unsigned i = 0;
+              i < DRAW_MAX_SHADER_VARIANTS / 32 ||
+                 draw_llvm_over_code_budget(llvm);
+              i++) {
             struct draw_tes_llvm_variant_list_item *item;
             if (list_is_empty(&llvm->tes_variants_list.list)) {
                break;
@@ -356,9 +371,11 @@ llvm_middle_end_prepare(struct draw_pt_middle_end *middle,
          /* Need to create new variant */
 
          /* First check if we've created too many variants.  If so, free
-          * 3.125% of the LRU to avoid using too much memory.
+          * 3.125% of the LRU to avoid using too much memory, or more if
+          * the code they hold exceeds the budget.
           */
-         if (llvm->nr_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         if (llvm->nr_variants >= DRAW_MAX_SHADER_VARIANTS ||
+             draw_llvm_over_code_budget(llvm)) {
             if (gallivm_debug & GALLIVM_DEBUG_PERF) {
                debug_printf("Evicting VS: %u vs variants,\t%u total variants\n",
                          shader->variants_cached, llvm->nr_variants);
@@ -367,7 +384,10 @@ llvm_middle_end_prepare(struct draw_pt_middle_end *middle,
             /*
              * XXX: should we flush here ?
              */
-            for (unsigned i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+            for (unsigned i = 0;
+                 i < DRAW_MAX_SHADER_VARIANTS / 32 ||
+                    draw_llvm_over_code_budget(llvm);
+                 i++) {
                struct draw_llvm_variant_list_item *item;
                if (list_is_empty(&llvm->vs_variants_list.list)) {
                   break;
@@ -94,6 +94,11 @@
 
 #define GALLIVM_COROUTINES (GALLIVM_HAVE_CORO || GALLIVM_USE_NEW_PASS)
 
+/* Set by the build to use ORC LLJIT instead of MCJIT. */
+#ifndef GALLIVM_USE_ORCJIT
+#define GALLIVM_USE_ORCJIT 0
+#endif
+
 /* LLVM is transitioning to "opaque pointers", and as such deprecates
  * LLVMBuildGEP, LLVMBuildCall, LLVMBuildLoad, replacing them with
  * LLVMBuildGEP2, LLVMBuildCall2, LLVMBuildLoad2 respectivelly.
@@ -1922,6 +1922,19 @@ lp_build_iround_nearest_sse2(struct lp_build_context *bld,
       if (type.width* type.length == 128) {
          intrinsic = "llvm.x86.sse2.cvtps2dq";
       }
+      else if (type.width*type.length == 512) {
+         LLVMTypeRef i16t = LLVMInt16TypeInContext(bld->gallivm->context);
+         LLVMValueRef args[4];
+
+         assert(util_get_cpu_caps()->has_avx512f);
+
+         args[0] = a;
+         args[1] = LLVMGetUndef(ret_type);
+         args[2] = LLVMConstAllOnes(i16t);
+         args[3] = LLVMConstInt(i32t, 4, 0); /* _MM_FROUND_CUR_DIRECTION */
+         return lp_build_intrinsic(builder, "llvm.x86.avx512.mask.cvtps2dq.512",
+                                   ret_type, args, ARRAY_SIZE(args), 0);
+      }
       else {
          assert(type.width*type.length == 256);
          assert(util_get_cpu_caps()->has_avx);
@@ -2359,7 +2372,9 @@ lp_build_iround(struct lp_build_context *bld,
 
    if ((util_get_cpu_caps()->has_sse2 &&
        ((type.width == 32) && (type.length == 1 || type.length == 4))) ||
-       (util_get_cpu_caps()->has_avx && type.width == 32 && type.length == 8)) {
+       (util_get_cpu_caps()->has_avx && type.width == 32 && type.length == 8) ||
+       (util_get_cpu_caps()->has_avx512f && type.width == 32 &&
+        type.length == 16)) {
       return lp_build_iround_nearest_sse2(bld, a);
    }
    if (arch_rounding_available(type)) {
@@ -2766,7 +2781,9 @@ lp_build_fast_rsqrt_available(struct lp_type type)
    assert(type.floating);
 
    if ((util_get_cpu_caps()->has_sse && type.width == 32 && type.length == 4) ||
-       (util_get_cpu_caps()->has_avx && type.width == 32 && type.length == 8)) {
+       (util_get_cpu_caps()->has_avx && type.width == 32 && type.length == 8) ||
+       (util_get_cpu_caps()->has_avx512f && type.width == 32 &&
+        type.length == 16)) {
       return true;
    }
    return false;
@@ -2794,6 +2811,17 @@ lp_build_fast_rsqrt(struct lp_build_context *bld,
       if (type.length == 4) {
          intrinsic = "llvm.x86.sse.rsqrt.ps";
       }
+      else if (type.length == 16) {
+         LLVMTypeRef i16t = LLVMInt16TypeInContext(bld->gallivm->context);
+         LLVMValueRef args[3];
+
+         /* 14 bits of precision, but that doesn't hurt. */
+         args[0] = a;
+         args[1] = LLVMGetUndef(bld->vec_type);
+         args[2] = LLVMConstAllOnes(i16t);
+         return lp_build_intrinsic(builder, "llvm.x86.avx512.rsqrt14.ps.512",
+                                   bld->vec_type, args, ARRAY_SIZE(args), 0);
+      }
       else {
          intrinsic = "llvm.x86.avx.rsqrt.ps.256";
       }
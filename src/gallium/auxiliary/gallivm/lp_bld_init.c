@@ -64,6 +64,9 @@ static const struct debug_named_value lp_bld_perf_flags[] = {
    { "no_quad_lod", GALLIVM_PERF_NO_QUAD_LOD, "disable quad_lod optimization" },
    { "no_aos_sampling", GALLIVM_PERF_NO_AOS_SAMPLING, "disable aos sampling optimization" },
    { "nopt",   GALLIVM_PERF_NO_OPT, "disable optimization passes to speed up shader compilation" },
+#if GALLIVM_USE_ORCJIT
+   { "lazy",   GALLIVM_PERF_LAZY, "only compile shader functions on first call, at the expense of the shader cache" },
+#endif
    DEBUG_NAMED_VALUE_END
 };
 
@@ -108,8 +111,17 @@ enum LLVM_CodeGenOpt_Level {
 
 
 /**
- * Create the LLVM (optimization) pass manager and install
- * relevant optimization passes.
+ * Whether optimizations are disabled, globally or for this module.
+ */
+static inline bool
+gallivm_no_opt(const struct gallivm_state *gallivm)
+{
+   return (gallivm_perf & GALLIVM_PERF_NO_OPT) || gallivm->no_opt;
+}
+
+
+/**
+ * Create the LLVM (optimization) pass manager.
  * \return  TRUE for success, FALSE for failure
  */
 static bool
@@ -139,7 +151,19 @@ create_pass_manager(struct gallivm_state *gallivm)
       LLVMSetDataLayout(gallivm->module, td_str);
       free(td_str);
    }
+#endif
+   return true;
+}
 
+
+/**
+ * Install the relevant optimization passes.  This is deferred until
+ * compilation so that gallivm_set_no_opt() can still take effect.
+ */
+static void
+add_optimization_passes(struct gallivm_state *gallivm)
+{
+#if GALLIVM_USE_NEW_PASS == 0
 #if GALLIVM_HAVE_CORO == 1
 #if LLVM_VERSION_MAJOR <= 8 && (DETECT_ARCH_AARCH64 || DETECT_ARCH_ARM || DETECT_ARCH_S390 || DETECT_ARCH_MIPS64)
    LLVMAddArgumentPromotionPass(gallivm->cgpassmgr);
@@ -150,7 +174,7 @@ create_pass_manager(struct gallivm_state *gallivm)
    LLVMAddCoroElidePass(gallivm->cgpassmgr);
 #endif
 
-   if ((gallivm_perf & GALLIVM_PERF_NO_OPT) == 0) {
+   if (!gallivm_no_opt(gallivm)) {
       /*
        * TODO: Evaluate passes some more - keeping in mind
        * both quality of generated code and compile times.
@@ -191,7 +215,6 @@ create_pass_manager(struct gallivm_state *gallivm)
    LLVMAddCoroCleanupPass(gallivm->passmgr);
 #endif
 #endif
-   return true;
 }
 
 /**
@@ -233,6 +256,14 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    if (gallivm->builder)
       LLVMDisposeBuilder(gallivm->builder);
 
+#if GALLIVM_USE_ORCJIT
+   /* Unless the JIT took the module, this frees the context too, so it
+    * has to come after everything created in it.
+    */
+   if (gallivm->orc)
+      lp_orc_module_free_ir(gallivm->orc);
+#endif
+
    /* The LLVMContext should be owned by the parent of gallivm. */
 
    gallivm->engine = NULL;
@@ -259,6 +290,10 @@ gallivm_free_code(struct gallivm_state *gallivm)
 {
    assert(!gallivm->module);
    assert(!gallivm->engine);
+#if GALLIVM_USE_ORCJIT
+   lp_orc_module_destroy(gallivm->orc);
+   gallivm->orc = NULL;
+#endif
    lp_free_generated_code(gallivm->code);
    gallivm->code = NULL;
    lp_free_memory_manager(gallivm->memorymgr);
@@ -274,13 +309,17 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
+      if (gallivm_no_opt(gallivm)) {
          optlevel = None;
       }
       else {
          optlevel = Default;
       }
 
+#if GALLIVM_USE_ORCJIT
+      ret = lp_orc_module_init(gallivm->orc, gallivm->module,
+                               (unsigned) optlevel, &error);
+#else
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
                                                     gallivm->cache,
@@ -288,6 +327,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
                                                     gallivm->memorymgr,
                                                     (unsigned) optlevel,
                                                     &error);
+#endif
       if (ret) {
          _debug_printf("%s\n", error);
          LLVMDisposeMessage(error);
@@ -337,7 +377,17 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
    if (!lp_build_init())
       return false;
 
+#if GALLIVM_USE_ORCJIT
+   /* Every module gets a context of its own, which ORC may then compile
+    * on any thread.  The caller's context is not used.
+    */
+   gallivm->orc = lp_orc_module_create(name);
+   if (!gallivm->orc)
+      return false;
+   gallivm->context = lp_orc_module_context(gallivm->orc);
+#else
    gallivm->context = context;
+#endif
    gallivm->cache = cache;
    if (!gallivm->context)
       goto fail;
@@ -364,9 +414,11 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
    if (!gallivm->builder)
       goto fail;
 
+#if !GALLIVM_USE_ORCJIT
    gallivm->memorymgr = lp_get_default_memory_manager();
    if (!gallivm->memorymgr)
       goto fail;
+#endif
 
    /* FIXME: MC-JIT only allows compiling one module at a time, and it must be
     * complete when MC-JIT is created. So defer the MC-JIT engine creation for
@@ -423,8 +475,18 @@ fail:
 unsigned
 lp_build_init_native_width(void)
 {
-   // Default to 256 until we're confident llvmpipe with 512 is as correct and not slower than 256
-   lp_native_vector_width = MIN2(util_get_cpu_caps()->max_vector_bits, 256);
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+   /*
+    * Use 512 bits only with the AVX-512 subsets covering the byte/word and
+    * 64-bit integer operations of the pixel pipeline, so that nothing falls
+    * back to splitting vectors.  Otherwise default to 256.
+    */
+   if (caps->max_vector_bits >= 512 && caps->has_avx512f &&
+       caps->has_avx512bw && caps->has_avx512dq && caps->has_avx512vl)
+      lp_native_vector_width = 512;
+   else
+      lp_native_vector_width = MIN2(caps->max_vector_bits, 256);
    assert(lp_native_vector_width);
 
    lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH", lp_native_vector_width);
@@ -504,6 +566,18 @@ gallivm_create(const char *name, LLVMContextRef context,
 }
 
 
+/**
+ * Compile the module with optimizations disabled, trading code quality
+ * for compile time.  Must be called before gallivm_compile_module().
+ */
+void
+gallivm_set_no_opt(struct gallivm_state *gallivm)
+{
+   assert(!gallivm->compiled);
+   gallivm->no_opt = true;
+}
+
+
 /**
  * Destroy a gallivm_state object.
  */
@@ -540,6 +614,55 @@ gallivm_verify_function(struct gallivm_state *gallivm,
    }
 }
 
+#if GALLIVM_USE_NEW_PASS == 1
+static LLVMTargetMachineRef
+gallivm_target_machine(struct gallivm_state *gallivm)
+{
+#if GALLIVM_USE_ORCJIT
+   return lp_orc_module_target_machine(gallivm->orc);
+#else
+   return LLVMGetExecutionEngineTargetMachine(gallivm->engine);
+#endif
+}
+#endif
+
+
+/**
+ * Resolve the given module symbol to the address \p addr.
+ */
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr)
+{
+#if GALLIVM_USE_ORCJIT
+   lp_orc_module_add_global_mapping(gallivm->orc, global, addr);
+#else
+   assert(gallivm->engine);
+   LLVMAddGlobalMapping(gallivm->engine, global, addr);
+#endif
+}
+
+
+static void *
+gallivm_get_function_address(struct gallivm_state *gallivm,
+                             LLVMValueRef func)
+{
+#if GALLIVM_USE_ORCJIT
+   /*
+    * The module is handed to the JIT on first use, once the caller is done
+    * inspecting it.  If the JIT compiles it lazily, it takes the module.
+    */
+   if (gallivm->module &&
+       lp_orc_module_add(gallivm->orc, gallivm->module, gallivm->cache))
+      gallivm->module = NULL;
+
+   return lp_orc_module_lookup(gallivm->orc, func);
+#else
+   assert(gallivm->engine);
+   return LLVMGetPointerToGlobal(gallivm->engine, func);
+#endif
+}
+
 void lp_init_clock_hook(struct gallivm_state *gallivm)
 {
    if (gallivm->get_time_hook)
@@ -570,7 +693,9 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (!init_gallivm_engine(gallivm)) {
       assert(0);
    }
+#if !GALLIVM_USE_ORCJIT
    assert(gallivm->engine);
+#endif
 
    if (gallivm->cache && gallivm->cache->data_size) {
       goto skip_cached;
@@ -584,10 +709,10 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       LLVMWriteBitcodeToFile(gallivm->module, filename);
       debug_printf("%s written\n", filename);
       debug_printf("Invoke as \"opt %s %s | llc -O%d %s%s\"\n",
-                   gallivm_perf & GALLIVM_PERF_NO_OPT ? "-mem2reg" :
+                   gallivm_no_opt(gallivm) ? "-mem2reg" :
                    "-sroa -early-cse -simplifycfg -reassociate "
                    "-mem2reg -constprop -instcombine -gvn",
-                   filename, gallivm_perf & GALLIVM_PERF_NO_OPT ? 0 : 2,
+                   filename, gallivm_no_opt(gallivm) ? 0 : 2,
                    "[-mcpu=<-mcpu option>] ",
                    "[-mattr=<-mattr option(s)>]");
    }
@@ -606,16 +731,17 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    strcpy(passes, "default<O0>");
 
    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
-   LLVMRunPasses(gallivm->module, passes, LLVMGetExecutionEngineTargetMachine(gallivm->engine), opts);
+   LLVMRunPasses(gallivm->module, passes, gallivm_target_machine(gallivm), opts);
 
-   if (!(gallivm_perf & GALLIVM_PERF_NO_OPT))
+   if (!gallivm_no_opt(gallivm))
       strcpy(passes, "sroa,early-cse,simplifycfg,reassociate,mem2reg,instsimplify,instcombine");
    else
       strcpy(passes, "mem2reg");
 
-   LLVMRunPasses(gallivm->module, passes, LLVMGetExecutionEngineTargetMachine(gallivm->engine), opts);
+   LLVMRunPasses(gallivm->module, passes, gallivm_target_machine(gallivm), opts);
    LLVMDisposePassBuilderOptions(opts);
 #else
+   add_optimization_passes(gallivm);
 #if GALLIVM_HAVE_CORO == 1
    LLVMRunPassManager(gallivm->cgpassmgr, gallivm->module);
 #endif
@@ -670,10 +796,10 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    ++gallivm->compiled;
 
    lp_init_printf_hook(gallivm);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->debug_printf_hook, debug_printf);
+   gallivm_add_global_mapping(gallivm, gallivm->debug_printf_hook, debug_printf);
 
    lp_init_clock_hook(gallivm);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->get_time_hook, os_time_get_nano);
+   gallivm_add_global_mapping(gallivm, gallivm->get_time_hook, os_time_get_nano);
 
    lp_build_coro_add_malloc_hooks(gallivm);
 
@@ -687,7 +813,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
           * LLVMGetPointerToGlobal() will abort otherwise.
           */
          if (!LLVMIsDeclaration(llvm_func)) {
-            void *func_code = LLVMGetPointerToGlobal(gallivm->engine, llvm_func);
+            void *func_code = gallivm_get_function_address(gallivm, llvm_func);
             lp_disassemble(llvm_func, func_code);
          }
          llvm_func = LLVMGetNextFunction(llvm_func);
@@ -700,7 +826,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
       while (llvm_func) {
          if (!LLVMIsDeclaration(llvm_func)) {
-            void *func_code = LLVMGetPointerToGlobal(gallivm->engine, llvm_func);
+            void *func_code = gallivm_get_function_address(gallivm, llvm_func);
             lp_profile(llvm_func, func_code);
          }
          llvm_func = LLVMGetNextFunction(llvm_func);
@@ -711,6 +837,21 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
 
 
+/**
+ * Bytes of machine code and data the JIT holds for this module.
+ * Only meaningful once the functions have been jitted.
+ */
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm)
+{
+#if GALLIVM_USE_ORCJIT
+   if (gallivm->orc)
+      return lp_orc_module_code_size(gallivm->orc);
+#endif
+   return gallivm->code ? lp_generated_code_size(gallivm->code) : 0;
+}
+
+
 func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func)
@@ -720,12 +861,11 @@ gallivm_jit_function(struct gallivm_state *gallivm,
    int64_t time_begin = 0;
 
    assert(gallivm->compiled);
-   assert(gallivm->engine);
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
-   code = LLVMGetPointerToGlobal(gallivm->engine, func);
+   code = gallivm_get_function_address(gallivm, func);
    assert(code);
    jit_func = pointer_to_func(code);
 
@@ -733,7 +873,12 @@ gallivm_jit_function(struct gallivm_state *gallivm,
       int64_t time_end = os_time_get();
       int time_msec = (int)(time_end - time_begin) / 1000;
       debug_printf("   jitting func %s took %d msec\n",
-                   LLVMGetValueName(func), time_msec);
+#if GALLIVM_USE_ORCJIT
+                   lp_orc_module_function_name(gallivm->orc, func),
+#else
+                   LLVMGetValueName(func),
+#endif
+                   time_msec);
    }
 
    return jit_func;
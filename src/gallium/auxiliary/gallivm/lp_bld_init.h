@@ -40,11 +40,15 @@ extern "C" {
 #endif
 
 struct lp_cached_code;
+struct lp_orc_module;
 struct gallivm_state
 {
    char *module_name;
    LLVMModuleRef module;
    LLVMExecutionEngineRef engine;
+#if GALLIVM_USE_ORCJIT
+   struct lp_orc_module *orc;
+#endif
    LLVMTargetDataRef target;
 #if GALLIVM_USE_NEW_PASS == 0
    LLVMPassManagerRef passmgr;
@@ -58,6 +62,7 @@ struct gallivm_state
    struct lp_generated_code *code;
    struct lp_cached_code *cache;
    unsigned compiled;
+   bool no_opt;
    LLVMValueRef coro_malloc_hook;
    LLVMValueRef coro_free_hook;
    LLVMValueRef debug_printf_hook;
@@ -85,6 +90,9 @@ gallivm_create(const char *name, LLVMContextRef context,
 void
 gallivm_destroy(struct gallivm_state *gallivm);
 
+void
+gallivm_set_no_opt(struct gallivm_state *gallivm);
+
 void
 gallivm_free_ir(struct gallivm_state *gallivm);
 
@@ -99,6 +107,13 @@ func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func);
 
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr);
+
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm);
+
 unsigned gallivm_get_perf_flags(void);
 
 void lp_init_clock_hook(struct gallivm_state *gallivm);
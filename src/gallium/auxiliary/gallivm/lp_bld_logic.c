@@ -350,6 +350,18 @@ lp_build_select(struct lp_build_context *bld,
 
       res = LLVMBuildSelect(builder, mask, a, b, "");
    }
+   else if (util_get_cpu_caps()->has_avx512f &&
+            type.width * type.length == 512 &&
+            (type.width >= 32 || util_get_cpu_caps()->has_avx512bw)) {
+      /*
+       * There is no blendv for 512-bit vectors, but a compare against zero
+       * gives the mask in a mask register, which blends with vpblendm.
+       */
+      LLVMTypeRef mask_type = LLVMTypeOf(mask);
+      mask = LLVMBuildICmp(builder, LLVMIntSLT, mask,
+                           LLVMConstNull(mask_type), "");
+      res = LLVMBuildSelect(builder, mask, a, b, "");
+   }
    else if (((util_get_cpu_caps()->has_sse4_1 &&
               type.width * type.length == 128) ||
              (util_get_cpu_caps()->has_avx &&
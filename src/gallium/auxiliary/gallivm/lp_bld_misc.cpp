@@ -86,6 +86,15 @@
 #include <llvm/ExecutionEngine/JITEventListener.h>
 #endif
 
+#if GALLIVM_USE_ORCJIT
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <unordered_map>
+#endif
+
 #if LLVM_VERSION_MAJOR < 7
 // Workaround http://llvm.org/PR23628
 #pragma pop_macro("DEBUG")
@@ -96,9 +105,11 @@
 #include "util/detect.h"
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
+#include "util/u_atomic.h"
 
 #include "lp_bld_misc.h"
 #include "lp_bld_debug.h"
+#include "lp_bld_type.h"
 
 namespace {
 
@@ -255,9 +266,12 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
       typedef std::vector<void *> Vec;
       Vec FunctionBody, ExceptionTable;
       BaseMemoryManager *TheMM;
+      /* Bytes of code and data allocated for this engine. */
+      size_t Size;
 
       GeneratedCode(BaseMemoryManager *MM) {
          TheMM = MM;
+         Size = 0;
       }
 
       ~GeneratedCode() {
@@ -292,6 +306,29 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
          delete (GeneratedCode *) code;
       }
 
+      static size_t generatedCodeSize(struct lp_generated_code *code) {
+         return ((GeneratedCode *) code)->Size;
+      }
+
+      virtual uint8_t *allocateCodeSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName) {
+         code->Size += Size;
+         return DelegatingJITMemoryManager::allocateCodeSection(
+            Size, Alignment, SectionID, SectionName);
+      }
+
+      virtual uint8_t *allocateDataSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName,
+                                           bool IsReadOnly) {
+         code->Size += Size;
+         return DelegatingJITMemoryManager::allocateDataSection(
+            Size, Alignment, SectionID, SectionName, IsReadOnly);
+      }
+
       virtual void deallocateFunctionBody(void *Body) {
          // remember for later deallocation
          code->FunctionBody.push_back(Body);
@@ -330,69 +367,14 @@ public:
 };
 
 /**
- * Same as LLVMCreateJITCompilerForModule, but:
- * - allows using MCJIT and enabling AVX feature where available.
- * - set target options
- *
- * See also:
- * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
- * - llvm/tools/lli/lli.cpp
- * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ * Compute the -mattr and -mcpu options for the host.
  */
-extern "C"
-LLVMBool
-lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
-                                        lp_generated_code **OutCode,
-                                        struct lp_cached_code *cache_out,
-                                        LLVMModuleRef M,
-                                        LLVMMCJITMemoryManagerRef CMM,
-                                        unsigned OptLevel,
-                                        char **OutError)
+static void
+lp_build_get_host_target(llvm::SmallVector<std::string, 16> &MAttrs,
+                         llvm::StringRef &MCPU)
 {
    using namespace llvm;
 
-   std::string Error;
-   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
-
-   /**
-    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
-    * friends for configuring code generation options, like stack alignment.
-    */
-   TargetOptions options;
-#if DETECT_ARCH_X86 && LLVM_VERSION_MAJOR < 13
-   options.StackAlignmentOverride = 4;
-#endif
-
-   builder.setEngineKind(EngineKind::JIT)
-          .setErrorStr(&Error)
-          .setTargetOptions(options)
-#if LLVM_VERSION_MAJOR >= 18
-          .setOptLevel((CodeGenOptLevel)OptLevel);
-#else
-          .setOptLevel((CodeGenOpt::Level)OptLevel);
-#endif
-
-#if DETECT_OS_WINDOWS
-    /*
-     * MCJIT works on Windows, but currently only through ELF object format.
-     *
-     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
-     * different strings for MinGW/MSVC, so better play it safe and be
-     * explicit.
-     */
-#  if DETECT_ARCH_X86_64
-    LLVMSetTarget(M, "x86_64-pc-win32-elf");
-#  elif DETECT_ARCH_X86
-    LLVMSetTarget(M, "i686-pc-win32-elf");
-#  elif DETECT_ARCH_AARCH64
-    LLVMSetTarget(M, "aarch64-pc-win32-elf");
-#  else
-#    error Unsupported architecture for MCJIT on Windows.
-#  endif
-#endif
-
-   llvm::SmallVector<std::string, 16> MAttrs;
-
 #if DETECT_ARCH_ARM
    /* llvm-3.3+ implements sys::getHostCPUFeatures for Arm,
     * which allows us to enable/disable code generation based
@@ -437,6 +419,15 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    MAttrs.push_back(util_get_cpu_caps()->has_avx512bw ? "+avx512bw"  : "-avx512bw");
    MAttrs.push_back(util_get_cpu_caps()->has_avx512dq ? "+avx512dq"  : "-avx512dq");
    MAttrs.push_back(util_get_cpu_caps()->has_avx512vl ? "+avx512vl"  : "-avx512vl");
+
+#if LLVM_VERSION_MAJOR >= 7
+   /*
+    * Host CPUs with AVX-512 tend to be tuned to prefer 256-bit vectors, in
+    * which case LLVM splits our 512-bit vectors in two unless told otherwise.
+    */
+   if (lp_native_vector_width >= 512)
+      MAttrs.push_back("-prefer-256-bit");
+#endif
 #endif
 #if DETECT_ARCH_ARM
    if (!util_get_cpu_caps()->has_neon) {
@@ -469,8 +460,6 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    MAttrs.push_back("+fp64");
 #endif
 
-   builder.setMAttrs(MAttrs);
-
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
       int n = MAttrs.size();
       if (n > 0) {
@@ -481,7 +470,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       }
    }
 
-   StringRef MCPU = llvm::sys::getHostCPUName();
+   MCPU = llvm::sys::getHostCPUName();
    /*
     * The cpu bits are no longer set automatically, so need to set mcpu manually.
     * Note that the MAttrs set above will be sort of ignored (since we should
@@ -495,19 +484,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
     * can't handle. Not entirely sure if we really need to do anything yet.
     */
 
-#if DETECT_ARCH_PPC_64
-   /*
-    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
-    * of the Medium code model once dynamically generated JIT-compiled shader
-    * programs are linked in and relocated.  Yet the default code model as of
-    * LLVM 8 is Medium or even Small.
-    * The cost of changing from Medium to Large is negligible:
-    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
-    * - change an add-immediate (addis) instruction to a load (ld).
-    */
-   builder.setCodeModel(CodeModel::Large);
-
-#if UTIL_ARCH_LITTLE_ENDIAN
+#if DETECT_ARCH_PPC_64 && UTIL_ARCH_LITTLE_ENDIAN
    /*
     * Versions of LLVM prior to 4.0 lacked a table entry for "POWER8NVL",
     * resulting in (big-endian) "generic" being returned on
@@ -520,7 +497,6 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    if (MCPU == "generic")
       MCPU = "pwr8";
 #endif
-#endif
 
 #if DETECT_ARCH_MIPS64
       /*
@@ -534,10 +510,92 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       MCPU = util_get_cpu_caps()->has_msa ? "mips64r5" : "mips64r2";
 #endif
 
-   builder.setMCPU(MCPU);
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
       debug_printf("llc -mcpu option: %s\n", MCPU.str().c_str());
    }
+}
+
+/**
+ * Same as LLVMCreateJITCompilerForModule, but:
+ * - allows using MCJIT and enabling AVX feature where available.
+ * - set target options
+ *
+ * See also:
+ * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
+ * - llvm/tools/lli/lli.cpp
+ * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ */
+extern "C"
+LLVMBool
+lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
+                                        lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
+                                        LLVMModuleRef M,
+                                        LLVMMCJITMemoryManagerRef CMM,
+                                        unsigned OptLevel,
+                                        char **OutError)
+{
+   using namespace llvm;
+
+   std::string Error;
+   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
+
+   /**
+    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
+    * friends for configuring code generation options, like stack alignment.
+    */
+   TargetOptions options;
+#if DETECT_ARCH_X86 && LLVM_VERSION_MAJOR < 13
+   options.StackAlignmentOverride = 4;
+#endif
+
+   builder.setEngineKind(EngineKind::JIT)
+          .setErrorStr(&Error)
+          .setTargetOptions(options)
+#if LLVM_VERSION_MAJOR >= 18
+          .setOptLevel((CodeGenOptLevel)OptLevel);
+#else
+          .setOptLevel((CodeGenOpt::Level)OptLevel);
+#endif
+
+#if DETECT_OS_WINDOWS
+    /*
+     * MCJIT works on Windows, but currently only through ELF object format.
+     *
+     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
+     * different strings for MinGW/MSVC, so better play it safe and be
+     * explicit.
+     */
+#  if DETECT_ARCH_X86_64
+    LLVMSetTarget(M, "x86_64-pc-win32-elf");
+#  elif DETECT_ARCH_X86
+    LLVMSetTarget(M, "i686-pc-win32-elf");
+#  elif DETECT_ARCH_AARCH64
+    LLVMSetTarget(M, "aarch64-pc-win32-elf");
+#  else
+#    error Unsupported architecture for MCJIT on Windows.
+#  endif
+#endif
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   StringRef MCPU;
+
+   lp_build_get_host_target(MAttrs, MCPU);
+   builder.setMAttrs(MAttrs);
+   builder.setMCPU(MCPU);
+
+#if DETECT_ARCH_PPC_64
+   /*
+    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
+    * of the Medium code model once dynamically generated JIT-compiled shader
+    * programs are linked in and relocated.  Yet the default code model as of
+    * LLVM 8 is Medium or even Small.
+    * The cost of changing from Medium to Large is negligible:
+    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
+    * - change an add-immediate (addis) instruction to a load (ld).
+    */
+   builder.setCodeModel(CodeModel::Large);
+#endif
 
    ShaderMemoryManager *MM = NULL;
    BaseMemoryManager* JMM = reinterpret_cast<BaseMemoryManager*>(CMM);
@@ -580,6 +638,13 @@ lp_free_generated_code(struct lp_generated_code *code)
    ShaderMemoryManager::freeGeneratedCode(code);
 }
 
+extern "C"
+size_t
+lp_generated_code_size(struct lp_generated_code *code)
+{
+   return ShaderMemoryManager::generatedCodeSize(code);
+}
+
 extern "C"
 LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager()
@@ -623,3 +688,384 @@ lp_set_module_stack_alignment_override(LLVMModuleRef MRef, unsigned align)
    M->setOverrideStackAlignment(align);
 #endif
 }
+
+#if GALLIVM_USE_ORCJIT
+
+/*
+ * ORC LLJIT backend.
+ *
+ * All gallivm modules share a single LLJIT instance, i.e. one execution
+ * session with a pool of compile threads.  Each module gets its own
+ * JITDylib, so its code can be released independently of the others, and
+ * its own LLVMContext, so ORC can compile it on whichever thread first
+ * calls into it without racing against IR being built for other modules.
+ *
+ * Where the target supports it, modules are materialized lazily, one
+ * function at a time, on first call: shader variants come with several
+ * entry points (e.g. the whole tile, partial tile and linear fragment
+ * functions) of which often only some ever run.  Modules which must
+ * produce an object for the shader cache, or are to be disassembled, are
+ * instead compiled as a whole on the calling thread, like with MCJIT.
+ */
+
+struct lp_orc_module {
+   std::string name;
+   llvm::orc::ThreadSafeContext ts_context;
+   llvm::orc::JITDylib *dylib;
+   std::unique_ptr<llvm::TargetMachine> tm;
+   /* Names of the defined functions, as the module may be gone by the
+    * time they are looked up. */
+   std::unordered_map<LLVMValueRef, std::string> functions;
+   /* Size of the object, or an estimate of it for lazily compiled
+    * modules, whose functions may not have been materialized yet. */
+   size_t code_size;
+   bool added;
+};
+
+namespace {
+
+class LPJit {
+public:
+   LPJit(llvm::orc::JITTargetMachineBuilder JTMB) :
+      jtmb(std::move(JTMB)), jit(NULL), next_dylib_id(0) {
+   }
+
+   llvm::orc::JITTargetMachineBuilder jtmb;
+   std::unique_ptr<llvm::orc::LLLazyJIT> lazy_jit;
+   std::unique_ptr<llvm::orc::LLJIT> eager_jit;
+   llvm::orc::LLJIT *jit;
+   unsigned next_dylib_id;
+};
+
+}
+
+static once_flag lp_jit_once_flag = ONCE_FLAG_INIT;
+static LPJit *lp_jit = NULL;
+
+static void
+lp_orc_lazy_compile_failure(void)
+{
+   _debug_printf("gallivm: lazy compilation of a shader function failed\n");
+   abort();
+}
+
+static void
+lp_orc_report_error(const char *what, llvm::Error err)
+{
+   _debug_printf("gallivm: %s: %s\n", what,
+                 llvm::toString(std::move(err)).c_str());
+}
+
+static llvm::orc::JITTargetMachineBuilder
+lp_orc_target_machine_builder(void)
+{
+   using namespace llvm;
+
+   orc::JITTargetMachineBuilder JTMB((Triple(sys::getProcessTriple())));
+
+#if DETECT_OS_WINDOWS
+   /* Like MCJIT, only ELF objects are supported on Windows. */
+   JTMB.getTargetTriple().setObjectFormat(Triple::ELF);
+#endif
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   StringRef MCPU;
+
+   lp_build_get_host_target(MAttrs, MCPU);
+   JTMB.setCPU(MCPU.str());
+   JTMB.addFeatures(std::vector<std::string>(MAttrs.begin(), MAttrs.end()));
+
+#if LLVM_VERSION_MAJOR >= 18
+   if (gallivm_perf & GALLIVM_PERF_NO_OPT)
+      JTMB.setCodeGenOptLevel(CodeGenOptLevel::None);
+   else
+      JTMB.setCodeGenOptLevel(CodeGenOptLevel::Default);
+#else
+   if (gallivm_perf & GALLIVM_PERF_NO_OPT)
+      JTMB.setCodeGenOptLevel(CodeGenOpt::None);
+   else
+      JTMB.setCodeGenOptLevel(CodeGenOpt::Default);
+#endif
+
+#if DETECT_ARCH_PPC_64
+   /* See lp_build_create_jit_compiler_for_module. */
+   JTMB.setCodeModel(CodeModel::Large);
+#endif
+
+   return JTMB;
+}
+
+static void
+lp_jit_create(void)
+{
+   using namespace llvm;
+   using namespace llvm::orc;
+
+   LPJit *J = new LPJit(lp_orc_target_machine_builder());
+   unsigned num_threads =
+      debug_get_num_option("GALLIVM_COMPILE_THREADS",
+                           MIN2(util_get_cpu_caps()->nr_cpus, 4));
+
+   auto lazy = LLLazyJITBuilder()
+                  .setJITTargetMachineBuilder(J->jtmb)
+                  .setNumCompileThreads(num_threads)
+#if LLVM_VERSION_MAJOR >= 16
+                  .setLazyCompileFailureAddr(
+                     ExecutorAddr::fromPtr(&lp_orc_lazy_compile_failure))
+#else
+                  .setLazyCompileFailureAddr(
+                     pointerToJITTargetAddress(&lp_orc_lazy_compile_failure))
+#endif
+                  .create();
+   if (lazy) {
+      J->lazy_jit = std::move(*lazy);
+      J->jit = J->lazy_jit.get();
+   } else {
+      /* No lazy call-through support for this target, so everything gets
+       * compiled up front.
+       */
+      consumeError(lazy.takeError());
+
+      auto eager = LLJITBuilder()
+                      .setJITTargetMachineBuilder(J->jtmb)
+                      .setNumCompileThreads(num_threads)
+                      .create();
+      if (!eager) {
+         lp_orc_report_error("failed to create ORC JIT", eager.takeError());
+         delete J;
+         return;
+      }
+      J->eager_jit = std::move(*eager);
+      J->jit = J->eager_jit.get();
+   }
+
+   lp_jit = J;
+}
+
+extern "C" struct lp_orc_module *
+lp_orc_module_create(const char *name)
+{
+   using namespace llvm;
+   using namespace llvm::orc;
+
+   call_once(&lp_jit_once_flag, lp_jit_create);
+   if (!lp_jit)
+      return NULL;
+
+   std::unique_ptr<LLVMContext> context = std::make_unique<LLVMContext>();
+#if LLVM_VERSION_MAJOR == 15
+   context->setOpaquePointers(false);
+#endif
+
+   lp_orc_module *orc = new lp_orc_module();
+   orc->ts_context = ThreadSafeContext(std::move(context));
+   orc->code_size = 0;
+   orc->added = false;
+
+   /* JITDylib names must be unique within the session. */
+   orc->name = std::string(name ? name : "gallivm") + "." +
+               std::to_string(p_atomic_inc_return(&lp_jit->next_dylib_id));
+
+   ExecutionSession &ES = lp_jit->jit->getExecutionSession();
+   orc->dylib = &ES.createBareJITDylib(orc->name);
+
+   /* Resolve anything not defined by the module itself (libm, compiler
+    * runtime helpers, ...) against the process, as MCJIT does.
+    */
+   auto generator = DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      lp_jit->jit->getDataLayout().getGlobalPrefix());
+   if (generator)
+      orc->dylib->addGenerator(std::move(*generator));
+   else
+      lp_orc_report_error("failed to search process symbols",
+                          generator.takeError());
+
+   return orc;
+}
+
+extern "C" LLVMContextRef
+lp_orc_module_context(struct lp_orc_module *orc)
+{
+   return llvm::wrap(orc->ts_context.getContext());
+}
+
+extern "C" int
+lp_orc_module_init(struct lp_orc_module *orc,
+                   LLVMModuleRef M,
+                   unsigned OptLevel,
+                   char **OutError)
+{
+   using namespace llvm;
+
+   /* Used for whole module compiles; lazy ones use the session's level. */
+   orc::JITTargetMachineBuilder JTMB = lp_jit->jtmb;
+#if LLVM_VERSION_MAJOR >= 18
+   JTMB.setCodeGenOptLevel((CodeGenOptLevel)OptLevel);
+#else
+   JTMB.setCodeGenOptLevel((CodeGenOpt::Level)OptLevel);
+#endif
+   auto tm = JTMB.createTargetMachine();
+   if (!tm) {
+      *OutError = strdup(toString(tm.takeError()).c_str());
+      return 1;
+   }
+   orc->tm = std::move(*tm);
+
+   Module *mod = unwrap(M);
+   mod->setDataLayout(lp_jit->jit->getDataLayout());
+   mod->setTargetTriple(lp_jit->jit->getTargetTriple().str());
+   return 0;
+}
+
+extern "C" LLVMTargetMachineRef
+lp_orc_module_target_machine(struct lp_orc_module *orc)
+{
+   return reinterpret_cast<LLVMTargetMachineRef>(orc->tm.get());
+}
+
+extern "C" void
+lp_orc_module_add_global_mapping(struct lp_orc_module *orc,
+                                 LLVMValueRef global,
+                                 void *addr)
+{
+   using namespace llvm;
+   using namespace llvm::orc;
+
+   SymbolMap symbols;
+   JITSymbolFlags flags = JITSymbolFlags::Exported | JITSymbolFlags::Callable;
+
+   symbols[lp_jit->jit->mangleAndIntern(LLVMGetValueName(global))] =
+#if LLVM_VERSION_MAJOR >= 17
+      ExecutorSymbolDef(ExecutorAddr::fromPtr(addr), flags);
+#else
+      JITEvaluatedSymbol(pointerToJITTargetAddress(addr), flags);
+#endif
+
+   if (Error err = orc->dylib->define(absoluteSymbols(std::move(symbols))))
+      lp_orc_report_error("failed to map global", std::move(err));
+}
+
+/**
+ * Hand the module over to the JIT.
+ * Returns true if the JIT took ownership of the module.
+ */
+extern "C" bool
+lp_orc_module_add(struct lp_orc_module *orc,
+                  LLVMModuleRef M,
+                  struct lp_cached_code *cache)
+{
+   using namespace llvm;
+   using namespace llvm::orc;
+
+   if (orc->added)
+      return false;
+   orc->added = true;
+
+   Module *mod = unwrap(M);
+   for (Function &F : *mod) {
+      if (!F.isDeclaration())
+         orc->functions[wrap(&F)] = F.getName().str();
+   }
+
+   bool lazy = lp_jit->lazy_jit && !(gallivm_debug & GALLIVM_DEBUG_ASM);
+#if defined(PROFILE)
+   lazy = false;
+#endif
+   if (cache && !cache->data_size && (gallivm_perf & GALLIVM_PERF_LAZY))
+      cache->dont_cache = true;
+   if (cache && (cache->data_size || !cache->dont_cache))
+      lazy = false;
+
+   if (lazy) {
+      /* Roughly what x86 averages per IR instruction in shader code. */
+      for (Function &F : *mod)
+         orc->code_size += F.getInstructionCount() * 8;
+
+      ThreadSafeModule tsm(std::unique_ptr<Module>(mod), orc->ts_context);
+      if (Error err = lp_jit->lazy_jit->addLazyIRModule(*orc->dylib,
+                                                        std::move(tsm)))
+         lp_orc_report_error("failed to add module", std::move(err));
+      return true;
+   }
+
+   LPObjectCache *objcache = NULL;
+   if (cache) {
+      objcache = new LPObjectCache(cache);
+      cache->jit_obj_cache = (void *)objcache;
+   }
+
+   SimpleCompiler compiler(*orc->tm, objcache);
+   auto obj = compiler(*mod);
+   if (!obj) {
+      lp_orc_report_error("failed to compile module", obj.takeError());
+      return false;
+   }
+   orc->code_size = (*obj)->getBufferSize();
+
+   if (Error err = lp_jit->jit->addObjectFile(*orc->dylib, std::move(*obj)))
+      lp_orc_report_error("failed to add object", std::move(err));
+   return false;
+}
+
+extern "C" void *
+lp_orc_module_lookup(struct lp_orc_module *orc, LLVMValueRef func)
+{
+   using namespace llvm;
+
+   auto it = orc->functions.find(func);
+   if (it == orc->functions.end())
+      return NULL;
+
+   auto sym = lp_jit->jit->lookup(*orc->dylib, it->second);
+   if (!sym) {
+      lp_orc_report_error("failed to look up function", sym.takeError());
+      return NULL;
+   }
+
+#if LLVM_VERSION_MAJOR >= 15
+   return sym->toPtr<void *>();
+#else
+   return jitTargetAddressToPointer<void *>(sym->getAddress());
+#endif
+}
+
+extern "C" const char *
+lp_orc_module_function_name(struct lp_orc_module *orc, LLVMValueRef func)
+{
+   auto it = orc->functions.find(func);
+   return it != orc->functions.end() ? it->second.c_str() : "";
+}
+
+extern "C" size_t
+lp_orc_module_code_size(struct lp_orc_module *orc)
+{
+   return orc->code_size;
+}
+
+/**
+ * Drop what is only needed while building and compiling the module.
+ * The context lives on for as long as the JIT still needs it.
+ */
+extern "C" void
+lp_orc_module_free_ir(struct lp_orc_module *orc)
+{
+   orc->functions.clear();
+   orc->tm.reset();
+   orc->ts_context = llvm::orc::ThreadSafeContext();
+}
+
+extern "C" void
+lp_orc_module_destroy(struct lp_orc_module *orc)
+{
+   if (!orc)
+      return;
+
+   /* This frees the generated code along with anything not compiled yet. */
+   llvm::orc::ExecutionSession &ES = lp_jit->jit->getExecutionSession();
+   if (llvm::Error err = ES.removeJITDylib(*orc->dylib))
+      lp_orc_report_error("failed to remove module", std::move(err));
+
+   delete orc;
+}
+
+#endif /* GALLIVM_USE_ORCJIT */
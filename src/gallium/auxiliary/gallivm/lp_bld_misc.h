@@ -34,6 +34,7 @@
 #include <llvm/Config/llvm-config.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
 
 
 #ifdef __cplusplus
@@ -77,6 +78,9 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 extern void
 lp_free_generated_code(struct lp_generated_code *code);
 
+extern size_t
+lp_generated_code_size(struct lp_generated_code *code);
+
 extern LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager();
 
@@ -94,6 +98,50 @@ lp_free_objcache(void *objcache);
 
 void
 lp_set_module_stack_alignment_override(LLVMModuleRef M, unsigned align);
+
+#if GALLIVM_USE_ORCJIT
+struct lp_orc_module;
+
+struct lp_orc_module *
+lp_orc_module_create(const char *name);
+
+LLVMContextRef
+lp_orc_module_context(struct lp_orc_module *orc);
+
+int
+lp_orc_module_init(struct lp_orc_module *orc,
+                   LLVMModuleRef M,
+                   unsigned OptLevel,
+                   char **OutError);
+
+LLVMTargetMachineRef
+lp_orc_module_target_machine(struct lp_orc_module *orc);
+
+void
+lp_orc_module_add_global_mapping(struct lp_orc_module *orc,
+                                 LLVMValueRef global,
+                                 void *addr);
+
+bool
+lp_orc_module_add(struct lp_orc_module *orc,
+                  LLVMModuleRef M,
+                  struct lp_cached_code *cache);
+
+void *
+lp_orc_module_lookup(struct lp_orc_module *orc, LLVMValueRef func);
+
+const char *
+lp_orc_module_function_name(struct lp_orc_module *orc, LLVMValueRef func);
+
+size_t
+lp_orc_module_code_size(struct lp_orc_module *orc);
+
+void
+lp_orc_module_free_ir(struct lp_orc_module *orc);
+
+void
+lp_orc_module_destroy(struct lp_orc_module *orc);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -127,6 +127,7 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
    state->pot_height = util_is_power_of_two_or_zero(texture->height0);
    state->pot_depth = util_is_power_of_two_or_zero(texture->depth0);
    state->level_zero_only = !view->u.tex.last_level;
+   state->tiled = !!(texture->flags & LP_RESOURCE_FLAG_TILED);
 
    /*
     * the layer / element / level parameters are all either dynamic
@@ -2090,6 +2091,9 @@ lp_build_cube_lookup(struct lp_build_sample_context *bld,
  *
  * @param coord   coordinate in pixels
  * @param stride  number of bytes between rows of successive pixel blocks
+ * @param tile_stride  for tiled textures, number of bytes between
+ *                     successive tiles, in which case stride only applies
+ *                     to the blocks within a tile; NULL otherwise
  * @param block_length  number of pixels in a pixels block along the coordinate
  *                      axis
  * @param out_offset    resulting relative offset of the pixel block in bytes
@@ -2100,6 +2104,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                unsigned block_length,
                                LLVMValueRef coord,
                                LLVMValueRef stride,
+                               LLVMValueRef tile_stride,
                                LLVMValueRef *out_offset,
                                LLVMValueRef *out_subcoord)
 {
@@ -2131,7 +2136,19 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 #endif
    }
 
-   offset = lp_build_mul(bld, coord, stride);
+   if (tile_stride) {
+      unsigned logbase2 = util_logbase2(LP_TEXTURE_TILE_SIZE);
+      LLVMValueRef tile_shift = lp_build_const_int_vec(bld->gallivm, bld->type, logbase2);
+      LLVMValueRef tile_mask = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                                      LP_TEXTURE_TILE_SIZE - 1);
+      LLVMValueRef tile = LLVMBuildLShr(builder, coord, tile_shift, "");
+      coord = LLVMBuildAnd(builder, coord, tile_mask, "");
+      offset = lp_build_add(bld,
+                            lp_build_mul(bld, tile, tile_stride),
+                            lp_build_mul(bld, coord, stride));
+   } else {
+      offset = lp_build_mul(bld, coord, stride);
+   }
 
    assert(out_offset);
    assert(out_subcoord);
@@ -2141,6 +2158,37 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Get the strides for addressing a texture stored in micro-tiles, see
+ * LP_RESOURCE_FLAG_TILED.  Within a tile, blocks are a block apart along
+ * x and a tile row apart along y, while tiles are a whole tile apart
+ * along x and LP_TEXTURE_TILE_SIZE rows of the level apart along y.
+ *
+ * @param row_stride     row stride of the level in bytes
+ * @param x_tile_stride  resulting stride between tiles along x
+ * @param y_stride       resulting stride between blocks of a tile along y
+ * @param y_tile_stride  resulting stride between tiles along y
+ */
+void
+lp_build_sample_tiled_strides(struct lp_build_context *bld,
+                              const struct util_format_description *format_desc,
+                              LLVMValueRef row_stride,
+                              LLVMValueRef *x_tile_stride,
+                              LLVMValueRef *y_stride,
+                              LLVMValueRef *y_tile_stride)
+{
+   const unsigned block_bytes = format_desc->block.bits / 8;
+
+   *x_tile_stride = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                           block_bytes * LP_TEXTURE_TILE_SIZE *
+                                           LP_TEXTURE_TILE_SIZE);
+   *y_stride = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                      block_bytes * LP_TEXTURE_TILE_SIZE);
+   *y_tile_stride = lp_build_shl_imm(bld, row_stride,
+                                     util_logbase2(LP_TEXTURE_TILE_SIZE));
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
@@ -2151,6 +2199,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       bool tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2161,21 +2210,27 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_j)
 {
    LLVMValueRef x_stride;
+   LLVMValueRef x_tile_stride = NULL, y_tile_stride = NULL;
    LLVMValueRef offset;
 
    x_stride = lp_build_const_vec(bld->gallivm, bld->type,
                                  format_desc->block.bits/8);
 
+   if (tiled && y && y_stride) {
+      lp_build_sample_tiled_strides(bld, format_desc, y_stride,
+                                    &x_tile_stride, &y_stride, &y_tile_stride);
+   }
+
    lp_build_sample_partial_offset(bld,
                                   format_desc->block.width,
-                                  x, x_stride,
+                                  x, x_stride, x_tile_stride,
                                   &offset, out_i);
 
    if (y && y_stride) {
       LLVMValueRef y_offset;
       lp_build_sample_partial_offset(bld,
                                      format_desc->block.height,
-                                     y, y_stride,
+                                     y, y_stride, y_tile_stride,
                                      &y_offset, out_j);
       offset = lp_build_add(bld, offset, y_offset);
    } else {
@@ -2187,7 +2242,7 @@ lp_build_sample_offset(struct lp_build_context *bld,
       LLVMValueRef k;
       lp_build_sample_partial_offset(bld,
                                      1, /* pixel blocks are always 2D */
-                                     z, z_stride,
+                                     z, z_stride, NULL,
                                      &z_offset, &k);
       offset = lp_build_add(bld, offset, z_offset);
    }
@@ -175,6 +175,18 @@ struct lp_img_params
 };
 
 
+/**
+ * Resource flag for textures whose blocks are stored in micro-tiles of
+ * LP_TEXTURE_TILE_SIZE x LP_TEXTURE_TILE_SIZE blocks instead of row by
+ * row.  Tiles are laid out row by row, each one taking up
+ * LP_TEXTURE_TILE_SIZE rows of the level, and the blocks within a tile
+ * are in row-major order, so the tiled layout needs the same row and
+ * image strides as the linear one.
+ */
+#define LP_RESOURCE_FLAG_TILED PIPE_RESOURCE_FLAG_DRV_PRIV
+#define LP_TEXTURE_TILE_SIZE 4
+
+
 /**
  * Texture static state.
  *
@@ -197,6 +209,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< see LP_RESOURCE_FLAG_TILED */
 };
 
 
@@ -720,13 +733,24 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                unsigned block_length,
                                LLVMValueRef coord,
                                LLVMValueRef stride,
+                               LLVMValueRef tile_stride,
                                LLVMValueRef *out_offset,
                                LLVMValueRef *out_i);
 
 
+void
+lp_build_sample_tiled_strides(struct lp_build_context *bld,
+                              const struct util_format_description *format_desc,
+                              LLVMValueRef row_stride,
+                              LLVMValueRef *x_tile_stride,
+                              LLVMValueRef *y_stride,
+                              LLVMValueRef *y_tile_stride);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       bool tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
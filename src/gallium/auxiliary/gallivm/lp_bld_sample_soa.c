@@ -140,6 +140,7 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
    /* convert x,y,z coords to linear offset from start of texture, in bytes */
    lp_build_sample_offset(&bld->int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, y_stride, z_stride,
                           &offset, &i, &j);
    if (mipoffsets) {
@@ -3187,6 +3188,7 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
 
    lp_build_sample_offset(int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, row_stride_vec, img_stride_vec,
                           &offset, &i, &j);
 
@@ -4874,7 +4876,7 @@ lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
 
    LLVMValueRef offset, i, j;
    lp_build_sample_offset(&int_coord_bld,
-                          format_desc,
+                          format_desc, false,
                           x, y, z, row_stride_vec, img_stride_vec,
                           &offset, &i, &j);
 
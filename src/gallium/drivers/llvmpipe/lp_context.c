@@ -38,6 +38,8 @@
 #include "util/u_memory.h"
 #include "util/list.h"
 #include "util/u_upload_mgr.h"
+#include "util/u_cpu_detect.h"
+#include "gallivm/lp_bld_debug.h"
 #include "lp_clear.h"
 #include "lp_context.h"
 #include "lp_flush.h"
@@ -61,7 +63,14 @@ llvmpipe_destroy(struct pipe_context *pipe)
    mtx_unlock(&lp_screen->ctx_mutex);
    lp_print_counters();
 
+   /* Pending jobs would be dropped, leaving their fences unsignalled. */
+   if (util_queue_is_initialized(&llvmpipe->compile_queue)) {
+      util_queue_finish(&llvmpipe->compile_queue);
+      util_queue_destroy(&llvmpipe->compile_queue);
+   }
+
    if (llvmpipe->csctx) {
+      llvmpipe_wait_compute(llvmpipe);
       lp_csctx_destroy(llvmpipe->csctx);
    }
    if (llvmpipe->task_ctx) {
@@ -269,6 +278,20 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    LLVMContextSetOpaquePointers(llvmpipe->context, false);
 #endif
 
+   if (debug_get_bool_option("LP_ASYNC_COMPILE", false) &&
+       !(gallivm_perf & GALLIVM_PERF_NO_OPT)) {
+      unsigned num_threads =
+         CLAMP(util_get_cpu_caps()->nr_cpus / 2, 1, 4);
+
+      llvmpipe->tier_up_threshold =
+         debug_get_num_option("LP_TIER_UP_THRESHOLD", 16);
+
+      /* Failing this just means compiling everything synchronously. */
+      util_queue_init(&llvmpipe->compile_queue, "lpcomp", 64, num_threads,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL);
+   }
+
    /*
     * Create drawing context and plug our rendering stage into it.
     */
@@ -282,6 +305,11 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
                                  lp_draw_disk_cache_find_shader,
                                  lp_draw_disk_cache_insert_shader);
 
+   /* In MiB.  The draw module applies it to its own variants. */
+   llvmpipe->variant_code_budget =
+      (size_t)debug_get_num_option("LP_SHADER_CODE_BUDGET", 0) << 20;
+   draw_set_shader_code_budget(llvmpipe->draw, llvmpipe->variant_code_budget);
+
    draw_set_constant_buffer_stride(llvmpipe->draw,
                                    lp_get_constant_buffer_stride(screen));
 
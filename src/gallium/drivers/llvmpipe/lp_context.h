@@ -165,6 +165,13 @@ struct llvmpipe_context {
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Background compiles of optimized shader variants */
+   struct util_queue compile_queue;
+   /** Uses of an unoptimized variant before it gets optimized */
+   unsigned tier_up_threshold;
+   /** Bound variant still running unoptimized code */
+   struct lp_fragment_shader_variant *fs_tier0_variant;
+
    bool permit_linear_rasterizer;
    bool single_vp;
 
@@ -176,10 +183,18 @@ struct llvmpipe_context {
    unsigned nr_cs_variants;
    unsigned nr_cs_instrs;
    struct lp_cs_context *csctx;
+   struct lp_compute_shader_variant *cs_tier0_variant;
 
    struct lp_cs_context *task_ctx;
    struct lp_cs_context *mesh_ctx;
 
+   /** JIT code held by all FS, CS and setup variants, in bytes */
+   size_t variant_code_size;
+   /** Limit for variant_code_size, 0 if unlimited */
+   size_t variant_code_budget;
+   /** Ticks once per variant lookup, for LRU ordering across lists */
+   uint64_t variant_clock;
+
    /** Conditional query object and mode */
    struct pipe_query *render_cond_query;
    enum pipe_render_cond_flag render_cond_mode;
@@ -29,53 +29,143 @@
  */
 
 #include "util/u_thread.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "lp_cs_tpool.h"
+#include "lp_numa.h"
+
+/* How often an idle thread polls for new work before going to sleep. */
+#define LP_CS_TPOOL_SPIN_COUNT 256
+
+#define BAND_RANGE(head, tail) (((uint64_t)(tail) << 32) | (uint32_t)(head))
+#define BAND_RANGE_HEAD(range) ((uint32_t)(range))
+#define BAND_RANGE_TAIL(range) ((uint32_t)((range) >> 32))
+
+struct lp_cs_tpool_worker_data {
+   struct lp_cs_tpool *pool;
+   unsigned index;
+};
+
+/**
+ * Claim a chunk of iterations from a band, from the head for the owner
+ * and from the tail when stealing.  Half of what is left is taken each
+ * time, so a band is drained with few atomic operations while the last
+ * iterations are still spread over all threads.
+ * Returns the number of iterations claimed, starting at *first.
+ */
+static unsigned
+band_pop(struct lp_cs_tpool_band *band, bool steal, unsigned *first)
+{
+   uint64_t range = p_atomic_read(&band->range);
+
+   while (1) {
+      uint32_t head = BAND_RANGE_HEAD(range);
+      uint32_t tail = BAND_RANGE_TAIL(range);
+
+      if (head >= tail)
+         return 0;
+
+      uint32_t count = MAX2(1, (tail - head) / 2);
+      uint64_t next = steal ? BAND_RANGE(head, tail - count) :
+                              BAND_RANGE(head + count, tail);
+      uint64_t prev = p_atomic_cmpxchg(&band->range, range, next);
+      if (prev == range) {
+         *first = steal ? tail - count : head;
+         return count;
+      }
+
+      range = prev;
+   }
+}
+
+/**
+ * Execute iterations of the task until none are left to claim, starting
+ * with the given band and then stealing from the others.
+ */
+static void
+lp_cs_tpool_run_task(struct lp_cs_tpool_task *task, unsigned band_index,
+                     struct lp_cs_local_mem *lmem)
+{
+   const unsigned num_bands = task->num_bands;
+
+   for (unsigned i = 0; i < num_bands; i++) {
+      struct lp_cs_tpool_band *band = &task->bands[(band_index + i) % num_bands];
+      unsigned first, count;
+
+      while ((count = band_pop(band, i != 0, &first))) {
+         for (unsigned j = 0; j < count; j++)
+            task->work(task->data, first + j, lmem);
+         p_atomic_add(&task->iter_finished, count);
+      }
+   }
+}
+
+static bool
+lp_cs_tpool_task_done(struct lp_cs_tpool_task *task)
+{
+   return p_atomic_read(&task->iter_finished) == task->iter_total &&
+          p_atomic_read(&task->num_workers) == 0;
+}
 
 static int
 lp_cs_tpool_worker(void *data)
 {
-   struct lp_cs_tpool *pool = data;
+   struct lp_cs_tpool_worker_data *worker = data;
+   struct lp_cs_tpool *pool = worker->pool;
+   const unsigned index = worker->index;
    struct lp_cs_local_mem lmem;
 
-   memset(&lmem, 0, sizeof(lmem));
+   /* Local memory is allocated by the worker, so pinning first keeps it
+    * on the worker's node.
+    */
    mtx_lock(&pool->m);
+   lp_numa_pin_current_thread(index, pool->num_threads);
+   FREE(worker);
+
+   memset(&lmem, 0, sizeof(lmem));
 
    while (!pool->shutdown) {
       struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
 
-      while (list_is_empty(&pool->workqueue) && !pool->shutdown)
-         cnd_wait(&pool->new_work, &pool->m);
-
-      if (pool->shutdown)
-         break;
+      if (list_is_empty(&pool->workqueue)) {
+         /* Dispatches often come in quick succession, so poll for a while
+          * before paying for a sleep and a wakeup.
+          */
+         uint32_t seen = pool->num_queued;
+
+         mtx_unlock(&pool->m);
+         for (unsigned i = 0; i < LP_CS_TPOOL_SPIN_COUNT; i++) {
+            if (p_atomic_read(&pool->num_queued) != seen)
+               break;
+            thrd_yield();
+         }
+         mtx_lock(&pool->m);
+
+         while (list_is_empty(&pool->workqueue) && !pool->shutdown) {
+            pool->num_sleeping++;
+            cnd_wait(&pool->new_work, &pool->m);
+            pool->num_sleeping--;
+         }
+
+         if (pool->shutdown)
+            break;
+      }
 
       task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
                               list);
-
-      unsigned this_iter = task->iter_start;
-
-      iter_per_thread = task->iter_per_thread;
-
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
-      }
-
-      task->iter_start += iter_per_thread;
-
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
-
+      task->num_workers++;
       mtx_unlock(&pool->m);
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
 
+      lp_cs_tpool_run_task(task, index, &lmem);
+
+      /* Everything has been claimed, though maybe not finished yet. */
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
+      if (task->queued) {
+         list_del(&task->list);
+         task->queued = false;
+      }
+      task->num_workers--;
+      if (lp_cs_tpool_task_done(task))
          cnd_broadcast(&task->finish);
    }
    mtx_unlock(&pool->m);
@@ -95,14 +185,34 @@ lp_cs_tpool_create(unsigned num_threads)
    cnd_init(&pool->new_work);
 
    list_inithead(&pool->workqueue);
-   assert (num_threads <= LP_MAX_THREADS);
+   num_threads = MIN2(num_threads, LP_MAX_THREADS);
+   pool->threads = CALLOC(MAX2(1, num_threads), sizeof(*pool->threads));
+   if (!pool->threads) {
+      cnd_destroy(&pool->new_work);
+      mtx_destroy(&pool->m);
+      FREE(pool);
+      return NULL;
+   }
+
+   /* Workers can't start pulling work before num_threads is final. */
+   mtx_lock(&pool->m);
    for (unsigned i = 0; i < num_threads; i++) {
-      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker, pool)) {
+      struct lp_cs_tpool_worker_data *worker =
+         CALLOC_STRUCT(lp_cs_tpool_worker_data);
+      if (!worker) {
+         num_threads = i;
+         break;
+      }
+      worker->pool = pool;
+      worker->index = i;
+      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker, worker)) {
+         FREE(worker);
          num_threads = i;  /* previous thread is max */
          break;
       }
    }
    pool->num_threads = num_threads;
+   mtx_unlock(&pool->m);
    return pool;
 }
 
@@ -123,6 +233,7 @@ lp_cs_tpool_destroy(struct lp_cs_tpool *pool)
 
    cnd_destroy(&pool->new_work);
    mtx_destroy(&pool->m);
+   FREE(pool->threads);
    FREE(pool);
 }
 
@@ -147,20 +258,45 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
       return NULL;
    }
 
+   /* No point in more bands than iterations, every band holds at least
+    * one.  The waiting thread helps out, so it gets a band too.
+    */
+   task->num_bands = MAX2(1, MIN2(pool->num_threads + 1, num_iters));
+   task->bands = align_calloc(task->num_bands * sizeof(*task->bands),
+                              CACHE_LINE_SIZE);
+   if (!task->bands) {
+      FREE(task);
+      return NULL;
+   }
+
    task->work = work;
    task->data = data;
    task->iter_total = num_iters;
 
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
+   for (unsigned i = 0; i < task->num_bands; i++) {
+      unsigned head = (uint64_t)num_iters * i / task->num_bands;
+      unsigned tail = (uint64_t)num_iters * (i + 1) / task->num_bands;
+      task->bands[i].range = BAND_RANGE(head, tail);
+   }
 
    cnd_init(&task->finish);
 
    mtx_lock(&pool->m);
 
    list_addtail(&task->list, &pool->workqueue);
-
-   cnd_broadcast(&pool->new_work);
+   task->queued = true;
+   p_atomic_inc(&pool->num_queued);
+
+   /* Spinning workers pick the task up by themselves, only wake up as
+    * many sleeping ones as there are bands left for them.
+    */
+   unsigned num_wake = MIN2(pool->num_sleeping, task->num_bands - 1);
+   if (num_wake == pool->num_sleeping)
+      cnd_broadcast(&pool->new_work);
+   else {
+      for (unsigned i = 0; i < num_wake; i++)
+         cnd_signal(&pool->new_work);
+   }
    mtx_unlock(&pool->m);
    return task;
 }
@@ -170,16 +306,38 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
                           struct lp_cs_tpool_task **task_handle)
 {
    struct lp_cs_tpool_task *task = *task_handle;
+   struct lp_cs_local_mem lmem;
 
    if (!pool || !task)
       return;
 
+   /* Rather than sleeping, take the last band and steal from the workers
+    * once it's done.
+    */
+   memset(&lmem, 0, sizeof(lmem));
+   lp_cs_tpool_run_task(task, task->num_bands - 1, &lmem);
+   FREE(lmem.local_mem_ptr);
+
+   /* Whatever is left is being executed right now, and likely finishes
+    * shortly.
+    */
+   for (unsigned i = 0; i < LP_CS_TPOOL_SPIN_COUNT; i++) {
+      if (lp_cs_tpool_task_done(task))
+         break;
+      thrd_yield();
+   }
+
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
+   if (task->queued) {
+      list_del(&task->list);
+      task->queued = false;
+   }
+   while (!lp_cs_tpool_task_done(task))
       cnd_wait(&task->finish, &pool->m);
    mtx_unlock(&pool->m);
 
    cnd_destroy(&task->finish);
+   align_free(task->bands);
    FREE(task);
    *task_handle = NULL;
 }
@@ -30,12 +30,21 @@
  * structs with just unique indexes in them.
  * It also supports a local memory support struct to be passed from
  * outside the thread exec function.
+ *
+ * The iterations of a task are split into one band per worker.  Workers
+ * claim chunks from their own band and, once that runs dry, steal chunks
+ * from the other bands, all without taking the pool lock.  Chunks start
+ * out large and shrink as a band empties, which keeps the number of
+ * atomic operations low while still balancing uneven iterations at the
+ * end.  The thread waiting for a task helps executing it, so small
+ * dispatches don't pay for waking up the workers.
  */
 #ifndef LP_CS_QUEUE
 #define LP_CS_QUEUE
 
 #include "util/compiler.h"
 
+#include "util/u_memory.h"
 #include "util/u_thread.h"
 #include "util/list.h"
 
@@ -45,9 +54,14 @@ struct lp_cs_tpool {
    mtx_t m;
    cnd_t new_work;
 
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
    unsigned num_threads;
+   /* Tasks which may still have unclaimed iterations. */
    struct list_head workqueue;
+   /* Workers blocked on new_work, so queuing only wakes as many as needed. */
+   unsigned num_sleeping;
+   /* Bumped for every queued task, polled by spinning workers. */
+   uint32_t num_queued;
    bool shutdown;
 };
 
@@ -58,16 +72,32 @@ struct lp_cs_local_mem {
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
 
+/**
+ * A range of iterations [head, tail) of a task, packed into a single
+ * word so it can be updated atomically.  The owning worker claims chunks
+ * at the head, other threads steal chunks from the tail.  Padded to a
+ * cache line to keep threads from false sharing.
+ */
+struct lp_cs_tpool_band {
+   alignas(CACHE_LINE_SIZE) uint64_t range;
+};
+
 struct lp_cs_tpool_task {
    lp_cs_tpool_task_func work;
    void *data;
    struct list_head list;
    cnd_t finish;
    unsigned iter_total;
-   unsigned iter_start;
    unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+
+   struct lp_cs_tpool_band *bands;
+   unsigned num_bands;
+
+   /* Workers currently executing the task and whether it is still on the
+    * workqueue, both protected by the pool mutex.
+    */
+   unsigned num_workers;
+   bool queued;
 };
 
 struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
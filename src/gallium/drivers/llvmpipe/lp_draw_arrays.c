@@ -76,6 +76,9 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
    if (lp->dirty)
       llvmpipe_update_derived(lp);
 
+   if (lp->fs_tier0_variant)
+      llvmpipe_update_fs_tier(lp);
+
    /*
     * Map vertex buffers
     */
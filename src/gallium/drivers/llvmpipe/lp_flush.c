@@ -41,6 +41,7 @@
 #include "lp_fence.h"
 #include "lp_screen.h"
 #include "lp_rast.h"
+#include "lp_state_cs.h"
 
 
 /**
@@ -54,6 +55,9 @@ llvmpipe_flush(struct pipe_context *pipe,
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
 
+   /* Fences only cover rasterization, so compute has to be done by now. */
+   llvmpipe_wait_compute(llvmpipe);
+
    draw_flush(llvmpipe->draw);
 
    /* ask the setup module to flush */
@@ -66,7 +66,11 @@
 
 #define LP_MAX_SAMPLES 4
 
-#define LP_MAX_THREADS 32
+/**
+ * Upper bound on rasterizer/compute threads.  This is only a sanity
+ * limit; all per-thread state is sized by the actual thread count.
+ */
+#define LP_MAX_THREADS 1024
 
 
 /**
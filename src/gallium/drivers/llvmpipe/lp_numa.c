@@ -0,0 +1,155 @@
+/*
+ * Copyright 2026 agent
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/detect_os.h"
+#include "util/u_call_once.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_thread.h"
+#include "lp_numa.h"
+
+
+#define LP_MAX_NUMA_NODES 64
+
+static unsigned lp_numa_nodes;
+static util_affinity_mask lp_numa_masks[LP_MAX_NUMA_NODES];
+static util_once_flag lp_numa_once_flag = UTIL_ONCE_FLAG_INIT;
+
+
+#if DETECT_OS_LINUX
+/**
+ * Parse a sysfs cpulist ("0-15,32-47") into an affinity mask.
+ */
+static bool
+parse_cpulist(const char *str, util_affinity_mask mask)
+{
+   bool found = false;
+
+   while (*str) {
+      char *end;
+      unsigned long first = strtoul(str, &end, 10);
+      unsigned long last = first;
+
+      if (end == str)
+         break;
+      if (*end == '-') {
+         str = end + 1;
+         last = strtoul(str, &end, 10);
+         if (end == str)
+            break;
+      }
+
+      for (unsigned long cpu = first; cpu <= last && cpu < UTIL_MAX_CPUS; cpu++) {
+         mask[cpu / 32] |= 1u << (cpu % 32);
+         found = true;
+      }
+
+      str = end;
+      while (*str == ',' || *str == '\n' || *str == ' ')
+         str++;
+   }
+
+   return found;
+}
+
+
+static void
+detect_sysfs_nodes(void)
+{
+   for (unsigned node = 0; node < LP_MAX_NUMA_NODES; node++) {
+      char path[64], buf[1024];
+
+      snprintf(path, sizeof(path),
+               "/sys/devices/system/node/node%u/cpulist", node);
+
+      FILE *f = fopen(path, "r");
+      if (!f)
+         continue;
+
+      bool ok = fgets(buf, sizeof(buf), f) != NULL;
+      fclose(f);
+
+      /* memory-only nodes have an empty cpulist */
+      if (ok && parse_cpulist(buf, lp_numa_masks[lp_numa_nodes]))
+         lp_numa_nodes++;
+      else
+         memset(lp_numa_masks[lp_numa_nodes], 0, sizeof(util_affinity_mask));
+   }
+}
+#endif
+
+
+static void
+lp_numa_detect(void)
+{
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+#if DETECT_OS_LINUX
+   detect_sysfs_nodes();
+#endif
+
+   /* Without real NUMA information fall back to the L3 cache domains,
+    * which on multi-CCX/multi-socket parts are the next best thing.
+    */
+   if (lp_numa_nodes < 2 && caps->num_L3_caches > 1) {
+      lp_numa_nodes = MIN2(caps->num_L3_caches, LP_MAX_NUMA_NODES);
+      for (unsigned i = 0; i < lp_numa_nodes; i++)
+         memcpy(lp_numa_masks[i], caps->L3_affinity_mask[i],
+                sizeof(util_affinity_mask));
+   }
+
+   /* Pinning is pointless on a single node machine. */
+   if (lp_numa_nodes < 2 || !debug_get_bool_option("LP_NUMA_PIN", true))
+      lp_numa_nodes = 0;
+}
+
+
+/**
+ * Number of nodes worker threads are distributed over, or zero if
+ * threads are left unpinned.
+ */
+unsigned
+lp_numa_num_nodes(void)
+{
+   util_call_once(&lp_numa_once_flag, lp_numa_detect);
+   return lp_numa_nodes;
+}
+
+
+/**
+ * Node for worker \p thread_index out of \p num_threads.  Threads are
+ * assigned in contiguous blocks so every node gets an equal share.
+ */
+unsigned
+lp_numa_thread_node(unsigned thread_index, unsigned num_threads)
+{
+   unsigned num_nodes = lp_numa_num_nodes();
+
+   if (!num_nodes || !num_threads)
+      return 0;
+
+   return (uint64_t)thread_index * num_nodes / num_threads;
+}
+
+
+/**
+ * Pin the calling worker thread to the CPUs of its node.
+ * Must be called from the worker itself, before it allocates or touches
+ * any per-thread memory, so first-touch places that memory on the node.
+ */
+bool
+lp_numa_pin_current_thread(unsigned thread_index, unsigned num_threads)
+{
+   if (!lp_numa_num_nodes())
+      return false;
+
+   unsigned node = lp_numa_thread_node(thread_index, num_threads);
+   return util_set_current_thread_affinity(lp_numa_masks[node], NULL,
+                                           util_get_cpu_caps()->num_cpu_mask_bits);
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright 2026 agent
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * NUMA/cache topology helpers for placing llvmpipe worker threads.
+ *
+ * Rasterizer and compute worker threads are spread evenly over the
+ * memory nodes of the machine (or, where the OS doesn't expose any,
+ * over the L3 cache domains util_cpu_detect found) and pinned there,
+ * so that the per-thread state they allocate and touch stays local.
+ */
+
+#ifndef LP_NUMA_H
+#define LP_NUMA_H
+
+#include <stdbool.h>
+
+
+unsigned
+lp_numa_num_nodes(void);
+
+unsigned
+lp_numa_thread_node(unsigned thread_index, unsigned num_threads);
+
+bool
+lp_numa_pin_current_thread(unsigned thread_index, unsigned num_threads);
+
+
+#endif /* LP_NUMA_H */
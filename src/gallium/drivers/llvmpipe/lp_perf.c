@@ -113,14 +113,29 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_rect_full_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_rect_fully_covered_4, p1, total_4);
       debug_printf("llvmpipe:   nr_rect_part_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_rect_partially_covered_4, p2, total_4);
 
+      debug_printf("llvmpipe: nr_hiz_culled_64x64:          %9u\n", lp_count.nr_hiz_culled_64);
+      debug_printf("llvmpipe: nr_hiz_culled_16x16:          %9u\n", lp_count.nr_hiz_culled_16);
+
 
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
+      debug_printf("llvmpipe: nr_streamed_scenes:           %9u\n", lp_count.nr_streamed_scenes);
+
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
+      debug_printf("llvmpipe: nr_fs_stalls_avoided:         %u\n", lp_count.nr_fs_stalls_avoided);
+      debug_printf("llvmpipe: nr_async_fs_compiles:         %u\n", lp_count.nr_async_fs_compiles);
+      debug_printf("llvmpipe: nr_cs_stalls_avoided:         %u\n", lp_count.nr_cs_stalls_avoided);
+      debug_printf("llvmpipe: nr_async_cs_compiles:         %u\n", lp_count.nr_async_cs_compiles);
+      debug_printf("llvmpipe: total async compile time:     %.2f sec\n", lp_count.async_compile_time / 1000000.0);
+
+      debug_printf("llvmpipe: nr_variant_cache_hits:        %u\n", lp_count.nr_variant_cache_hits);
+      debug_printf("llvmpipe: nr_variant_cache_misses:      %u\n", lp_count.nr_variant_cache_misses);
+      debug_printf("llvmpipe: nr_variant_evictions:         %u\n", lp_count.nr_variant_evictions);
+
    }
 }
@@ -62,12 +62,24 @@ struct lp_counters
    unsigned nr_rect_fully_covered_4;
    unsigned nr_rect_partially_covered_4;
    unsigned nr_non_empty_4;
+   unsigned nr_hiz_culled_64;
+   unsigned nr_hiz_culled_16;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
+   unsigned nr_async_fs_compiles;
+   unsigned nr_fs_stalls_avoided;
+   unsigned nr_async_cs_compiles;
+   unsigned nr_cs_stalls_avoided;
+   int64_t async_compile_time;  /**< total, in microseconds */
+   unsigned nr_variant_cache_hits;
+   unsigned nr_variant_cache_misses;
+   unsigned nr_variant_evictions;
 
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   unsigned nr_streamed_scenes;
 };
 
 
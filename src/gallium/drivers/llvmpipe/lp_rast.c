@@ -40,6 +40,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
+#include "lp_numa.h"
 #include "lp_perf.h"
 #include "lp_query.h"
 #include "lp_rast.h"
@@ -119,16 +120,174 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
          task->color_tiles[i] = scene->cbufs[i].map +
                                 scene->cbufs[i].stride * task->y +
                                 scene->cbufs[i].format_bytes * task->x;
+         task->color_strides[i] = scene->cbufs[i].stride;
       }
    }
    if (scene->fb.zsbuf) {
       task->depth_tile = scene->zsbuf.map +
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
+      task->depth_stride = scene->zsbuf.stride;
+   }
+
+   /* The depth buffer may have changed since the last scene, so start out
+    * knowing nothing about it.
+    */
+   task->hiz_enabled = scene->fb.zsbuf &&
+                       scene->zsbuf.nr_samples == 1 &&
+                       util_format_has_depth(
+                          util_format_description(scene->fb.zsbuf->format)) &&
+                       !(LP_PERF & PERF_NO_HIZ);
+   if (task->hiz_enabled) {
+      const struct util_format_description *desc =
+         util_format_description(scene->fb.zsbuf->format);
+      const struct util_format_channel_description *chan =
+         &desc->channel[desc->swizzle[0]];
+
+      if (chan->type == UTIL_FORMAT_TYPE_UNSIGNED && chan->normalized)
+         task->hiz_eps = 1.0f / (float)((1ull << chan->size) - 1);
+      else
+         task->hiz_eps = 0.0f;
+
+      lp_rast_hiz_set_all(task, INFINITY);
+   }
+}
+
+
+/**
+ * Find the attachments a bin clears in full before anything else is done
+ * to them, so there's no point in loading them.
+ */
+static void
+lp_rast_bin_leading_clears(const struct lp_scene *scene,
+                           const struct cmd_bin *bin,
+                           unsigned *cbufs, bool *zs)
+{
+   const unsigned zs_bits = scene->zsbuf.format_bytes * 8;
+   const uint64_t zs_mask = zs_bits >= 64 ? ~0ull : (1ull << zs_bits) - 1;
+
+   *cbufs = 0;
+   *zs = false;
+
+   for (const struct cmd_block *block = bin->head; block; block = block->next) {
+      for (unsigned k = 0; k < block->count; k++) {
+         const union lp_rast_cmd_arg arg = block->arg[k];
+
+         if (block->cmd[k] == LP_RAST_OP_CLEAR_COLOR) {
+            *cbufs |= 1 << arg.clear_rb->cbuf;
+         } else if (block->cmd[k] == LP_RAST_OP_CLEAR_ZSTENCIL) {
+            if ((arg.clear_zstencil.mask & zs_mask) == zs_mask)
+               *zs = true;
+         } else {
+            return;
+         }
+      }
    }
 }
 
 
+/**
+ * Tile buffer mode (LP_TILE_BUFFERS).
+ *
+ * Instead of shading straight into the framebuffer, copy the tile's color
+ * and depth into a per-thread scratch buffer, which stays in cache while
+ * the bin is processed, and copy it back once done.  Attachments the bin
+ * starts out by clearing aren't loaded, and attachments invalidated at
+ * the end of the scene aren't stored.
+ */
+static void
+lp_rast_tile_load(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+
+   if (!scene->tile_buffers)
+      return;
+
+   size_t size = 0;
+   for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i])
+         size += TILE_SIZE * TILE_SIZE * scene->cbufs[i].format_bytes;
+   }
+   if (scene->fb.zsbuf)
+      size += TILE_SIZE * TILE_SIZE * scene->zsbuf.format_bytes;
+
+   if (size > task->tile_buffer_size) {
+      align_free(task->tile_buffer);
+      task->tile_buffer = align_malloc(size, 64);
+      if (!task->tile_buffer) {
+         task->tile_buffer_size = 0;
+         return;
+      }
+      task->tile_buffer_size = size;
+   }
+
+   unsigned cleared_cbufs;
+   bool cleared_zs;
+   lp_rast_bin_leading_clears(scene, task->bin, &cleared_cbufs, &cleared_zs);
+
+   uint8_t *buf = task->tile_buffer;
+
+   for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (!scene->fb.cbufs[i])
+         continue;
+
+      const unsigned stride = TILE_SIZE * scene->cbufs[i].format_bytes;
+      if (!(cleared_cbufs & (1 << i))) {
+         util_copy_rect(buf, scene->fb.cbufs[i]->format, stride,
+                        0, 0, task->width, task->height,
+                        task->color_tiles[i], task->color_strides[i], 0, 0);
+         LP_COUNT(nr_color_tile_load);
+      }
+      task->color_tiles[i] = buf;
+      task->color_strides[i] = stride;
+      buf += TILE_SIZE * stride;
+   }
+
+   if (scene->fb.zsbuf) {
+      const unsigned stride = TILE_SIZE * scene->zsbuf.format_bytes;
+      if (!cleared_zs) {
+         util_copy_rect(buf, scene->fb.zsbuf->format, stride,
+                        0, 0, task->width, task->height,
+                        task->depth_tile, task->depth_stride, 0, 0);
+      }
+      task->depth_tile = buf;
+      task->depth_stride = stride;
+   }
+
+   task->tile_buffered = true;
+}
+
+
+static void
+lp_rast_tile_store(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+
+   if (!task->tile_buffered)
+      return;
+
+   for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (!scene->fb.cbufs[i] || (scene->discard_cbufs & (1 << i)))
+         continue;
+
+      util_copy_rect(scene->cbufs[i].map, scene->fb.cbufs[i]->format,
+                     scene->cbufs[i].stride,
+                     task->x, task->y, task->width, task->height,
+                     task->color_tiles[i], task->color_strides[i], 0, 0);
+      LP_COUNT(nr_color_tile_store);
+   }
+
+   if (scene->fb.zsbuf && !scene->discard_zs) {
+      util_copy_rect(scene->zsbuf.map, scene->fb.zsbuf->format,
+                     scene->zsbuf.stride,
+                     task->x, task->y, task->width, task->height,
+                     task->depth_tile, task->depth_stride, 0, 0);
+   }
+
+   task->tile_buffered = false;
+}
+
+
 /**
  * Clear the rasterizer's current color tile.
  * This is a bin command called during bin processing.
@@ -156,6 +315,19 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
           "%s clear value (target format %d) raw 0x%x,0x%x,0x%x,0x%x\n",
           __func__, format, uc.ui[0], uc.ui[1], uc.ui[2], uc.ui[3]);
 
+   if (task->tile_buffered) {
+      util_fill_rect(task->color_tiles[cbuf],
+                     format,
+                     task->color_strides[cbuf],
+                     0,
+                     0,
+                     task->width,
+                     task->height,
+                     &uc);
+      LP_COUNT(nr_color_tile_clear);
+      return;
+   }
+
    for (unsigned s = 0; s < scene->cbufs[cbuf].nr_samples; s++) {
       void *map = (char *) scene->cbufs[cbuf].map
          + scene->cbufs[cbuf].sample_stride * s;
@@ -193,7 +365,7 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
    uint32_t clear_mask = (uint32_t) clear_mask64;
    const unsigned height = task->height;
    const unsigned width = task->width;
-   const unsigned dst_stride = scene->zsbuf.stride;
+   const unsigned dst_stride = task->depth_stride;
 
    LP_DBG(DEBUG_RAST, "%s: value=0x%08x, mask=0x%08x\n",
            __func__, clear_value, clear_mask);
@@ -285,6 +457,19 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
             dst_layer += scene->zsbuf.layer_stride;
          }
       }
+
+      if (task->hiz_enabled) {
+         const enum pipe_format format = scene->fb.zsbuf->format;
+         const uint64_t zmask = util_pack64_mask_z(format, ~0);
+
+         if ((clear_mask64 & zmask) == zmask) {
+            float depth;
+            util_format_unpack_z_float(format, &depth, task->depth_tile, 1);
+            lp_rast_hiz_set_all(task, depth == depth ? depth : INFINITY);
+         } else if (clear_mask64 & zmask) {
+            lp_rast_hiz_set_all(task, INFINITY);
+         }
+      }
    }
 }
 
@@ -317,16 +502,35 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
    const struct lp_fragment_shader_variant *variant = state->variant;
 
+   if (lp_rast_hiz_cull(task, inputs, tile_x, tile_y, TILE_SIZE)) {
+      LP_COUNT(nr_hiz_culled_64);
+      return;
+   }
+
+   /* 16x16 blocks hidden behind the depth buffer */
+   unsigned hiz_culled = 0;
+   for (unsigned y = 0; y < task->height; y += 16) {
+      for (unsigned x = 0; x < task->width; x += 16) {
+         if (lp_rast_hiz_cull(task, inputs, tile_x + x, tile_y + y, 16)) {
+            hiz_culled |= 1 << ((y / 16) * LP_HIZ_BLOCKS + x / 16);
+            LP_COUNT(nr_hiz_culled_16);
+         }
+      }
+   }
+
    /* render the whole 64x64 tile in 4x4 chunks */
    for (unsigned y = 0; y < task->height; y += 4){
       for (unsigned x = 0; x < task->width; x += 4) {
+         if (hiz_culled & (1 << ((y / 16) * LP_HIZ_BLOCKS + x / 16)))
+            continue;
+
          /* color buffer */
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
          unsigned stride[PIPE_MAX_COLOR_BUFS];
          unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
          for (unsigned i = 0; i < scene->fb.nr_cbufs; i++){
             if (scene->fb.cbufs[i]) {
-               stride[i] = scene->cbufs[i].stride;
+               stride[i] = task->color_strides[i];
                sample_stride[i] = scene->cbufs[i].sample_stride;
                color[i] = lp_rast_get_color_block_pointer(task, i, tile_x + x,
                                           tile_y + y,
@@ -346,7 +550,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
             depth = lp_rast_get_depth_block_pointer(task, tile_x + x,
                                            tile_y + y,
                                            inputs->layer + inputs->view_index);
-            depth_stride = scene->zsbuf.stride;
+            depth_stride = task->depth_stride;
             depth_sample_stride = scene->zsbuf.sample_stride;
          }
 
@@ -378,6 +582,10 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          END_JIT_CALL();
       }
    }
+
+   for (unsigned y = 0; y < task->height; y += 16)
+      for (unsigned x = 0; x < task->width; x += 16)
+         lp_rast_hiz_update(task, inputs, tile_x + x, tile_y + y, 16);
 }
 
 
@@ -434,7 +642,7 @@ lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
    unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = task->color_strides[i];
          sample_stride[i] = scene->cbufs[i].sample_stride;
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer + inputs->view_index);
@@ -450,7 +658,7 @@ lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
    unsigned depth_stride = 0;
    unsigned depth_sample_stride = 0;
    if (scene->zsbuf.map) {
-      depth_stride = scene->zsbuf.stride;
+      depth_stride = task->depth_stride;
       depth_sample_stride = scene->zsbuf.sample_stride;
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer + inputs->view_index);
    }
@@ -555,7 +763,9 @@ lp_rast_blit_tile_to_dest(struct lp_rasterizer_task *task,
       return;
    }
 
-   if (src_x >= 0 &&
+   /* With a tile buffer the tile would be stored over the copy. */
+   if (!task->tile_buffered &&
+       src_x >= 0 &&
        src_y >= 0 &&
        src_x + task->width <= texture->width &&
        src_y + task->height <= texture->height) {
@@ -685,6 +895,9 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
    task->state = arg.set_state;
+
+   if (task->hiz_enabled && task->state->variant->hiz_clobber)
+      lp_rast_hiz_set_all(task, INFINITY);
 }
 
 
@@ -1000,7 +1213,9 @@ rasterize_bin(struct lp_rasterizer_task *task,
             (info.type & LP_RAST_FLAGS_RECT)) {
       lp_linear_rasterize_bin(task, bin);
    } else {
+      lp_rast_tile_load(task);
       tri_rasterize_bin(task, bin, x, y);
+      lp_rast_tile_store(task);
    }
 
    lp_rast_tile_end(task);
@@ -1062,7 +1277,7 @@ rasterize_scene(struct lp_rasterizer_task *task,
       int i, j;
 
       assert(scene);
-      while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+      while ((bin = lp_scene_bin_iter_next(scene, task->thread_index, &i, &j))) {
          if (!is_empty_bin(bin))
             rasterize_bin(task, bin, i, j);
       }
@@ -1149,6 +1364,17 @@ lp_rast_finish(struct lp_rasterizer *rast)
 }
 
 
+/**
+ * Has all queued work been rasterized?
+ * Must be called with the screen's rast_mutex held.
+ */
+bool
+lp_rast_is_idle(struct lp_rasterizer *rast)
+{
+   return !rast->last_fence || lp_fence_signalled(rast->last_fence);
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -1167,6 +1393,12 @@ thread_function(void *init_data)
    snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    u_thread_setname(thread_name);
 
+   /* Pin to our node before touching the per-thread texture cache, so
+    * its pages get allocated on the node we rasterize from.
+    */
+   if (lp_numa_pin_current_thread(task->thread_index, task->num_threads))
+      memset(task->thread_data.cache, 0, sizeof(*task->thread_data.cache));
+
    /* Make sure that denorms are treated like zeros. This is
     * the behavior required by D3D10. OpenGL doesn't care.
     */
@@ -1232,7 +1464,9 @@ static void
 create_rast_threads(struct lp_rasterizer *rast)
 {
    /* NOTE: if num_threads is zero, we won't use any threads */
-   for (unsigned i = 0; i < rast->num_threads; i++) {
+   const unsigned num_threads = rast->num_threads;
+   for (unsigned i = 0; i < num_threads; i++) {
+      rast->tasks[i].num_threads = num_threads;
       util_semaphore_init(&rast->tasks[i].work_ready, 0);
       util_semaphore_init(&rast->tasks[i].work_done, 0);
       if (thrd_success != u_thread_create(rast->threads + i, thread_function,
@@ -1257,6 +1491,14 @@ lp_rast_create(unsigned num_threads)
       goto no_rast;
    }
 
+   num_threads = MIN2(num_threads, LP_MAX_THREADS);
+
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof(*rast->tasks));
+   rast->threads = CALLOC(MAX2(1, num_threads), sizeof(*rast->threads));
+   if (!rast->tasks || !rast->threads) {
+      goto no_full_scenes;
+   }
+
    rast->full_scenes = lp_scene_queue_create();
    if (!rast->full_scenes) {
       goto no_full_scenes;
@@ -1289,7 +1531,7 @@ lp_rast_create(unsigned num_threads)
    return rast;
 
 no_thread_data_cache:
-   for (unsigned i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (unsigned i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
@@ -1297,6 +1539,8 @@ no_thread_data_cache:
 
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 no_rast:
    return NULL;
@@ -1342,6 +1586,7 @@ lp_rast_destroy(struct lp_rasterizer *rast)
    }
    for (unsigned i = 0; i < MAX2(1, rast->num_threads); i++) {
       align_free(rast->tasks[i].thread_data.cache);
+      align_free(rast->tasks[i].tile_buffer);
    }
 
    lp_fence_reference(&rast->last_fence, NULL);
@@ -1353,6 +1598,8 @@ lp_rast_destroy(struct lp_rasterizer *rast)
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
 
@@ -29,6 +29,7 @@
 #define LP_RAST_PRIV_H
 
 #include "util/format/u_format.h"
+#include "util/u_math.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
@@ -76,6 +77,10 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+/** Number of 16x16 hierarchical Z blocks per tile row/column */
+#define LP_HIZ_BLOCKS (TILE_SIZE / 16)
+
+
 /**
  * Per-thread rasterization state
  */
@@ -90,6 +95,17 @@ struct lp_rasterizer_task
 
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
+   /** Row strides of color_tiles[] and depth_tile */
+   unsigned color_strides[PIPE_MAX_COLOR_BUFS];
+   unsigned depth_stride;
+
+   /**
+    * Whether color_tiles[] and depth_tile currently point into
+    * tile_buffer rather than the framebuffer, see lp_rast_tile_load().
+    */
+   bool tile_buffered;
+   uint8_t *tile_buffer;
+   size_t tile_buffer_size;
 
    /** "back" pointer */
    struct lp_rasterizer *rast;
@@ -97,9 +113,23 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** Number of threads when this one was spawned, used for NUMA pinning.
+    * rast->num_threads can still shrink while threads are being created.
+    */
+   unsigned num_threads;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
+   /**
+    * Hierarchical Z for layer 0 of the current tile: an upper bound of the
+    * depth buffer values in each 16x16 block, INFINITY where unknown.
+    */
+   bool hiz_enabled;
+   float hiz_eps;        /**< depth buffer quantization step */
+   float hiz_tile_zmax;  /**< max of hiz_zmax[][] */
+   float hiz_zmax[LP_HIZ_BLOCKS][LP_HIZ_BLOCKS];
+
    util_semaphore work_ready;
    util_semaphore work_done;
 };
@@ -121,11 +151,11 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** A task object for each rasterization thread (at least one) */
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
@@ -172,7 +202,7 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
    unsigned py = y % TILE_SIZE;
 
    unsigned pixel_offset = px * task->scene->cbufs[buf].format_bytes +
-                           py * task->scene->cbufs[buf].stride;
+                           py * task->color_strides[buf];
    uint8_t *color = task->color_tiles[buf] + pixel_offset;
 
    if (layer) {
@@ -203,7 +233,7 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
    unsigned py = y % TILE_SIZE;
 
    unsigned pixel_offset = px * task->scene->zsbuf.format_bytes +
-                           py * task->scene->zsbuf.stride;
+                           py * task->depth_stride;
    uint8_t *depth = task->depth_tile + pixel_offset;
 
    if (layer) {
@@ -238,7 +268,7 @@ lp_rast_shade_quads_all(struct lp_rasterizer_task *task,
    /* color buffer */
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = task->color_strides[i];
          sample_stride[i] = scene->cbufs[i].sample_stride;
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer + inputs->view_index);
@@ -252,7 +282,7 @@ lp_rast_shade_quads_all(struct lp_rasterizer_task *task,
    if (scene->zsbuf.map) {
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer + inputs->view_index);
       depth_sample_stride = scene->zsbuf.sample_stride;
-      depth_stride = scene->zsbuf.stride;
+      depth_stride = task->depth_stride;
    }
 
    uint64_t mask = 0;
@@ -289,6 +319,134 @@ lp_rast_shade_quads_all(struct lp_rasterizer_task *task,
    }
 }
 
+/*
+ * Hierarchical Z.
+ *
+ * While rasterizing a tile we keep, for each of its 16x16 blocks, an upper
+ * bound of the values in the depth buffer (see lp_rasterizer_task).  With
+ * a LESS/LEQUAL/EQUAL depth test a primitive whose depth plane lies
+ * entirely beyond that bound can't pass for any pixel of the block, so the
+ * block is skipped before the fragment shader runs.  The bound is set by
+ * depth clears and lowered as suitable variants fully cover blocks.
+ */
+
+static inline void
+lp_rast_hiz_set_all(struct lp_rasterizer_task *task, float zmax)
+{
+   for (unsigned by = 0; by < LP_HIZ_BLOCKS; by++)
+      for (unsigned bx = 0; bx < LP_HIZ_BLOCKS; bx++)
+         task->hiz_zmax[by][bx] = zmax;
+   task->hiz_tile_zmax = zmax;
+}
+
+
+/**
+ * Bounds of a primitive's depth plane over the size x size area at x, y
+ * (window coords).  The area is widened by a pixel on each side to cover
+ * pixel center and sample offsets, and the bounds by the rounding error of
+ * the fragment shader's own interpolation.
+ */
+static inline void
+lp_rast_hiz_plane_bounds(const struct lp_rast_shader_inputs *inputs,
+                         int x, int y, unsigned size,
+                         float *zmin, float *zmax)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float zx0 = dzdx * (float)(x - 1);
+   const float zx1 = dzdx * (float)(x + (int)size + 1);
+   const float zy0 = dzdy * (float)(y - 1);
+   const float zy1 = dzdy * (float)(y + (int)size + 1);
+   const float err = (fabsf(a0) +
+                      MAX2(fabsf(zx0), fabsf(zx1)) +
+                      MAX2(fabsf(zy0), fabsf(zy1))) * (1.0f / (1 << 20));
+
+   *zmin = a0 + MIN2(zx0, zx1) + MIN2(zy0, zy1) - err;
+   *zmax = a0 + MAX2(zx0, zx1) + MAX2(zy0, zy1) + err;
+}
+
+
+/**
+ * Whether the primitive can be skipped over the size x size area at x, y
+ * (window coords, a 16x16 block or the whole tile) as it's behind
+ * everything already in the depth buffer there.
+ */
+static inline bool
+lp_rast_hiz_cull(const struct lp_rasterizer_task *task,
+                 const struct lp_rast_shader_inputs *inputs,
+                 int x, int y, unsigned size)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+
+   if (!task->hiz_enabled || !variant->hiz_cull ||
+       inputs->layer + inputs->view_index != 0)
+      return false;
+
+   float zmax;
+   if (size == TILE_SIZE) {
+      zmax = task->hiz_tile_zmax;
+   } else {
+      assert(size == 16);
+      zmax = task->hiz_zmax[(y % TILE_SIZE) / 16][(x % TILE_SIZE) / 16];
+   }
+   if (zmax == INFINITY)
+      return false;
+
+   float plane_min, plane_max;
+   lp_rast_hiz_plane_bounds(inputs, x, y, size, &plane_min, &plane_max);
+   if (variant->key.restrict_depth_values)
+      plane_min = MIN2(plane_min, 1.0f);
+
+   return plane_min > zmax + task->hiz_eps;
+}
+
+
+/**
+ * Lower the depth bound of the 16x16 blocks in the size x size area at
+ * x, y (window coords) after the primitive was shaded over all of it.
+ */
+static inline void
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned size)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+
+   if (!task->hiz_enabled || !variant->hiz_update ||
+       inputs->layer + inputs->view_index != 0)
+      return;
+
+   float plane_min, plane_max;
+   lp_rast_hiz_plane_bounds(inputs, x, y, size, &plane_min, &plane_max);
+   if (variant->key.restrict_depth_values)
+      plane_max = MAX2(plane_max, 0.0f);
+
+   const unsigned bx0 = (x % TILE_SIZE) / 16;
+   const unsigned by0 = (y % TILE_SIZE) / 16;
+   const unsigned nr_blocks = size / 16;
+   bool lowered = false;
+
+   for (unsigned by = by0; by < by0 + nr_blocks; by++) {
+      for (unsigned bx = bx0; bx < bx0 + nr_blocks; bx++) {
+         /* also false for NaN */
+         if (plane_max < task->hiz_zmax[by][bx]) {
+            task->hiz_zmax[by][bx] = plane_max;
+            lowered = true;
+         }
+      }
+   }
+
+   if (lowered) {
+      float tile_zmax = task->hiz_zmax[0][0];
+      for (unsigned by = 0; by < LP_HIZ_BLOCKS; by++)
+         for (unsigned bx = 0; bx < LP_HIZ_BLOCKS; bx++)
+            tile_zmax = MAX2(tile_zmax, task->hiz_zmax[by][bx]);
+      task->hiz_tile_zmax = tile_zmax;
+   }
+}
+
+
 void
 lp_rast_triangle_1(struct lp_rasterizer_task *, const union lp_rast_cmd_arg);
 
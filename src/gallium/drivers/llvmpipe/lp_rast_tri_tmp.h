@@ -210,6 +210,11 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       return;
    }
 
+   if (lp_rast_hiz_cull(task, &tri->inputs, x, y, TILE_SIZE)) {
+      LP_COUNT(nr_hiz_culled_64);
+      return;
+   }
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -323,6 +328,10 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       partial_mask &= ~(1 << i);
 
       LP_COUNT(nr_partially_covered_16);
+      if (lp_rast_hiz_cull(task, &tri->inputs, px, py, 16)) {
+         LP_COUNT(nr_hiz_culled_16);
+         continue;
+      }
       TAG(do_block_16)(task, tri, plane, px, py, cx);
    }
 
@@ -338,7 +347,12 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       inmask &= ~(1 << i);
 
       LP_COUNT(nr_fully_covered_16);
+      if (lp_rast_hiz_cull(task, &tri->inputs, px, py, 16)) {
+         LP_COUNT(nr_hiz_culled_16);
+         continue;
+      }
       block_full_16(task, tri, px, py);
+      lp_rast_hiz_update(task, &tri->inputs, px, py, 16);
    }
 }
 
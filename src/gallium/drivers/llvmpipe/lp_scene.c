@@ -26,6 +26,7 @@
  **************************************************************************/
 
 #include "util/u_framebuffer.h"
+#include "util/u_atomic.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/reallocarray.h"
@@ -75,6 +76,16 @@ lp_scene_create(struct lp_setup_context *setup)
 
    (void) mtx_init(&scene->mutex, mtx_plain);
 
+   scene->num_bin_queues = MAX2(1, setup->num_threads);
+   scene->bin_queues = align_calloc(scene->num_bin_queues *
+                                    sizeof(*scene->bin_queues),
+                                    CACHE_LINE_SIZE);
+   if (!scene->bin_queues) {
+      mtx_destroy(&scene->mutex);
+      slab_free_st(&setup->scene_slab, scene);
+      return NULL;
+   }
+
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -102,6 +113,7 @@ lp_scene_destroy(struct lp_scene *scene)
 {
    lp_scene_end_rasterization(scene);
    mtx_destroy(&scene->mutex);
+   align_free(scene->bin_queues);
    free(scene->tiles);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
@@ -547,60 +559,83 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-/** advance curr_x,y to the next bin */
-static bool
-next_bin(struct lp_scene *scene)
+#define BIN_RANGE(head, tail) (((uint64_t)(tail) << 32) | (uint32_t)(head))
+#define BIN_RANGE_HEAD(range) ((uint32_t)(range))
+#define BIN_RANGE_TAIL(range) ((uint32_t)((range) >> 32))
+
+
+/**
+ * Split the scene's bins into one contiguous band per queue.  Called once
+ * per scene before any thread starts rasterizing it.
+ */
+void
+lp_scene_bin_iter_begin(struct lp_scene *scene)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return false;
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+   const unsigned num_queues = scene->num_bin_queues;
+
+   for (unsigned i = 0; i < num_queues; i++) {
+      unsigned head = (uint64_t)num_bins * i / num_queues;
+      unsigned tail = (uint64_t)num_bins * (i + 1) / num_queues;
+      p_atomic_set(&scene->bin_queues[i].range, BIN_RANGE(head, tail));
    }
-   return true;
 }
 
 
-void
-lp_scene_bin_iter_begin(struct lp_scene *scene)
+/**
+ * Pop a bin from the head (own queue) or tail (stealing) of a queue.
+ * Returns the bin index, or -1 if the queue is empty.
+ */
+static int
+bin_queue_pop(struct lp_bin_queue *queue, bool steal)
 {
-   scene->curr_x = scene->curr_y = -1;
+   uint64_t range = p_atomic_read(&queue->range);
+
+   while (1) {
+      uint32_t head = BIN_RANGE_HEAD(range);
+      uint32_t tail = BIN_RANGE_TAIL(range);
+
+      if (head >= tail)
+         return -1;
+
+      uint64_t next = steal ? BIN_RANGE(head, tail - 1) : BIN_RANGE(head + 1, tail);
+      uint64_t prev = p_atomic_cmpxchg(&queue->range, range, next);
+      if (prev == range)
+         return steal ? tail - 1 : head;
+
+      range = prev;
+   }
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
- * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * Return pointer to next bin to be rendered by the given thread.
+ * Each thread first works through its own band of bins, front to back,
+ * and then steals bins from the back of the other threads' bands, so
+ * threads that got cheap tiles help out those stuck on expensive ones
+ * instead of idling until the end of the scene.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next(struct lp_scene *scene, unsigned thread_index,
+                       int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   const unsigned num_queues = scene->num_bin_queues;
+   int index = -1;
 
-   mtx_lock(&scene->mutex);
+   assert(thread_index < num_queues);
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   } else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   for (unsigned i = 0; i < num_queues && index < 0; i++) {
+      unsigned q = (thread_index + i) % num_queues;
+      index = bin_queue_pop(&scene->bin_queues[q], i != 0);
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   if (index < 0)
+      return NULL;
+
+   *x = index % scene->tiles_x;
+   *y = index / scene->tiles_x;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   return lp_scene_get_bin(scene, *x, *y);
 }
 
 
@@ -653,6 +688,12 @@ lp_scene_begin_binning(struct lp_scene *scene,
 
    scene->fb_max_layer = max_layer;
    scene->fb_max_samples = util_framebuffer_get_num_samples(fb);
+
+   /* Tile buffers hold a single layer and sample of each attachment. */
+   if (max_layer != 0 || scene->fb_max_samples > 1)
+      scene->tile_buffers = false;
+   scene->discard_cbufs = 0;
+   scene->discard_zs = false;
    if (scene->fb_max_samples == 4) {
       for (unsigned i = 0; i < 4; i++) {
          scene->fixed_sample_pos[i][0] = util_iround(lp_sample_pos_4x[i][0] * FIXED_ONE);
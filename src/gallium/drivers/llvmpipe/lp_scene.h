@@ -35,6 +35,7 @@
 #ifndef LP_SCENE_H
 #define LP_SCENE_H
 
+#include "util/u_memory.h"
 #include "util/u_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
@@ -130,6 +131,17 @@ struct lp_scene_surface {
 };
 
 
+/**
+ * A range of bin indices [head, tail) owned by one rasterizer thread,
+ * packed into a single word so it can be updated atomically.  The owner
+ * pops bins at the head, idle threads steal from the tail.  Padded to
+ * a cache line to keep threads from false sharing.
+ */
+struct lp_bin_queue {
+   alignas(CACHE_LINE_SIZE) uint64_t range;
+};
+
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -189,13 +201,21 @@ struct lp_scene {
    bool alloc_failed;
    bool permit_linear_rasterizer;
 
+   /** Shade into per-thread tile buffers, see lp_rast_tile_load() */
+   bool tile_buffers;
+   /** Attachments not to store back from the tile buffers */
+   unsigned discard_cbufs;
+   bool discard_zs;
+
    /**
     * Number of active tiles in each dimension.
     * This basically the framebuffer size divided by tile size
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
+   /** Per-thread bin queues for work stealing, see lp_scene_bin_iter_next */
+   struct lp_bin_queue *bin_queues;
+   unsigned num_bin_queues;
    mtx_t mutex;
 
    unsigned num_alloced_tiles;
@@ -399,7 +419,8 @@ void
 lp_scene_bin_iter_begin(struct lp_scene *scene);
 
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene, int *x, int *y);
+lp_scene_bin_iter_next(struct lp_scene *scene, unsigned thread_index,
+                       int *x, int *y);
 
 
 
@@ -64,6 +64,12 @@ struct llvmpipe_screen
 
    bool allow_cl;
 
+   /* Store sampled-only textures in micro-tiles, see LP_RESOURCE_FLAG_TILED. */
+   bool tiled_textures;
+
+   /* Rasterize into per-thread tile buffers, see lp_rast_tile_load(). */
+   bool tile_buffers;
+
    mtx_t late_mutex;
    bool late_init_done;
 
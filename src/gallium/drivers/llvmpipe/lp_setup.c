@@ -50,6 +50,7 @@
 #include "lp_debug.h"
 #include "lp_fence.h"
 #include "lp_query.h"
+#include "lp_perf.h"
 #include "lp_rast.h"
 #include "lp_setup_context.h"
 #include "lp_screen.h"
@@ -113,6 +114,8 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
 
    setup->scene = setup->scenes[i];
    setup->scene->permit_linear_rasterizer = setup->permit_linear_rasterizer;
+   setup->scene->tile_buffers =
+      llvmpipe_screen(setup->pipe->screen)->tile_buffers;
    lp_scene_begin_binning(setup->scene, &setup->fb);
 }
 
@@ -387,6 +390,56 @@ lp_setup_flush(struct lp_setup_context *setup,
 }
 
 
+/**
+ * The contents of the given attachments aren't needed beyond the draws
+ * binned so far.  Rasterize those now, without storing the attachments
+ * back from the tile buffers.
+ */
+void
+lp_setup_discard_attachments(struct lp_setup_context *setup,
+                             unsigned cbufs, bool zs)
+{
+   if (setup->state != SETUP_ACTIVE || !setup->scene->tile_buffers)
+      return;
+
+   setup->scene->discard_cbufs |= cbufs;
+   setup->scene->discard_zs |= zs;
+   lp_setup_flush(setup, __func__);
+}
+
+
+/**
+ * Streaming mode: rather than holding everything until the scene fills up
+ * or gets flushed, hand the work binned so far to the rasterizer as soon
+ * as there's a reasonable amount of it and the rasterizer has run out of
+ * work.  Binning of the following draws then overlaps with rasterization
+ * of the earlier ones, which cuts the latency of draw-heavy frames.
+ *
+ * Splitting a frame into several scenes is always legal (it's exactly
+ * what happens when a scene runs out of memory) and cheap, since
+ * llvmpipe renders straight into the framebuffer.
+ */
+void
+lp_setup_stream_scene(struct lp_setup_context *setup)
+{
+   if (!setup->stream_scenes ||
+       setup->state != SETUP_ACTIVE ||
+       setup->scene->scene_size < LP_SCENE_STREAM_SIZE)
+      return;
+
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+
+   mtx_lock(&screen->rast_mutex);
+   bool idle = lp_rast_is_idle(screen->rast);
+   mtx_unlock(&screen->rast_mutex);
+
+   if (idle) {
+      LP_COUNT(nr_streamed_scenes);
+      set_scene_state(setup, SETUP_FLUSHED, __func__);
+   }
+}
+
+
 void
 lp_setup_bind_framebuffer(struct lp_setup_context *setup,
                           const struct pipe_framebuffer_state *fb)
@@ -1284,6 +1337,8 @@ lp_setup_destroy(struct lp_setup_context *setup)
 
    util_unreference_framebuffer_state(&setup->fb);
 
+   align_free(setup->tri_prepass);
+
    for (unsigned i = 0; i < ARRAY_SIZE(setup->fs.current_tex); i++) {
       struct pipe_resource **res_ptr = &setup->fs.current_tex[i];
       if (*res_ptr)
@@ -1347,6 +1402,8 @@ lp_setup_create(struct pipe_context *pipe,
    setup->pipe = pipe;
 
    setup->num_threads = screen->num_threads;
+   setup->stream_scenes = setup->num_threads > 0 &&
+                          debug_get_bool_option("LP_STREAM_SCENES", false);
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
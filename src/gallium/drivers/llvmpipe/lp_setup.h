@@ -63,6 +63,10 @@ void
 lp_setup_flush(struct lp_setup_context *setup,
                const char *reason);
 
+void
+lp_setup_discard_attachments(struct lp_setup_context *setup,
+                             unsigned cbufs, bool zs);
+
 void
 lp_setup_bind_framebuffer(struct lp_setup_context *setup,
                           const struct pipe_framebuffer_state *fb);
@@ -53,12 +53,19 @@
 #define LP_SETUP_NEW_SSBOS       0x20
 
 struct lp_setup_variant;
+struct lp_setup_tri_prepass;
 
 
 /** Max number of scenes */
 #define INITIAL_SCENES 4
 #define MAX_SCENES 64
 
+/**
+ * In streaming mode (LP_STREAM_SCENES), a scene with at least this much
+ * binned data is handed to an idle rasterizer without waiting for a flush.
+ */
+#define LP_SCENE_STREAM_SIZE (1024 * 1024)
+
 
 
 /**
@@ -90,6 +97,10 @@ struct lp_setup_context
    struct draw_stage *vbuf;
    unsigned num_threads;
    unsigned scene_idx;
+   bool stream_scenes;
+
+   /** scratch space for lp_setup_triangles_parallel() */
+   struct lp_setup_tri_prepass *tri_prepass;
 
    struct slab_mempool scene_slab;
    int num_active_scenes;
@@ -220,6 +231,13 @@ lp_setup_add_scissor_planes(const struct u_rect *scissor,
 void
 lp_setup_choose_triangle(struct lp_setup_context *setup);
 
+bool
+lp_setup_triangles_parallel(struct lp_setup_context *setup,
+                            const void *vertex_buffer,
+                            unsigned stride,
+                            const uint16_t *indices,
+                            unsigned nr);
+
 void
 lp_setup_choose_line(struct lp_setup_context *setup);
 
@@ -242,6 +260,9 @@ lp_setup_destroy(struct lp_setup_context *setup);
 bool
 lp_setup_flush_and_restart(struct lp_setup_context *setup);
 
+void
+lp_setup_stream_scene(struct lp_setup_context *setup);
+
 bool
 lp_setup_whole_tile(struct lp_setup_context *setup,
                     const struct lp_rast_shader_inputs *inputs,
@@ -54,6 +54,8 @@ altivec.h inclusion in -std=c++98..11 causes bool to be redefined
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
 #include "lp_context.h"
+#include "lp_cs_tpool.h"
+#include "lp_screen.h"
 
 #include <inttypes.h>
 
@@ -266,6 +268,54 @@ check_opaque(const struct lp_setup_context *setup,
 }
 
 
+/**
+ * Viewport index of a triangle, taken from its provoking vertex.
+ */
+static inline unsigned
+triangle_viewport_index(const struct lp_setup_context *setup,
+                        const float (*v0)[4],
+                        const float (*v2)[4])
+{
+   const float (*pv)[4] = setup->flatshade_first ? v0 : v2;
+
+   if (setup->viewport_index_slot > 0) {
+      unsigned *udata = (unsigned*)pv[setup->viewport_index_slot];
+      return lp_clamp_viewport_idx(*udata);
+   }
+
+   return 0;
+}
+
+
+/**
+ * Bounding rectangle (in pixels) of a triangle.
+ */
+static inline void
+triangle_bbox(const struct lp_setup_context *setup,
+              const struct fixed_position *position,
+              struct u_rect *bbox)
+{
+   /* Yes this is necessary to accurately calculate bounding boxes
+    * with the two fill-conventions we support.  GL (normally) ends
+    * up needing a bottom-left fill convention, which requires
+    * slightly different rounding.
+    */
+   int adj = (setup->bottom_edge_rule != 0) ? 1 : 0;
+
+   /* Inclusive x0, exclusive x1 */
+   bbox->x0 =  MIN3(position->x[0], position->x[1],
+                    position->x[2]) >> FIXED_ORDER;
+   bbox->x1 = (MAX3(position->x[0], position->x[1],
+                    position->x[2]) - 1) >> FIXED_ORDER;
+
+   /* Inclusive / exclusive depending upon adj (bottom-left or top-right) */
+   bbox->y0 = (MIN3(position->y[0], position->y[1],
+                    position->y[2]) + adj) >> FIXED_ORDER;
+   bbox->y1 = (MAX3(position->y[0], position->y[1],
+                    position->y[2]) - 1 + adj) >> FIXED_ORDER;
+}
+
+
 /**
  * Do basic setup for triangle rasterization and determine which
  * framebuffer tiles are touched.  Put the triangle in the scene's
@@ -288,11 +338,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
       pv = v2;
    }
 
-   unsigned viewport_index = 0;
-   if (setup->viewport_index_slot > 0) {
-      unsigned *udata = (unsigned*)pv[setup->viewport_index_slot];
-      viewport_index = lp_clamp_viewport_idx(*udata);
-   }
+   unsigned viewport_index = triangle_viewport_index(setup, v0, v2);
 
    unsigned layer = 0;
    if (setup->layer_slot > 0) {
@@ -302,26 +348,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
 
    /* Bounding rectangle (in pixels) */
    struct u_rect bbox;
-   {
-      /* Yes this is necessary to accurately calculate bounding boxes
-       * with the two fill-conventions we support.  GL (normally) ends
-       * up needing a bottom-left fill convention, which requires
-       * slightly different rounding.
-       */
-      int adj = (setup->bottom_edge_rule != 0) ? 1 : 0;
-
-      /* Inclusive x0, exclusive x1 */
-      bbox.x0 =  MIN3(position->x[0], position->x[1],
-                      position->x[2]) >> FIXED_ORDER;
-      bbox.x1 = (MAX3(position->x[0], position->x[1],
-                      position->x[2]) - 1) >> FIXED_ORDER;
-
-      /* Inclusive / exclusive depending upon adj (bottom-left or top-right) */
-      bbox.y0 = (MIN3(position->y[0], position->y[1],
-                      position->y[2]) + adj) >> FIXED_ORDER;
-      bbox.y1 = (MAX3(position->y[0], position->y[1],
-                      position->y[2]) - 1 + adj) >> FIXED_ORDER;
-   }
+   triangle_bbox(setup, position, &bbox);
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("no intersection\n");
@@ -1034,7 +1061,7 @@ retry_triangle_ccw(struct lp_setup_context *setup,
  * to what is done in the jit setup prog.
  */
 static inline int8_t
-calc_fixed_position(struct lp_setup_context *setup,
+calc_fixed_position(const struct lp_setup_context *setup,
                     struct fixed_position* position,
                     const float (*v0)[4],
                     const float (*v1)[4],
@@ -1274,3 +1301,228 @@ lp_setup_choose_triangle(struct lp_setup_context *setup)
       break;
    }
 }
+
+
+/*
+ * Parallel triangle setup.
+ *
+ * For big triangle lists, the fixed point conversion, facing and bounding
+ * box culling of each triangle is done on the compute thread pool, one
+ * batch at a time, while the context thread bins the previous batch.
+ * Binning allocates from the scene and must happen in API order, so it
+ * stays on the context thread, but it no longer has to look at triangles
+ * that get culled.
+ */
+
+#define LP_SETUP_PARALLEL_MIN_TRIS 4096
+#define LP_SETUP_PREPASS_BATCH     16384
+#define LP_SETUP_PREPASS_CHUNK     1024
+
+struct lp_setup_tri_prepass {
+   alignas(16) struct fixed_position position[LP_SETUP_PREPASS_BATCH];
+   int8_t area_sign[LP_SETUP_PREPASS_BATCH];   /**< 0 if culled */
+};
+
+struct tri_prepass_job {
+   struct lp_setup_context *setup;
+   struct lp_setup_tri_prepass *out;
+   const char *vertex_buffer;
+   const uint16_t *indices;
+   unsigned stride;
+   unsigned first_tri;
+   unsigned num_tris;
+   bool keep_ccw, keep_cw;
+   /* Binning may restart the scene and recompute setup->draw_regions while
+    * the pool is still culling against them.
+    */
+   const struct u_rect *draw_regions;
+};
+
+
+static inline const float (*
+prepass_vert(const struct tri_prepass_job *job, unsigned tri, unsigned v))[4]
+{
+   unsigned index = tri * 3 + v;
+   if (job->indices)
+      index = job->indices[index];
+   return (const float (*)[4])(job->vertex_buffer + index * job->stride);
+}
+
+
+static void
+triangle_prepass(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   const struct tri_prepass_job *job = data;
+   const struct lp_setup_context *setup = job->setup;
+   const unsigned start = iter_idx * LP_SETUP_PREPASS_CHUNK;
+   const unsigned end = MIN2(start + LP_SETUP_PREPASS_CHUNK, job->num_tris);
+
+   for (unsigned t = start; t < end; t++) {
+      const unsigned tri = job->first_tri + t;
+      const float (*v0)[4] = prepass_vert(job, tri, 0);
+      const float (*v1)[4] = prepass_vert(job, tri, 1);
+      const float (*v2)[4] = prepass_vert(job, tri, 2);
+      struct fixed_position *position = &job->out->position[t];
+
+      int8_t area_sign = calc_fixed_position(setup, position, v0, v1, v2);
+
+      if ((area_sign > 0 && !job->keep_ccw) ||
+          (area_sign < 0 && !job->keep_cw)) {
+         area_sign = 0;
+      } else if (area_sign) {
+         struct u_rect bbox;
+         triangle_bbox(setup, position, &bbox);
+         if (!u_rect_test_intersection(
+                &job->draw_regions[triangle_viewport_index(setup, v0, v2)],
+                &bbox))
+            area_sign = 0;
+      }
+
+      job->out->area_sign[t] = area_sign;
+   }
+}
+
+
+static struct lp_cs_tpool_task *
+queue_triangle_prepass(struct llvmpipe_screen *screen,
+                       struct tri_prepass_job *job)
+{
+   const unsigned num_chunks =
+      DIV_ROUND_UP(job->num_tris, LP_SETUP_PREPASS_CHUNK);
+   mtx_lock(&screen->cs_mutex);
+   struct lp_cs_tpool_task *task =
+      lp_cs_tpool_queue_task(screen->cs_tpool, triangle_prepass, job,
+                             num_chunks);
+   mtx_unlock(&screen->cs_mutex);
+
+   /* Couldn't queue it, just do it here. */
+   if (!task) {
+      for (unsigned i = 0; i < num_chunks; i++)
+         triangle_prepass(job, i, NULL);
+   }
+
+   return task;
+}
+
+
+static void
+bin_triangle_prepass(struct lp_setup_context *setup,
+                     const struct tri_prepass_job *job)
+{
+   struct llvmpipe_context *lp_context = llvmpipe_context(setup->pipe);
+
+   for (unsigned t = 0; t < job->num_tris; t++) {
+      const unsigned tri = job->first_tri + t;
+      struct fixed_position *position = &job->out->position[t];
+      const int8_t area_sign = job->out->area_sign[t];
+
+      if (lp_context->active_statistics_queries) {
+         lp_context->pipeline_statistics.c_primitives++;
+      }
+
+      if (!area_sign)
+         continue;
+
+      const float (*v0)[4] = prepass_vert(job, tri, 0);
+      const float (*v1)[4] = prepass_vert(job, tri, 1);
+      const float (*v2)[4] = prepass_vert(job, tri, 2);
+
+      /* Same as triangle_both() with the culling already done. */
+      if (area_sign > 0) {
+         retry_triangle_ccw(setup, position, v0, v1, v2,
+                            setup->ccw_is_frontface);
+      } else if (setup->flatshade_first) {
+         rotate_fixed_position_12(position);
+         retry_triangle_ccw(setup, position, v0, v2, v1,
+                            !setup->ccw_is_frontface);
+      } else {
+         rotate_fixed_position_01(position);
+         retry_triangle_ccw(setup, position, v1, v0, v2,
+                            !setup->ccw_is_frontface);
+      }
+   }
+}
+
+
+/**
+ * Set up and bin a triangle list, using the compute thread pool for the
+ * per-triangle setup work.  \p indices may be NULL for non-indexed draws.
+ * \return false if the draw isn't worth splitting up, in which case the
+ *         caller must emit the triangles itself.
+ */
+bool
+lp_setup_triangles_parallel(struct lp_setup_context *setup,
+                            const void *vertex_buffer,
+                            unsigned stride,
+                            const uint16_t *indices,
+                            unsigned nr)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+   struct lp_cs_tpool *pool = screen->cs_tpool;
+   const unsigned num_tris = nr / 3;
+
+   /* Rect/linear detection only happens on the serial path. */
+   if (num_tris < LP_SETUP_PARALLEL_MIN_TRIS ||
+       !pool || pool->num_threads == 0 ||
+       setup->rasterizer_discard ||
+       setup->permit_linear_rasterizer ||
+       setup->cullmode == PIPE_FACE_FRONT_AND_BACK)
+      return false;
+
+   if (!setup->tri_prepass) {
+      setup->tri_prepass =
+         align_malloc(2 * sizeof(struct lp_setup_tri_prepass), 16);
+      if (!setup->tri_prepass)
+         return false;
+   }
+
+   /* Which facings survive culling, see lp_setup_choose_triangle() */
+   bool keep_ccw = true, keep_cw = true;
+   if (setup->cullmode == PIPE_FACE_BACK) {
+      keep_ccw = setup->ccw_is_frontface;
+      keep_cw = !setup->ccw_is_frontface;
+   } else if (setup->cullmode == PIPE_FACE_FRONT) {
+      keep_ccw = !setup->ccw_is_frontface;
+      keep_cw = setup->ccw_is_frontface;
+   }
+
+   struct u_rect draw_regions[PIPE_MAX_VIEWPORTS];
+   memcpy(draw_regions, setup->draw_regions, sizeof(draw_regions));
+
+   struct lp_setup_tri_prepass *prepass = setup->tri_prepass;
+   struct tri_prepass_job jobs[2];
+   for (unsigned i = 0; i < 2; i++) {
+      jobs[i].setup = setup;
+      jobs[i].out = &prepass[i];
+      jobs[i].vertex_buffer = vertex_buffer;
+      jobs[i].indices = indices;
+      jobs[i].stride = stride;
+      jobs[i].keep_ccw = keep_ccw;
+      jobs[i].keep_cw = keep_cw;
+      jobs[i].draw_regions = draw_regions;
+   }
+
+   jobs[0].first_tri = 0;
+   jobs[0].num_tris = MIN2(num_tris, LP_SETUP_PREPASS_BATCH);
+   struct lp_cs_tpool_task *task = queue_triangle_prepass(screen, &jobs[0]);
+
+   /* Double buffered: the pool sets up batch N+1 while we bin batch N. */
+   for (unsigned b = 0; ; b ^= 1) {
+      struct tri_prepass_job *job = &jobs[b];
+      struct tri_prepass_job *next = &jobs[b ^ 1];
+
+      lp_cs_tpool_wait_for_task(pool, &task);
+
+      next->first_tri = job->first_tri + job->num_tris;
+      next->num_tris = MIN2(num_tris - next->first_tri, LP_SETUP_PREPASS_BATCH);
+      if (next->num_tris)
+         task = queue_triangle_prepass(screen, next);
+
+      bin_triangle_prepass(setup, job);
+
+      if (!next->num_tris)
+         break;
+   }
+
+   return true;
+}
@@ -223,7 +223,10 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if (lp_setup_triangles_parallel(setup, vertex_buffer, stride,
+                                      indices, nr)) {
+         /* already emitted */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, indices[i-5], stride),
@@ -370,6 +373,8 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
    default:
       assert(0);
    }
+
+   lp_setup_stream_scene(setup);
 }
 
 
@@ -431,7 +436,10 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if (lp_setup_triangles_parallel(setup, vertex_buffer, stride,
+                                      NULL, nr)) {
+         /* already emitted */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, i-5, stride),
@@ -632,6 +640,8 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   lp_setup_stream_scene(setup);
 }
 
 
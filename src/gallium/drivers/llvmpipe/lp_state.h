@@ -125,6 +125,12 @@ llvmpipe_set_framebuffer_state(struct pipe_context *,
 void
 llvmpipe_update_fs(struct llvmpipe_context *lp);
 
+void
+llvmpipe_update_fs_tier(struct llvmpipe_context *lp);
+
+void
+llvmpipe_trim_variants(struct llvmpipe_context *lp);
+
 void 
 llvmpipe_update_setup(struct llvmpipe_context *lp);
 
@@ -73,6 +73,9 @@ struct lp_cs_job_info {
    bool zero_initialize_shared_memory;
    bool use_iters;
    struct lp_cs_exec *current;
+   /* For asynchronous grids: the shader and copies of user constants */
+   struct lp_compute_shader *shader;
+   void *user_constants;
    struct vertex_header *io;
    size_t io_stride;
    void *payload;
@@ -958,6 +961,7 @@ llvmpipe_create_compute_state(struct pipe_context *pipe,
       return NULL;
 
    shader->no = cs_no++;
+   mtx_init(&shader->lock, mtx_plain);
 
    shader->base.type = PIPE_SHADER_IR_NIR;
 
@@ -1002,6 +1006,7 @@ llvmpipe_bind_compute_state(struct pipe_context *pipe,
       return;
 
    llvmpipe->cs = (struct lp_compute_shader *)cs;
+   llvmpipe->cs_tier0_variant = NULL;
    llvmpipe->cs_dirty |= LP_CSNEW_CS;
 }
 
@@ -1024,10 +1029,12 @@ llvmpipe_get_compute_state_info(struct pipe_context *pipe, void *cs,
  * Remove shader variant from two lists: the shader's variant list
  * and the context's variant list.
  */
-static void
+void
 llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
                                   struct lp_compute_shader_variant *variant)
 {
+   llvmpipe_wait_compute(lp);
+
    if ((LP_DEBUG & DEBUG_CS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del cs #%u var %u v created %u v cached %u "
                    "v total cached %u inst %u total inst %u\n",
@@ -1037,6 +1044,21 @@ llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_cs_variants, variant->nr_instrs, lp->nr_cs_instrs);
    }
 
+   struct lp_cs_async_job *job = variant->async_job;
+   if (job) {
+      /* Only waits if the compile already started. */
+      util_queue_drop_job(&lp->compile_queue, &job->fence);
+      if (job->result) {
+         gallivm_destroy(job->result->gallivm);
+         FREE(job->result);
+      }
+      util_queue_fence_destroy(&job->fence);
+      FREE(job);
+   }
+
+   if (lp->cs_tier0_variant == variant)
+      lp->cs_tier0_variant = NULL;
+
    gallivm_destroy(variant->gallivm);
 
    /* remove from shader's list */
@@ -1047,6 +1069,7 @@ llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
    list_del(&variant->list_item_global.list);
    lp->nr_cs_variants--;
    lp->nr_cs_instrs -= variant->nr_instrs;
+   lp->variant_code_size -= variant->code_size;
 
    FREE(variant);
 }
@@ -1060,6 +1083,8 @@ llvmpipe_delete_compute_state(struct pipe_context *pipe,
    struct lp_compute_shader *shader = cs;
    struct lp_cs_variant_list_item *li, *next;
 
+   llvmpipe_wait_compute(llvmpipe);
+
    llvmpipe_register_shader(pipe, &shader->base, true);
 
    if (llvmpipe->cs == cs)
@@ -1073,6 +1098,7 @@ llvmpipe_delete_compute_state(struct pipe_context *pipe,
       llvmpipe_remove_cs_shader_variant(llvmpipe, li->base);
    }
    ralloc_free(shader->base.ir.nir);
+   mtx_destroy(&shader->lock);
    FREE(shader);
 }
 
@@ -1244,11 +1270,16 @@ lp_cs_get_ir_cache_key(struct lp_compute_shader_variant *variant,
 }
 
 
+/**
+ * See generate_variant() in lp_state_fs.c for \p context and \p fast.
+ */
 static struct lp_compute_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_compute_shader *shader,
                  enum pipe_shader_type sh_type,
-                 const struct lp_compute_shader_variant_key *key)
+                 const struct lp_compute_shader_variant_key *key,
+                 LLVMContextRef context,
+                 bool fast)
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
 
@@ -1259,6 +1290,8 @@ generate_variant(struct llvmpipe_context *lp,
 
    memset(variant, 0, sizeof(*variant));
 
+   mtx_lock(&shader->lock);
+
    char module_name[64];
    const char *shname = sh_type == PIPE_SHADER_MESH ? "ms" :
       (sh_type == PIPE_SHADER_TASK ? "ts" : "cs");
@@ -1275,15 +1308,25 @@ generate_variant(struct llvmpipe_context *lp,
    lp_cs_get_ir_cache_key(variant, ir_sha1_cache_key);
 
    lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
-   if (!cached.data_size)
-      needs_caching = true;
+   if (!cached.data_size) {
+      if (fast) {
+         variant->unoptimized = true;
+         cached.dont_cache = true;
+      } else {
+         needs_caching = true;
+      }
+   }
 
-   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
+   variant->gallivm = gallivm_create(module_name, context, &cached);
    if (!variant->gallivm) {
+      mtx_unlock(&shader->lock);
       FREE(variant);
       return NULL;
    }
 
+   if (variant->unoptimized)
+      gallivm_set_no_opt(variant->gallivm);
+
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
@@ -1306,6 +1349,8 @@ generate_variant(struct llvmpipe_context *lp,
 
    generate_compute(lp, shader, variant);
 
+   mtx_unlock(&shader->lock);
+
    gallivm_compile_module(variant->gallivm);
 
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
@@ -1316,6 +1361,7 @@ generate_variant(struct llvmpipe_context *lp,
    if (needs_caching) {
       lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
    }
+   variant->code_size = gallivm_code_size(variant->gallivm);
    gallivm_free_ir(variant->gallivm);
    return variant;
 }
@@ -1329,6 +1375,110 @@ lp_cs_ctx_set_cs_variant(struct lp_cs_context *csctx,
 }
 
 
+static void
+lp_cs_async_compile(void *data, void *gdata, int thread_index)
+{
+   struct lp_cs_async_job *job = data;
+   struct lp_compute_shader_variant *variant = job->variant;
+
+   /* LLVM contexts are not thread-safe, so use a private one. */
+   LLVMContextRef context = LLVMContextCreate();
+   if (!context)
+      return;
+
+#if LLVM_VERSION_MAJOR == 15
+   LLVMContextSetOpaquePointers(context, false);
+#endif
+
+   int64_t t0 = os_time_get();
+   job->result = generate_variant(job->lp, variant->shader,
+                                  PIPE_SHADER_COMPUTE, &variant->key,
+                                  context, false);
+   job->compile_time = os_time_get() - t0;
+
+   LLVMContextDispose(context);
+}
+
+
+static void
+lp_cs_queue_async_variant(struct llvmpipe_context *lp,
+                          struct lp_compute_shader_variant *variant)
+{
+   struct lp_cs_async_job *job = CALLOC_STRUCT(lp_cs_async_job);
+   if (!job)
+      return;
+
+   util_queue_fence_init(&job->fence);
+   job->lp = lp;
+   job->variant = variant;
+   variant->async_job = job;
+
+   util_queue_add_job(&lp->compile_queue, job, &job->fence,
+                      lp_cs_async_compile, NULL, 0);
+}
+
+
+/**
+ * Replace an unoptimized variant with the result of its background
+ * compile.  The old variant is freed, so the caller must rebind.
+ */
+static struct lp_compute_shader_variant *
+lp_cs_finish_async_variant(struct llvmpipe_context *lp,
+                           struct lp_compute_shader_variant *variant)
+{
+   struct lp_cs_async_job *job = variant->async_job;
+   struct lp_compute_shader_variant *result = job->result;
+
+   LP_COUNT(nr_async_cs_compiles);
+   LP_COUNT_ADD(async_compile_time, job->compile_time);
+
+   variant->async_job = NULL;
+   util_queue_fence_destroy(&job->fence);
+   FREE(job);
+
+   /* Keep using the unoptimized code if compilation failed. */
+   if (!result) {
+      variant->unoptimized = false;
+      return variant;
+   }
+
+   list_add(&result->list_item_local.list, &variant->list_item_local.list);
+   list_add(&result->list_item_global.list, &variant->list_item_global.list);
+   lp->nr_cs_variants++;
+   lp->nr_cs_instrs += result->nr_instrs;
+   lp->variant_code_size += result->code_size;
+   result->last_use = variant->last_use;
+   result->shader->variants_cached++;
+
+   llvmpipe_remove_cs_shader_variant(lp, variant);
+
+   return result;
+}
+
+
+/**
+ * Called for every dispatch while an unoptimized variant is bound, see
+ * llvmpipe_update_fs_tier().
+ */
+static void
+llvmpipe_update_cs_tier(struct llvmpipe_context *lp)
+{
+   struct lp_compute_shader_variant *variant = lp->cs_tier0_variant;
+
+   if (!variant->async_job) {
+      if (++variant->tier0_uses >= lp->tier_up_threshold)
+         lp_cs_queue_async_variant(lp, variant);
+      return;
+   }
+
+   if (util_queue_fence_is_signalled(&variant->async_job->fence)) {
+      variant = lp_cs_finish_async_variant(lp, variant);
+      lp->cs_tier0_variant = NULL;
+      lp_cs_ctx_set_cs_variant(lp->csctx, variant);
+   }
+}
+
+
 static struct lp_compute_shader_variant *
 llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
                            enum pipe_shader_type sh_type,
@@ -1349,13 +1499,21 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
    }
 
    if (variant) {
+      LP_COUNT(nr_variant_cache_hits);
+
+      if (variant->async_job &&
+          util_queue_fence_is_signalled(&variant->async_job->fence))
+         variant = lp_cs_finish_async_variant(lp, variant);
+
       /* Move this variant to the head of the list to implement LRU
        * deletion of shader's when we have too many.
        */
       list_move_to(&variant->list_item_global.list,
                    &lp->cs_variants_list.list);
+      variant->last_use = ++lp->variant_clock;
    } else {
       /* variant not found, create it now */
+      LP_COUNT(nr_variant_cache_misses);
 
       if (LP_DEBUG & DEBUG_CS) {
          debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
@@ -1401,12 +1559,18 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
          }
       }
 
+      llvmpipe_trim_variants(lp);
+
       /*
-       * Generate the new variant.
+       * Generate the new variant.  Compute shaders start out unoptimized
+       * when there is a compile queue, see llvmpipe_update_cs_tier().
        */
+      const bool async = sh_type == PIPE_SHADER_COMPUTE &&
+                         util_queue_is_initialized(&lp->compile_queue);
       int64_t t0, t1, dt;
       t0 = os_time_get();
-      variant = generate_variant(lp, shader, sh_type, key);
+      variant = generate_variant(lp, shader, sh_type, key, lp->context,
+                                 async);
       t1 = os_time_get();
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
@@ -1418,7 +1582,12 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
          list_add(&variant->list_item_global.list, &lp->cs_variants_list.list);
          lp->nr_cs_variants++;
          lp->nr_cs_instrs += variant->nr_instrs;
+         lp->variant_code_size += variant->code_size;
+         variant->last_use = ++lp->variant_clock;
          shader->variants_cached++;
+
+         if (variant->unoptimized)
+            LP_COUNT(nr_cs_stalls_avoided);
       }
    }
    return variant;
@@ -1430,6 +1599,7 @@ llvmpipe_update_cs(struct llvmpipe_context *lp)
    struct lp_compute_shader_variant *variant;
    variant = llvmpipe_update_cs_variant(lp, PIPE_SHADER_COMPUTE, lp->cs);
    /* Bind this variant */
+   lp->cs_tier0_variant = variant && variant->unoptimized ? variant : NULL;
    lp_cs_ctx_set_cs_variant(lp->csctx, variant);
 }
 
@@ -1746,42 +1916,200 @@ fill_grid_size(struct pipe_context *pipe,
 }
 
 
+/**
+ * Wait for the last grid launched on the context to complete.
+ */
+void
+llvmpipe_wait_compute(struct llvmpipe_context *lp)
+{
+   struct lp_cs_context *csctx = lp->csctx;
+
+   if (!csctx || !csctx->pending_task)
+      return;
+
+   /* Only this context clears them, so they can be read unlocked here. */
+   struct lp_cs_tpool_task *task = csctx->pending_task;
+   struct lp_cs_job_info *job_info = csctx->pending_job;
+
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+
+   mtx_lock(&csctx->pending_mutex);
+   csctx->pending_task = NULL;
+   csctx->pending_job = NULL;
+   mtx_unlock(&csctx->pending_mutex);
+
+   FREE(job_info->user_constants);
+   FREE(job_info);
+}
+
+
+static bool
+pending_job_references_resource(const struct lp_cs_context *csctx,
+                                const struct pipe_resource *resource)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(csctx->ssbos); i++) {
+      if (csctx->ssbos[i].current.buffer == resource)
+         return true;
+   }
+   for (unsigned i = 0; i < ARRAY_SIZE(csctx->images); i++) {
+      if (csctx->images[i].current.resource == resource)
+         return true;
+   }
+   for (unsigned i = 0; i < ARRAY_SIZE(csctx->constants); i++) {
+      if (csctx->constants[i].current.buffer == resource)
+         return true;
+   }
+   for (unsigned i = 0; i < csctx->cs.current_tex_num; i++) {
+      if (csctx->cs.current_tex[i] == resource)
+         return true;
+   }
+
+   const struct lp_compute_shader *shader = csctx->pending_job->shader;
+   for (unsigned i = 0; i < shader->max_global_buffers; i++) {
+      if (shader->global_buffers[i] == resource)
+         return true;
+   }
+   return false;
+}
+
+
+/**
+ * Whether a grid which may still be running uses the resource.
+ */
+bool
+llvmpipe_compute_references_resource(struct llvmpipe_context *lp,
+                                     const struct pipe_resource *resource)
+{
+   struct lp_cs_context *csctx = lp->csctx;
+   bool referenced = false;
+
+   if (!csctx)
+      return false;
+
+   /* May be called for another context, whose grid can complete meanwhile. */
+   mtx_lock(&csctx->pending_mutex);
+   if (csctx->pending_task)
+      referenced = pending_job_references_resource(csctx, resource);
+   mtx_unlock(&csctx->pending_mutex);
+
+   return referenced;
+}
+
+
+/**
+ * Copy the user constant buffers, which may change as soon as
+ * launch_grid() returns, and point the grid at the copies.
+ * Returns false if that failed, leaving the grid to read the originals.
+ */
+static bool
+copy_user_constants(struct llvmpipe_context *lp,
+                    struct lp_cs_job_info *job_info)
+{
+   struct lp_cs_context *csctx = lp->csctx;
+   struct lp_jit_buffer *jit_constants =
+      csctx->cs.current.jit_resources.constants;
+   size_t size = 0;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(csctx->constants); i++) {
+      const struct pipe_constant_buffer *cb = &csctx->constants[i].current;
+      if (!cb->buffer && cb->user_buffer && cb->buffer_size >= sizeof(float))
+         size += align(cb->buffer_size, 16);
+   }
+   if (!size)
+      return true;
+
+   uint8_t *data = MALLOC(size);
+   if (!data) {
+      /* The copies of an earlier grid are gone, so repoint at the
+       * originals. */
+      for (unsigned i = 0; i < ARRAY_SIZE(csctx->constants); i++) {
+         if (csctx->constants[i].current.user_buffer)
+            lp_jit_buffer_from_pipe_const(&jit_constants[i],
+                                          &csctx->constants[i].current,
+                                          lp->pipe.screen);
+      }
+      return false;
+   }
+   job_info->user_constants = data;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(csctx->constants); i++) {
+      const struct pipe_constant_buffer *cb = &csctx->constants[i].current;
+      if (cb->buffer || !cb->user_buffer || cb->buffer_size < sizeof(float))
+         continue;
+
+      memcpy(data, (const uint8_t *)cb->user_buffer + cb->buffer_offset,
+             cb->buffer_size);
+      jit_constants[i].f = (const float *)data;
+      data += align(cb->buffer_size, 16);
+   }
+   return true;
+}
+
+
+/**
+ * Queue the grid on the compute thread pool.  It runs in the background
+ * until llvmpipe_wait_compute(), which happens on the next launch, on
+ * flush, and before the resources or shaders it uses change.
+ */
 static void
 llvmpipe_launch_grid(struct pipe_context *pipe,
                      const struct pipe_grid_info *info)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
-   struct lp_cs_job_info job_info;
 
    if (!llvmpipe_check_render_cond(llvmpipe))
       return;
 
-   memset(&job_info, 0, sizeof(job_info));
+   /* The previous grid still uses the compute context state. */
+   llvmpipe_wait_compute(llvmpipe);
 
    llvmpipe_cs_update_derived(llvmpipe, info->input);
 
-   fill_grid_size(pipe, 0, info, job_info.grid_size);
+   if (llvmpipe->cs_tier0_variant)
+      llvmpipe_update_cs_tier(llvmpipe);
 
-   job_info.grid_base[0] = info->grid_base[0];
-   job_info.grid_base[1] = info->grid_base[1];
-   job_info.grid_base[2] = info->grid_base[2];
-   job_info.block_size[0] = info->block[0];
-   job_info.block_size[1] = info->block[1];
-   job_info.block_size[2] = info->block[2];
-   job_info.work_dim = info->work_dim;
-   job_info.req_local_mem = llvmpipe->cs->req_local_mem + info->variable_shared_mem;
-   job_info.zero_initialize_shared_memory = llvmpipe->cs->zero_initialize_shared_memory;
-   job_info.current = &llvmpipe->csctx->cs.current;
+   struct lp_cs_job_info *job_info = CALLOC_STRUCT(lp_cs_job_info);
+   if (!job_info)
+      return;
 
-   int num_tasks = job_info.grid_size[2] * job_info.grid_size[1] * job_info.grid_size[0];
+   fill_grid_size(pipe, 0, info, job_info->grid_size);
+
+   job_info->grid_base[0] = info->grid_base[0];
+   job_info->grid_base[1] = info->grid_base[1];
+   job_info->grid_base[2] = info->grid_base[2];
+   job_info->block_size[0] = info->block[0];
+   job_info->block_size[1] = info->block[1];
+   job_info->block_size[2] = info->block[2];
+   job_info->work_dim = info->work_dim;
+   job_info->req_local_mem = llvmpipe->cs->req_local_mem + info->variable_shared_mem;
+   job_info->zero_initialize_shared_memory = llvmpipe->cs->zero_initialize_shared_memory;
+   job_info->current = &llvmpipe->csctx->cs.current;
+   job_info->shader = llvmpipe->cs;
+
+   /* Kernel inputs are caller memory of unknown size, so wait for those. */
+   const bool sync = !copy_user_constants(llvmpipe, job_info) || info->input;
+
+   int num_tasks = job_info->grid_size[2] * job_info->grid_size[1] * job_info->grid_size[0];
+   struct lp_cs_tpool_task *task = NULL;
    if (num_tasks) {
-      struct lp_cs_tpool_task *task;
       mtx_lock(&screen->cs_mutex);
-      task = lp_cs_tpool_queue_task(screen->cs_tpool, cs_exec_fn, &job_info, num_tasks);
+      task = lp_cs_tpool_queue_task(screen->cs_tpool, cs_exec_fn, job_info, num_tasks);
       mtx_unlock(&screen->cs_mutex);
+   }
 
-      lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+   /* Without pool threads the grid has run already. */
+   if (task) {
+      mtx_lock(&llvmpipe->csctx->pending_mutex);
+      llvmpipe->csctx->pending_task = task;
+      llvmpipe->csctx->pending_job = job_info;
+      mtx_unlock(&llvmpipe->csctx->pending_mutex);
+      if (sync)
+         llvmpipe_wait_compute(llvmpipe);
+   } else {
+      FREE(job_info->user_constants);
+      FREE(job_info);
    }
    if (!llvmpipe->queries_disabled)
       llvmpipe->pipeline_statistics.cs_invocations += num_tasks * info->block[0] * info->block[1] * info->block[2];
@@ -1805,6 +2133,8 @@ llvmpipe_set_global_binding(struct pipe_context *pipe,
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct lp_compute_shader *cs = llvmpipe->cs;
 
+   llvmpipe_wait_compute(llvmpipe);
+
    if (first + count > cs->max_global_buffers) {
       unsigned old_max = cs->max_global_buffers;
       cs->max_global_buffers = first + count;
@@ -1867,6 +2197,7 @@ lp_csctx_destroy(struct lp_cs_context *csctx)
    for (i = 0; i < ARRAY_SIZE(csctx->images); i++) {
       pipe_resource_reference(&csctx->images[i].current.resource, NULL);
    }
+   mtx_destroy(&csctx->pending_mutex);
    FREE(csctx);
 }
 
@@ -1879,6 +2210,7 @@ lp_csctx_create(struct pipe_context *pipe)
       return NULL;
 
    csctx->pipe = pipe;
+   (void) mtx_init(&csctx->pending_mutex, mtx_plain);
    return csctx;
 }
 
@@ -1903,6 +2235,7 @@ llvmpipe_create_ts_state(struct pipe_context *pipe,
 
    shader->no = task_no++;
    shader->base.type = templ->type;
+   mtx_init(&shader->lock, mtx_plain);
 
    shader->base.ir.nir = templ->ir.nir;
    shader->req_local_mem += ((struct nir_shader *)shader->base.ir.nir)->info.shared_size;
@@ -1943,6 +2276,7 @@ llvmpipe_delete_ts_state(struct pipe_context *pipe, void *_task)
       llvmpipe_remove_cs_shader_variant(llvmpipe, li->base);
    }
    ralloc_free(shader->base.ir.nir);
+   mtx_destroy(&shader->lock);
    FREE(shader);
 }
 
@@ -1976,6 +2310,7 @@ llvmpipe_create_ms_state(struct pipe_context *pipe,
 
    shader->no = mesh_no++;
    shader->base.type = templ->type;
+   mtx_init(&shader->lock, mtx_plain);
 
    shader->base.ir.nir = templ->ir.nir;
    shader->req_local_mem += ((struct nir_shader *)shader->base.ir.nir)->info.shared_size;
@@ -1983,6 +2318,7 @@ llvmpipe_create_ms_state(struct pipe_context *pipe,
 
    shader->draw_mesh_data = draw_create_mesh_shader(llvmpipe->draw, templ);
    if (shader->draw_mesh_data == NULL) {
+      mtx_destroy(&shader->lock);
       FREE(shader);
       llvmpipe_register_shader(pipe, templ, true);
       return NULL;
@@ -2028,6 +2364,7 @@ llvmpipe_delete_ms_state(struct pipe_context *pipe, void *_mesh)
 
    draw_delete_mesh_shader(llvmpipe->draw, shader->draw_mesh_data);
    ralloc_free(shader->base.ir.nir);
+   mtx_destroy(&shader->lock);
 
    FREE(shader);
 }
@@ -2114,6 +2451,9 @@ llvmpipe_draw_mesh_tasks(struct pipe_context *pipe,
    if (lp->dirty)
       llvmpipe_update_derived(lp);
 
+   if (lp->fs_tier0_variant)
+      llvmpipe_update_fs_tier(lp);
+
    unsigned draw_count = info->draw_count;
    if (info->indirect && info->indirect_draw_count) {
       struct pipe_transfer *dc_transfer;
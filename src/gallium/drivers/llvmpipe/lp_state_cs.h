@@ -75,6 +75,19 @@ struct lp_cs_variant_list_item
    struct lp_compute_shader_variant *base;
 };
 
+/**
+ * Optimized compile of an unoptimized compute shader variant, see
+ * struct lp_fs_async_job.
+ */
+struct lp_cs_async_job
+{
+   struct util_queue_fence fence;
+   struct llvmpipe_context *lp;
+   struct lp_compute_shader_variant *variant;
+   struct lp_compute_shader_variant *result;
+   int64_t compile_time;  /**< in microseconds */
+};
+
 struct lp_compute_shader_variant
 {
    struct gallivm_state *gallivm;
@@ -95,11 +108,21 @@ struct lp_compute_shader_variant
 
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
+   /* Bytes of JIT code and data */
+   size_t code_size;
+   /* Value of llvmpipe_context::variant_clock when last bound */
+   uint64_t last_use;
 
    struct lp_cs_variant_list_item list_item_global, list_item_local;
 
    struct lp_compute_shader *shader;
 
+   bool unoptimized;
+   /* Dispatches using this variant while unoptimized */
+   unsigned tier0_uses;
+   /* Pending background compile replacing this variant, if any */
+   struct lp_cs_async_job *async_job;
+
    /* For debugging/profiling purposes */
    unsigned no;
 
@@ -115,6 +138,9 @@ struct lp_compute_shader {
    struct draw_mesh_shader *draw_mesh_data;
    uint32_t req_local_mem;
 
+   /* Serializes variant code generation, which modifies the NIR */
+   mtx_t lock;
+
    /* For debugging/profiling purposes */
    unsigned variant_key_size;
    unsigned no;
@@ -158,9 +184,28 @@ struct lp_cs_context {
    } images[LP_MAX_TGSI_SHADER_IMAGES];
 
    const void *input;
+
+   /** Grid still running on the compute thread pool, if any.
+    * Other contexts look at these from llvmpipe_flush_resource(), so
+    * they are only changed with pending_mutex held.
+    */
+   mtx_t pending_mutex;
+   struct lp_cs_tpool_task *pending_task;
+   struct lp_cs_job_info *pending_job;
 };
 
 struct lp_cs_context *lp_csctx_create(struct pipe_context *pipe);
 void lp_csctx_destroy(struct lp_cs_context *csctx);
 
+void
+llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
+                                  struct lp_compute_shader_variant *variant);
+
+void
+llvmpipe_wait_compute(struct llvmpipe_context *lp);
+
+bool
+llvmpipe_compute_references_resource(struct llvmpipe_context *lp,
+                                     const struct pipe_resource *resource);
+
 #endif
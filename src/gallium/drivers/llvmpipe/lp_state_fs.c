@@ -3685,6 +3685,9 @@ lp_debug_fs_variant(struct lp_fragment_shader_variant *variant)
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("variant->potentially_opaque = %u\n", variant->potentially_opaque);
    debug_printf("variant->blit = %u\n", variant->blit);
+   debug_printf("variant->hiz_cull = %u\n", variant->hiz_cull);
+   debug_printf("variant->hiz_update = %u\n", variant->hiz_update);
+   debug_printf("variant->hiz_clobber = %u\n", variant->hiz_clobber);
    debug_printf("shader->kind = %s\n", lp_debug_fs_kind(variant->shader->kind));
    debug_printf("\n");
 }
@@ -3713,14 +3716,39 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
 }
 
 
+/**
+ * The linear and blit paths read textures directly, so can't deal with
+ * tiled ones.
+ */
+static bool
+fs_variant_key_has_tiled_texture(const struct lp_fragment_shader_variant_key *key)
+{
+   const struct lp_sampler_static_state *samplers =
+      lp_fs_variant_key_samplers(key);
+
+   for (unsigned i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); i++) {
+      if (samplers[i].texture_state.tiled)
+         return true;
+   }
+   return false;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * May run on a compile queue thread, so the LLVM context is passed in
+ * rather than taken from the llvmpipe context.  With \p fast set, code
+ * not found in the disk cache is compiled without optimizations, and
+ * the variant is marked as unoptimized.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+                 const struct lp_fragment_shader_variant_key *key,
+                 LLVMContextRef context,
+                 bool fast)
 {
    struct nir_shader *nir = shader->base.ir.nir;
    struct lp_fragment_shader_variant *variant =
@@ -3735,6 +3763,8 @@ generate_variant(struct llvmpipe_context *lp,
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
+   mtx_lock(&shader->lock);
+
    struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_cached_code cached = { 0 };
    unsigned char ir_sha1_cache_key[20];
@@ -3743,19 +3773,31 @@ generate_variant(struct llvmpipe_context *lp,
       lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
 
       lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
-      if (!cached.data_size)
-         needs_caching = true;
+      if (!cached.data_size) {
+         /* Unoptimized code must not end up in the cache. */
+         if (fast) {
+            variant->unoptimized = 1;
+            cached.dont_cache = true;
+         } else {
+            needs_caching = true;
+         }
+      }
    }
 
    char module_name[64];
    snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
             shader->no, shader->variants_created);
-   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
+   variant->gallivm = gallivm_create(module_name, context, &cached);
    if (!variant->gallivm) {
+      mtx_unlock(&shader->lock);
+      lp_fs_reference(lp, &variant->shader, NULL);
       FREE(variant);
       return NULL;
    }
 
+   if (variant->unoptimized)
+      gallivm_set_no_opt(variant->gallivm);
+
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
@@ -3830,6 +3872,7 @@ generate_variant(struct llvmpipe_context *lp,
       }
 
       if (target == PIPE_TEXTURE_2D &&
+          !samp0->texture_state.tiled &&
           min_img_filter == PIPE_TEX_FILTER_NEAREST &&
           mag_img_filter == PIPE_TEX_FILTER_NEAREST &&
           min_mip_filter == PIPE_TEX_MIPFILTER_NONE &&
@@ -3845,10 +3888,48 @@ generate_variant(struct llvmpipe_context *lp,
       }
    }
 
+   /* Hierarchical Z.  Culling relies on the fragment depth being the
+    * interpolated depth plane, and on rejected fragments having no effect
+    * besides failing the depth test.  Lowering the depth bound of a fully
+    * covered block additionally requires every fragment in it to leave
+    * the lesser of its depth and the old depth in the depth buffer.
+    */
+   const bool writes_z =
+         nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_DEPTH);
+   const bool depth_less =
+         key->depth.func == PIPE_FUNC_LESS ||
+         key->depth.func == PIPE_FUNC_LEQUAL;
+
+   variant->hiz_cull =
+         key->depth.enabled &&
+         (depth_less || key->depth.func == PIPE_FUNC_EQUAL) &&
+         !key->stencil[0].enabled &&
+         !key->depth_clamp &&
+         !writes_z &&
+         (!nir->info.writes_memory || nir->info.fs.early_fragment_tests);
+
+   variant->hiz_update =
+         variant->hiz_cull &&
+         depth_less &&
+         key->depth.writemask &&
+         !key->alpha.enabled &&
+         !key->multisample &&
+         !key->blend.alpha_to_coverage &&
+         !nir->info.fs.uses_discard &&
+         !(nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_SAMPLE_MASK));
+
+   variant->hiz_clobber =
+         key->depth.enabled &&
+         key->depth.writemask &&
+         !depth_less &&
+         key->depth.func != PIPE_FUNC_EQUAL &&
+         key->depth.func != PIPE_FUNC_NEVER;
+
    /* Determine whether this shader + pipeline state is a candidate for
     * the linear path.
     */
    const bool linear_pipeline =
+         !fs_variant_key_has_tiled_texture(key) &&
          !key->stencil[0].enabled &&
          !key->depth.enabled &&
          !nir->info.fs.uses_discard &&
@@ -3908,6 +3989,8 @@ generate_variant(struct llvmpipe_context *lp,
       }
    }
 
+   mtx_unlock(&shader->lock);
+
    /*
     * Compile everything
     */
@@ -3948,6 +4031,8 @@ generate_variant(struct llvmpipe_context *lp,
       lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
    }
 
+   variant->code_size = gallivm_code_size(variant->gallivm);
+
    gallivm_free_ir(variant->gallivm);
 
    return variant;
@@ -3967,6 +4052,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    pipe_reference_init(&shader->reference, 1);
    shader->no = fs_no++;
    list_inithead(&shader->variants.list);
+   mtx_init(&shader->lock, mtx_plain);
 
    shader->base.type = PIPE_SHADER_IR_NIR;
 
@@ -3988,6 +4074,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      mtx_destroy(&shader->lock);
       FREE(shader);
       return NULL;
    }
@@ -4072,6 +4159,7 @@ llvmpipe_bind_fs_state(struct pipe_context *pipe, void *fs)
 
    /* invalidate the setup link, NEW_FS will make it update */
    lp_setup_set_fs_variant(llvmpipe->setup, NULL);
+   llvmpipe->fs_tier0_variant = NULL;
    llvmpipe->dirty |= LP_NEW_FS;
 }
 
@@ -4101,6 +4189,20 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
    list_del(&variant->list_item_global.list);
    lp->nr_fs_variants--;
    lp->nr_fs_instrs -= variant->nr_instrs;
+   lp->variant_code_size -= variant->code_size;
+}
+
+
+/**
+ * Drop the variant from the caches.  Scenes still referencing it keep it
+ * alive until they are done.
+ */
+void
+llvmpipe_evict_fs_variant(struct llvmpipe_context *lp,
+                          struct lp_fragment_shader_variant *variant)
+{
+   llvmpipe_remove_shader_variant(lp, variant);
+   lp_fs_variant_reference(lp, &variant, NULL);
 }
 
 
@@ -4108,6 +4210,19 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
+   struct lp_fs_async_job *job = variant->async_job;
+   if (job) {
+      /* Only waits if the compile already started. */
+      util_queue_drop_job(&lp->compile_queue, &job->fence);
+      if (job->result)
+         llvmpipe_destroy_shader_variant(lp, job->result);
+      util_queue_fence_destroy(&job->fence);
+      FREE(job);
+   }
+
+   if (lp->fs_tier0_variant == variant)
+      lp->fs_tier0_variant = NULL;
+
    gallivm_destroy(variant->gallivm);
    lp_fs_reference(lp, &variant->shader, NULL);
    FREE(variant);
@@ -4125,6 +4240,7 @@ llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
 
    ralloc_free(shader->base.ir.nir);
    assert(shader->variants_cached == 0);
+   mtx_destroy(&shader->lock);
    FREE(shader);
 }
 
@@ -4616,6 +4732,118 @@ make_variant_key(struct llvmpipe_context *lp,
 }
 
 
+static void
+lp_fs_async_compile(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_async_job *job = data;
+   struct lp_fragment_shader_variant *variant = job->variant;
+
+   /* LLVM contexts are not thread-safe, so use a private one. */
+   LLVMContextRef context = LLVMContextCreate();
+   if (!context)
+      return;
+
+#if LLVM_VERSION_MAJOR == 15
+   LLVMContextSetOpaquePointers(context, false);
+#endif
+
+   int64_t t0 = os_time_get();
+   job->result = generate_variant(job->lp, variant->shader, &variant->key,
+                                  context, false);
+   job->compile_time = os_time_get() - t0;
+
+   /* Only the IR lives in the context, and that is gone by now. */
+   LLVMContextDispose(context);
+}
+
+
+/**
+ * Compile an optimized replacement for an unoptimized variant on the
+ * compile queue.
+ */
+static void
+lp_fs_queue_async_variant(struct llvmpipe_context *lp,
+                          struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_async_job *job = CALLOC_STRUCT(lp_fs_async_job);
+   if (!job)
+      return;
+
+   util_queue_fence_init(&job->fence);
+   job->lp = lp;
+   job->variant = variant;
+   variant->async_job = job;
+
+   util_queue_add_job(&lp->compile_queue, job, &job->fence,
+                      lp_fs_async_compile, NULL, 0);
+}
+
+
+/**
+ * Replace an unoptimized variant with the result of its background
+ * compile, taking over its place in both variant lists.
+ * Returns the variant to use.
+ */
+static struct lp_fragment_shader_variant *
+lp_fs_finish_async_variant(struct llvmpipe_context *lp,
+                           struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_async_job *job = variant->async_job;
+   struct lp_fragment_shader_variant *result = job->result;
+
+   LP_COUNT(nr_async_fs_compiles);
+   LP_COUNT_ADD(async_compile_time, job->compile_time);
+
+   variant->async_job = NULL;
+   util_queue_fence_destroy(&job->fence);
+   FREE(job);
+
+   /* Keep using the unoptimized code if compilation failed. */
+   if (!result) {
+      variant->unoptimized = 0;
+      return variant;
+   }
+
+   list_add(&result->list_item_local.list, &variant->list_item_local.list);
+   list_add(&result->list_item_global.list, &variant->list_item_global.list);
+   lp->nr_fs_variants++;
+   lp->nr_fs_instrs += result->nr_instrs;
+   lp->variant_code_size += result->code_size;
+   result->last_use = variant->last_use;
+   result->shader->variants_cached++;
+
+   /* Scenes still holding the old variant keep it alive. */
+   llvmpipe_remove_shader_variant(lp, variant);
+   lp_fs_variant_reference(lp, &variant, NULL);
+
+   return result;
+}
+
+
+/**
+ * Called for every draw while an unoptimized variant is bound.  Queues the
+ * optimized compile once the variant has been used often enough, and binds
+ * the result once that is done.
+ */
+void
+llvmpipe_update_fs_tier(struct llvmpipe_context *lp)
+{
+   struct lp_fragment_shader_variant *variant = lp->fs_tier0_variant;
+
+   if (!variant->async_job) {
+      if (++variant->tier0_uses >= lp->tier_up_threshold)
+         lp_fs_queue_async_variant(lp, variant);
+      return;
+   }
+
+   if (util_queue_fence_is_signalled(&variant->async_job->fence)) {
+      variant = lp_fs_finish_async_variant(lp, variant);
+      lp->fs_tier0_variant = NULL;
+      lp_setup_set_fs_variant(lp->setup, variant);
+   }
+}
+
+
 /**
  * Update fragment shader state.  This is called just prior to drawing
  * something when some fragment-related state has changed.
@@ -4640,12 +4868,20 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
 
    if (variant) {
+      LP_COUNT(nr_variant_cache_hits);
+
+      if (variant->async_job &&
+          util_queue_fence_is_signalled(&variant->async_job->fence))
+         variant = lp_fs_finish_async_variant(lp, variant);
+
       /* Move this variant to the head of the list to implement LRU
        * deletion of shader's when we have too many.
        */
       list_move_to(&variant->list_item_global.list, &lp->fs_variants_list.list);
+      variant->last_use = ++lp->variant_clock;
    } else {
       /* variant not found, create it now */
+      LP_COUNT(nr_variant_cache_misses);
 
       if (LP_DEBUG & DEBUG_FS) {
          debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
@@ -4689,17 +4925,20 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
                                    struct lp_fs_variant_list_item, list);
             assert(item);
             assert(item->base);
-            llvmpipe_remove_shader_variant(lp, item->base);
-            struct lp_fragment_shader_variant *variant = item->base;
-            lp_fs_variant_reference(lp, &variant, NULL);
+            llvmpipe_evict_fs_variant(lp, item->base);
          }
       }
 
+      llvmpipe_trim_variants(lp);
+
       /*
-       * Generate the new variant.
+       * Generate the new variant.  With a compile queue, only a quick
+       * unoptimized one for now, see llvmpipe_update_fs_tier().
        */
+      const bool async =
+         util_queue_is_initialized(&lp->compile_queue);
       int64_t t0 = os_time_get();
-      variant = generate_variant(lp, shader, key);
+      variant = generate_variant(lp, shader, key, lp->context, async);
       int64_t t1 = os_time_get();
       int64_t dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
@@ -4711,11 +4950,17 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
          lp->nr_fs_variants++;
          lp->nr_fs_instrs += variant->nr_instrs;
+         lp->variant_code_size += variant->code_size;
+         variant->last_use = ++lp->variant_clock;
          shader->variants_cached++;
+
+         if (variant->unoptimized)
+            LP_COUNT(nr_fs_stalls_avoided);
       }
    }
 
    /* Bind this variant */
+   lp->fs_tier0_variant = variant && variant->unoptimized ? variant : NULL;
    lp_setup_set_fs_variant(lp->setup, variant);
 }
 
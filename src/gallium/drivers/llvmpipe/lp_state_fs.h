@@ -38,6 +38,7 @@
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 #include "util/u_inlines.h"
+#include "util/u_queue.h"
 #include "lp_jit.h"
 
 struct lp_fragment_shader;
@@ -141,6 +142,21 @@ struct lp_fs_variant_list_item
 };
 
 
+/**
+ * Optimized compile of a variant on the context's compile queue.  It is
+ * owned by the unoptimized stand-in variant, which is used until the
+ * fence signals and is then replaced by the result.
+ */
+struct lp_fs_async_job
+{
+   struct util_queue_fence fence;
+   struct llvmpipe_context *lp;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_fragment_shader_variant *result;
+   int64_t compile_time;  /**< in microseconds */
+};
+
+
 struct lp_fragment_shader_variant
 {
    /*
@@ -150,6 +166,12 @@ struct lp_fragment_shader_variant
 
    unsigned opaque:1;
    unsigned blit:1;
+   unsigned unoptimized:1;
+
+   /* Hierarchical Z, see lp_rast_hiz_cull() */
+   unsigned hiz_cull:1;     /**< may skip blocks behind the depth buffer */
+   unsigned hiz_update:1;   /**< full blocks lower the depth bound */
+   unsigned hiz_clobber:1;  /**< may raise depth buffer values */
    unsigned linear_input_mask:16;
    struct pipe_reference reference;
 
@@ -184,10 +206,20 @@ struct lp_fragment_shader_variant
 
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
+   /* Bytes of JIT code and data */
+   size_t code_size;
+   /* Value of llvmpipe_context::variant_clock when last bound */
+   uint64_t last_use;
 
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
+   /* Draws using this variant while unoptimized */
+   unsigned tier0_uses;
+
+   /* Pending background compile replacing this variant, if any */
+   struct lp_fs_async_job *async_job;
+
    /* For debugging/profiling purposes */
    unsigned no;
 
@@ -211,6 +243,9 @@ struct lp_fragment_shader
 
    struct draw_fragment_shader *draw_data;
 
+   /* Serializes variant code generation, which modifies the NIR */
+   mtx_t lock;
+
    /* For debugging/profiling purposes */
    unsigned variant_key_size;
    unsigned no;
@@ -266,6 +301,10 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant);
 
+void
+llvmpipe_evict_fs_variant(struct llvmpipe_context *lp,
+                          struct lp_fragment_shader_variant *variant);
+
 static inline void
 lp_fs_variant_reference(struct llvmpipe_context *llvmpipe,
                         struct lp_fragment_shader_variant **ptr,
@@ -29,6 +29,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "gallivm/lp_bld_arit.h"
 #include "gallivm/lp_bld_bitarit.h"
 #include "gallivm/lp_bld_const.h"
@@ -52,6 +53,7 @@
 
 /** Setup shader number (for debugging) */
 static unsigned setup_no = 0;
+static const char *setup_function_base_hash = "5c2fb709d8a40936d55647b3d34bf596f7c5bc12120d94aa21f5db7763b97d66";
 
 
 /* currently organized to interpolate full float[4] attributes even
@@ -647,12 +649,27 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    variant->no = setup_no++;
 
-   char func_name[64];
-   snprintf(func_name, sizeof(func_name), "setup_variant_%u",
+   char module_name[64];
+   snprintf(module_name, sizeof(module_name), "setup_variant_%u",
             variant->no);
 
+   /* The key fully determines the code. */
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   unsigned char cache_key[SHA1_DIGEST_LENGTH];
+   struct mesa_sha1 hash_ctx;
+   _mesa_sha1_init(&hash_ctx);
+   _mesa_sha1_update(&hash_ctx, setup_function_base_hash,
+                     strlen(setup_function_base_hash));
+   _mesa_sha1_update(&hash_ctx, key, key->size);
+   _mesa_sha1_final(&hash_ctx, cache_key);
+
+   struct lp_cached_code cached = { 0 };
+   lp_disk_cache_find_shader(screen, &cached, cache_key);
+   bool needs_caching = !cached.data_size;
+
    struct gallivm_state *gallivm;
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context, NULL);
+   variant->gallivm = gallivm = gallivm_create(module_name, lp->context,
+                                               &cached);
    if (!variant->gallivm) {
       goto fail;
    }
@@ -687,7 +704,9 @@ generate_setup_variant(struct lp_setup_variant_key *key,
       LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                        arg_types, ARRAY_SIZE(arg_types), 0);
 
-   variant->function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   /* Must not vary between runs, as cached code is looked up by name. */
+   variant->function = LLVMAddFunction(gallivm->module, "setup_variant",
+                                       func_type);
    if (!variant->function)
       goto fail;
 
@@ -736,6 +755,10 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    if (!variant->jit_function)
       goto fail;
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, cache_key);
+
+   variant->code_size = gallivm_code_size(gallivm);
    gallivm_free_ir(variant->gallivm);
 
    /*
@@ -832,6 +855,7 @@ remove_setup_variant(struct llvmpipe_context *lp,
 
    list_del(&variant->list_item_global.list);
    lp->nr_setup_variants--;
+   lp->variant_code_size -= variant->code_size;
    FREE(variant);
 }
 
@@ -888,8 +912,12 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
    }
 
    if (variant) {
+      LP_COUNT(nr_variant_cache_hits);
       list_move_to(&variant->list_item_global.list, &lp->setup_variants_list.list);
    } else {
+      LP_COUNT(nr_variant_cache_misses);
+
+      /* Setup variants only go by count, see llvmpipe_trim_variants(). */
       if (lp->nr_setup_variants >= LP_MAX_SETUP_VARIANTS) {
          cull_setup_variants(lp);
       }
@@ -898,6 +926,7 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
       if (variant) {
          list_add(&variant->list_item_global.list, &lp->setup_variants_list.list);
          lp->nr_setup_variants++;
+         lp->variant_code_size += variant->code_size;
       }
    }
 
@@ -71,6 +71,9 @@ struct lp_setup_variant {
     */
    lp_jit_setup_triangle jit_function;
 
+   /* Bytes of JIT code and data */
+   size_t code_size;
+
    unsigned no;
 };
 
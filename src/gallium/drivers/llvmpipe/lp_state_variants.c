@@ -0,0 +1,103 @@
+/*
+ * Copyright 2026 agent
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Memory budget for the JIT code of fragment and compute shader variants.
+ *
+ * Each variant list is capped by count and instruction totals on its own.
+ * On top of that, once the code held by all variants exceeds
+ * LP_SHADER_CODE_BUDGET, the least recently used ones go first, whichever
+ * list they are on.  Variants which are currently bound are never evicted.
+ *
+ * Setup variants count towards the total but are not evicted here, as
+ * dropping them requires the context to be idle.
+ */
+
+#include "gallivm/lp_bld_debug.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_setup_context.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_state_fs.h"
+
+
+static bool
+fs_variant_is_bound(const struct llvmpipe_context *lp,
+                    const struct lp_fragment_shader_variant *variant)
+{
+   return variant == lp->setup->fs.current.variant ||
+          variant == lp->fs_tier0_variant;
+}
+
+
+static bool
+cs_variant_is_bound(const struct llvmpipe_context *lp,
+                    const struct lp_compute_shader_variant *variant)
+{
+   return variant == lp->csctx->cs.current.variant ||
+          variant == lp->task_ctx->cs.current.variant ||
+          variant == lp->mesh_ctx->cs.current.variant ||
+          variant == lp->cs_tier0_variant;
+}
+
+
+/** Least recently used FS variant which may be evicted, if any */
+static struct lp_fragment_shader_variant *
+lru_fs_variant(const struct llvmpipe_context *lp)
+{
+   list_for_each_entry_rev(struct lp_fs_variant_list_item, li,
+                           &lp->fs_variants_list.list, list) {
+      if (!fs_variant_is_bound(lp, li->base))
+         return li->base;
+   }
+   return NULL;
+}
+
+
+/** Least recently used CS variant which may be evicted, if any */
+static struct lp_compute_shader_variant *
+lru_cs_variant(const struct llvmpipe_context *lp)
+{
+   list_for_each_entry_rev(struct lp_cs_variant_list_item, li,
+                           &lp->cs_variants_list.list, list) {
+      if (!cs_variant_is_bound(lp, li->base))
+         return li->base;
+   }
+   return NULL;
+}
+
+
+/**
+ * Evict FS and CS variants in LRU order until the code they hold fits
+ * into the budget.  Called before compiling a new variant.
+ */
+void
+llvmpipe_trim_variants(struct llvmpipe_context *lp)
+{
+   if (!lp->variant_code_budget ||
+       lp->variant_code_size <= lp->variant_code_budget)
+      return;
+
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      debug_printf("Evicting variants: %zu bytes of code, budget %zu\n",
+                   lp->variant_code_size, lp->variant_code_budget);
+   }
+
+   while (lp->variant_code_size > lp->variant_code_budget) {
+      struct lp_fragment_shader_variant *fs = lru_fs_variant(lp);
+      struct lp_compute_shader_variant *cs = lru_cs_variant(lp);
+
+      if (fs && (!cs || fs->last_use <= cs->last_use))
+         llvmpipe_evict_fs_variant(lp, fs);
+      else if (cs)
+         llvmpipe_remove_cs_shader_variant(lp, cs);
+      else
+         break;
+
+      LP_COUNT(nr_variant_evictions);
+   }
+}
@@ -28,6 +28,7 @@
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_memset.h"
+#include "draw/draw_context.h"
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_limits.h"
@@ -201,6 +202,31 @@ lp_flush_resource(struct pipe_context *ctx, struct pipe_resource *resource)
 }
 
 
+/**
+ * Only the framebuffer attachments are of interest here, see
+ * lp_setup_discard_attachments().
+ */
+static void
+llvmpipe_invalidate_resource(struct pipe_context *pipe,
+                             struct pipe_resource *resource)
+{
+   struct llvmpipe_context *lp = llvmpipe_context(pipe);
+   const struct pipe_framebuffer_state *fb = &lp->framebuffer;
+   unsigned cbufs = 0;
+
+   for (unsigned i = 0; i < fb->nr_cbufs; i++) {
+      if (fb->cbufs[i] && fb->cbufs[i]->texture == resource)
+         cbufs |= 1 << i;
+   }
+   const bool zs = fb->zsbuf && fb->zsbuf->texture == resource;
+
+   if (cbufs || zs) {
+      draw_flush(lp->draw);
+      lp_setup_discard_attachments(lp->setup, cbufs, zs);
+   }
+}
+
+
 static struct pipe_surface *
 llvmpipe_create_surface(struct pipe_context *pipe,
                         struct pipe_resource *pt,
@@ -523,5 +549,6 @@ llvmpipe_init_surface_functions(struct llvmpipe_context *lp)
    lp->pipe.resource_copy_region = lp_resource_copy;
    lp->pipe.blit = lp_blit;
    lp->pipe.flush_resource = lp_flush_resource;
+   lp->pipe.invalidate_resource = llvmpipe_invalidate_resource;
    lp->pipe.get_sample_position = llvmpipe_get_sample_position;
 }
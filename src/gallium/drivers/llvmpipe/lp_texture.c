@@ -42,6 +42,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_transfer.h"
+#include "gallivm/lp_bld_sample.h"
 
 #include "lp_context.h"
 #include "lp_flush.h"
@@ -49,6 +50,7 @@
 #include "lp_texture.h"
 #include "lp_setup.h"
 #include "lp_state.h"
+#include "lp_state_cs.h"
 #include "lp_rast.h"
 
 #include "frontend/sw_winsys.h"
@@ -66,6 +68,44 @@ static simple_mtx_t resource_list_mutex = SIMPLE_MTX_INITIALIZER;
 static unsigned id_counter = 0;
 
 
+/**
+ * Whether the texture can be stored in micro-tiles, see
+ * LP_RESOURCE_FLAG_TILED.  Only the samplers know about the tiled layout,
+ * so this is limited to textures which are never rendered to, written by
+ * shaders or mapped directly.  Block sizes need to be powers of two to
+ * keep whole tiles within the cache line aligned rows.
+ */
+static bool
+llvmpipe_texture_can_tile(const struct llvmpipe_screen *screen,
+                          const struct pipe_resource *pt)
+{
+   if (!screen->tiled_textures)
+      return false;
+
+   if (pt->bind != PIPE_BIND_SAMPLER_VIEW ||
+       pt->usage == PIPE_USAGE_STAGING ||
+       (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                     PIPE_RESOURCE_FLAG_MAP_COHERENT |
+                     PIPE_RESOURCE_FLAG_SPARSE)))
+      return false;
+
+   if (pt->nr_samples > 1 || llvmpipe_resource_is_1d(pt))
+      return false;
+
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+   if (desc->layout == UTIL_FORMAT_LAYOUT_PLAIN) {
+      if (desc->block.width != 1 || desc->block.height != 1)
+         return false;
+   } else if (!util_format_is_compressed(pt->format)) {
+      return false;
+   }
+
+   const unsigned block_size = desc->block.bits / 8;
+   return block_size <= 16 && util_is_power_of_two_nonzero(block_size);
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -104,6 +144,13 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
    assert(LP_MAX_TEXTURE_2D_LEVELS <= LP_MAX_TEXTURE_LEVELS);
    assert(LP_MAX_TEXTURE_3D_LEVELS <= LP_MAX_TEXTURE_LEVELS);
 
+   /* Memory we don't allocate ourselves may be accessed directly. */
+   lpr->tiled = allocate && llvmpipe_texture_can_tile(screen, pt);
+   if (lpr->tiled)
+      pt->flags |= LP_RESOURCE_FLAG_TILED;
+   else
+      pt->flags &= ~LP_RESOURCE_FLAG_TILED;
+
    for (unsigned level = 0; level <= pt->last_level; level++) {
       uint64_t mipsize;
       unsigned align_x, align_y, nblocksx, nblocksy, block_size, num_slices;
@@ -118,7 +165,11 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
        * handle specially in render output code (as we need to do special
        * handling there for buffers in any case).
        */
-      if (util_format_is_compressed(pt->format)) {
+      if (lpr->tiled) {
+         /* Whole tiles only. */
+         align_x = LP_TEXTURE_TILE_SIZE * util_format_get_blockwidth(pt->format);
+         align_y = LP_TEXTURE_TILE_SIZE * util_format_get_blockheight(pt->format);
+      } else if (util_format_is_compressed(pt->format)) {
          align_x = align_y = 1;
       } else {
          align_x = LP_RASTER_BLOCK_SIZE;
@@ -682,6 +733,60 @@ fail:
 }
 
 
+/**
+ * Copy a box of a tiled texture to or from linear memory, see
+ * LP_RESOURCE_FLAG_TILED.
+ */
+static void
+llvmpipe_tiled_copy_box(struct llvmpipe_resource *lpr,
+                        unsigned level,
+                        const struct pipe_box *box,
+                        uint8_t *linear,
+                        unsigned linear_stride,
+                        uint64_t linear_layer_stride,
+                        bool to_tiled)
+{
+   const enum pipe_format format = lpr->base.format;
+   const unsigned block_size = util_format_get_blocksize(format);
+   const unsigned tile_row_size = LP_TEXTURE_TILE_SIZE * block_size;
+   const unsigned tile_mask = LP_TEXTURE_TILE_SIZE - 1;
+   const unsigned row_stride = lpr->row_stride[level];
+   const unsigned x0 = box->x / util_format_get_blockwidth(format);
+   const unsigned y0 = box->y / util_format_get_blockheight(format);
+   const unsigned nblocksx = util_format_get_nblocksx(format, box->width);
+   const unsigned nblocksy = util_format_get_nblocksy(format, box->height);
+
+   for (unsigned z = 0; z < box->depth; z++) {
+      uint8_t *image = llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                          level);
+      uint8_t *linear_image = linear + z * linear_layer_stride;
+
+      for (unsigned y = 0; y < nblocksy; y++) {
+         const unsigned ty = y0 + y;
+         uint8_t *tiled_row = image + (ty & ~tile_mask) * row_stride +
+                              (ty & tile_mask) * tile_row_size;
+         uint8_t *linear_row = linear_image + y * linear_stride;
+
+         /* Blocks are contiguous up to the end of each tile row. */
+         for (unsigned x = 0; x < nblocksx;) {
+            const unsigned tx = x0 + x;
+            const unsigned n = MIN2(LP_TEXTURE_TILE_SIZE - (tx & tile_mask),
+                                    nblocksx - x);
+            uint8_t *tiled_ptr = tiled_row +
+               ((tx & ~tile_mask) * LP_TEXTURE_TILE_SIZE + (tx & tile_mask)) *
+               block_size;
+
+            if (to_tiled)
+               memcpy(tiled_ptr, linear_row + x * block_size, n * block_size);
+            else
+               memcpy(linear_row + x * block_size, tiled_ptr, n * block_size);
+            x += n;
+         }
+      }
+   }
+}
+
+
 void *
 llvmpipe_transfer_map_ms(struct pipe_context *pipe,
                          struct pipe_resource *resource,
@@ -702,6 +807,10 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   /* Tiled textures only get a linear copy. */
+   if (lpr->tiled && (usage & PIPE_MAP_DIRECTLY))
+      return NULL;
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush
     * the context if necessary.
@@ -786,6 +895,28 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
       screen->timestamp++;
    }
 
+   if (lpr->tiled) {
+      /* Hand out a linear copy of the box, written back on unmap. */
+      pt->stride = util_format_get_stride(format, box->width);
+      pt->layer_stride = util_format_get_2d_size(format, pt->stride,
+                                                 box->height);
+      lpt->staging = MALLOC(pt->layer_stride * box->depth);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_MAP_DISCARD_RANGE |
+                     PIPE_MAP_DISCARD_WHOLE_RESOURCE)) ||
+          (usage & PIPE_MAP_FLUSH_EXPLICIT)) {
+         llvmpipe_tiled_copy_box(lpr, level, box, lpt->staging,
+                                 pt->stride, pt->layer_stride, false);
+      }
+      return lpt->staging;
+   }
+
    map +=
       box->y / util_format_get_blockheight(format) * pt->stride +
       box->x / util_format_get_blockwidth(format) * util_format_get_blocksize(format);
@@ -812,16 +943,27 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   /* Effectively do the texture_update work here: tiled textures get the
+    * linear copy put back into their layout.
+    */
+   if (lpt->staging) {
+      if (transfer->usage & PIPE_MAP_WRITE) {
+         llvmpipe_tiled_copy_box(llvmpipe_resource(transfer->resource),
+                                 transfer->level, &transfer->box,
+                                 lpt->staging, transfer->stride,
+                                 transfer->layer_stride, true);
+      }
+      FREE(lpt->staging);
+   }
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
 
-   /* Effectively do the texture_update work here - if texture images
-    * needed post-processing to put them into hardware layout, this is
-    * where it would happen.  For llvmpipe, nothing to do.
-    */
    assert (transfer->resource);
    pipe_resource_reference(&transfer->resource, NULL);
    FREE(transfer);
@@ -834,6 +976,11 @@ llvmpipe_is_resource_referenced(struct pipe_context *pipe,
                                 unsigned level)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   /* Global buffers can have any binding. */
+   if (llvmpipe_compute_references_resource(llvmpipe, presource))
+      return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+
    if (!(presource->bind & (PIPE_BIND_DEPTH_STENCIL |
                             PIPE_BIND_RENDER_TARGET |
                             PIPE_BIND_SAMPLER_VIEW |
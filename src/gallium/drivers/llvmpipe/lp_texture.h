@@ -103,6 +103,7 @@ struct llvmpipe_resource
    uint64_t backing_offset;
    bool backable;
    bool imported_memory;
+   bool tiled;  /**< see LP_RESOURCE_FLAG_TILED */
 #ifdef DEBUG
    struct list_head list;
 #endif
@@ -112,6 +113,9 @@ struct llvmpipe_resource
 struct llvmpipe_transfer
 {
    struct pipe_transfer base;
+
+   /** Linear copy of the box, for tiled textures */
+   uint8_t *staging;
 };
 
 
@@ -0,0 +1,979 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "lvp_private.h"
+#include "lvp_acceleration_structure.h"
+
+#include "util/format/u_format.h"
+#include "util/u_atomic.h"
+#include "util/u_math.h"
+#include "vk_acceleration_structure.h"
+
+/*
+ * CPU BVH builder.
+ *
+ * Every primitive gets its own leaf node.  The tree is built top down with
+ * binned SAH splits into a temporary node array in the scratch buffer, two
+ * levels of binary splits per 4-wide box node.  Once the top levels are
+ * split, the subtrees below them are built in parallel on the device's
+ * build queue.  Finally, the tree is written out depth first into the
+ * acceleration structure, leaves first and boxes after them, which is what
+ * makes the result compact.
+ */
+
+#define LVP_BVH_SAH_BINS 16
+
+/* Split levels after which subtrees go to the build queue, and how large
+ * they need to be for that to be worth it.
+ */
+#define LVP_BVH_PARALLEL_DEPTH 2
+#define LVP_BVH_PARALLEL_MIN_PRIMS 4096
+#define LVP_BVH_MAX_JOBS (LVP_BVH_BOX_WIDTH * LVP_BVH_BOX_WIDTH)
+
+/* Child references in the temporary tree: a leaf is a primitive index. */
+#define LVP_BVH_BUILD_LEAF (1u << 31)
+
+struct lvp_aabb {
+   float min[3];
+   float max[3];
+};
+
+struct lvp_bvh_prim {
+   struct lvp_aabb bounds;
+   uint32_t geometry_index;
+   uint32_t primitive_index;
+};
+
+struct lvp_bvh_build_node {
+   struct lvp_aabb bounds[LVP_BVH_BOX_WIDTH];
+   uint32_t children[LVP_BVH_BOX_WIDTH];
+};
+
+struct lvp_bvh_builder;
+
+struct lvp_bvh_job {
+   struct util_queue_fence fence;
+   struct lvp_bvh_builder *builder;
+   uint32_t begin, end;
+   unsigned depth;
+   uint32_t *child;
+};
+
+struct lvp_bvh_builder {
+   const VkAccelerationStructureBuildGeometryInfoKHR *info;
+   const VkAccelerationStructureBuildRangeInfoKHR *ranges;
+   bool host;
+
+   struct lvp_bvh_prim *prims;
+   uint32_t prim_count;
+
+   struct lvp_bvh_build_node *nodes;
+   uint32_t node_count;
+
+   struct util_queue *queue;
+   struct lvp_bvh_job jobs[LVP_BVH_MAX_JOBS];
+   unsigned job_count;
+
+   /* output */
+   uint8_t *base;
+   struct lvp_bvh_header *header;
+   uint32_t leaf_size;
+};
+
+static void
+aabb_init(struct lvp_aabb *aabb)
+{
+   for (unsigned i = 0; i < 3; i++) {
+      aabb->min[i] = INFINITY;
+      aabb->max[i] = -INFINITY;
+   }
+}
+
+static void
+aabb_extend(struct lvp_aabb *aabb, const struct lvp_aabb *other)
+{
+   for (unsigned i = 0; i < 3; i++) {
+      aabb->min[i] = MIN2(aabb->min[i], other->min[i]);
+      aabb->max[i] = MAX2(aabb->max[i], other->max[i]);
+   }
+}
+
+static void
+aabb_extend_point(struct lvp_aabb *aabb, const float p[3])
+{
+   for (unsigned i = 0; i < 3; i++) {
+      aabb->min[i] = MIN2(aabb->min[i], p[i]);
+      aabb->max[i] = MAX2(aabb->max[i], p[i]);
+   }
+}
+
+static float
+aabb_half_area(const struct lvp_aabb *aabb)
+{
+   float d[3];
+   for (unsigned i = 0; i < 3; i++) {
+      d[i] = aabb->max[i] - aabb->min[i];
+      if (!(d[i] >= 0.0f))
+         return 0.0f;
+   }
+   return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+static inline float
+prim_centroid(const struct lvp_bvh_prim *prim, unsigned axis)
+{
+   return (prim->bounds.min[axis] + prim->bounds.max[axis]) * 0.5f;
+}
+
+static inline void
+prim_swap(struct lvp_bvh_prim *prims, uint32_t a, uint32_t b)
+{
+   struct lvp_bvh_prim tmp = prims[a];
+   prims[a] = prims[b];
+   prims[b] = tmp;
+}
+
+static const VkAccelerationStructureGeometryKHR *
+get_geometry(const VkAccelerationStructureBuildGeometryInfoKHR *info, uint32_t index)
+{
+   return info->pGeometries ? &info->pGeometries[index] : info->ppGeometries[index];
+}
+
+static VkGeometryTypeKHR
+get_geometry_type(const VkAccelerationStructureBuildGeometryInfoKHR *info)
+{
+   if (info->type == VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR)
+      return VK_GEOMETRY_TYPE_INSTANCES_KHR;
+   if (info->geometryCount)
+      return get_geometry(info, 0)->geometryType;
+   return VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+}
+
+static uint32_t
+leaf_node_type(VkGeometryTypeKHR type)
+{
+   switch (type) {
+   case VK_GEOMETRY_TYPE_TRIANGLES_KHR:
+      return LVP_BVH_NODE_TRIANGLE;
+   case VK_GEOMETRY_TYPE_AABBS_KHR:
+      return LVP_BVH_NODE_AABB;
+   case VK_GEOMETRY_TYPE_INSTANCES_KHR:
+      return LVP_BVH_NODE_INSTANCE;
+   default:
+      unreachable("invalid geometry type");
+   }
+}
+
+static uint32_t
+leaf_node_size(VkGeometryTypeKHR type)
+{
+   switch (type) {
+   case VK_GEOMETRY_TYPE_TRIANGLES_KHR:
+      return sizeof(struct lvp_bvh_triangle_node);
+   case VK_GEOMETRY_TYPE_AABBS_KHR:
+      return sizeof(struct lvp_bvh_aabb_node);
+   case VK_GEOMETRY_TYPE_INSTANCES_KHR:
+      return sizeof(struct lvp_bvh_instance_node);
+   default:
+      unreachable("invalid geometry type");
+   }
+}
+
+static uint64_t
+bvh_size(VkGeometryTypeKHR type, uint64_t leaf_count)
+{
+   uint64_t box_count = leaf_count > 1 ? leaf_count - 1 : 0;
+   return sizeof(struct lvp_bvh_header) + leaf_count * leaf_node_size(type) +
+          box_count * sizeof(struct lvp_bvh_box_node);
+}
+
+static uint64_t
+scratch_size(uint64_t leaf_count)
+{
+   uint64_t node_count = leaf_count > 1 ? leaf_count - 1 : 0;
+   return MAX2(leaf_count * sizeof(struct lvp_bvh_prim) +
+               node_count * sizeof(struct lvp_bvh_build_node), 64);
+}
+
+static void *
+get_address(VkDeviceAddress address, uint64_t offset)
+{
+   return (uint8_t *)(uintptr_t)address + offset;
+}
+
+static bool
+fetch_triangle(const VkAccelerationStructureGeometryTrianglesDataKHR *tri,
+               const VkAccelerationStructureBuildRangeInfoKHR *range,
+               uint32_t primitive, float v[3][3])
+{
+   const uint8_t *vertices = get_address(tri->vertexData.deviceAddress, 0);
+   const uint8_t *indices = get_address(tri->indexData.deviceAddress, range->primitiveOffset);
+   enum pipe_format format = lvp_vk_format_to_pipe_format(tri->vertexFormat);
+
+   if (tri->indexType == VK_INDEX_TYPE_NONE_KHR)
+      vertices += range->primitiveOffset;
+
+   for (unsigned k = 0; k < 3; k++) {
+      uint32_t index = primitive * 3 + k;
+
+      switch (tri->indexType) {
+      case VK_INDEX_TYPE_UINT8_EXT:
+         index = indices[index];
+         break;
+      case VK_INDEX_TYPE_UINT16:
+         index = ((const uint16_t *)indices)[index];
+         break;
+      case VK_INDEX_TYPE_UINT32:
+         index = ((const uint32_t *)indices)[index];
+         break;
+      default:
+         break;
+      }
+
+      const uint8_t *src = vertices + (uint64_t)(range->firstVertex + index) * tri->vertexStride;
+      if (tri->vertexFormat == VK_FORMAT_R32G32B32_SFLOAT) {
+         memcpy(v[k], src, sizeof(v[k]));
+      } else {
+         float rgba[4];
+         util_format_unpack_rgba(format, rgba, src, 1);
+         memcpy(v[k], rgba, sizeof(v[k]));
+      }
+
+      /* A NaN X component makes the triangle inactive. */
+      if (isnan(v[k][0]))
+         return false;
+   }
+
+   if (tri->transformData.deviceAddress) {
+      const VkTransformMatrixKHR *transform =
+         get_address(tri->transformData.deviceAddress, range->transformOffset);
+
+      for (unsigned k = 0; k < 3; k++) {
+         float p[3];
+         for (unsigned r = 0; r < 3; r++) {
+            p[r] = transform->matrix[r][0] * v[k][0] + transform->matrix[r][1] * v[k][1] +
+                   transform->matrix[r][2] * v[k][2] + transform->matrix[r][3];
+         }
+         memcpy(v[k], p, sizeof(p));
+      }
+   }
+
+   return true;
+}
+
+static const VkAabbPositionsKHR *
+fetch_aabb(const VkAccelerationStructureGeometryAabbsDataKHR *aabbs,
+           const VkAccelerationStructureBuildRangeInfoKHR *range,
+           uint32_t primitive)
+{
+   return get_address(aabbs->data.deviceAddress,
+                      range->primitiveOffset + (uint64_t)primitive * aabbs->stride);
+}
+
+static const VkAccelerationStructureInstanceKHR *
+fetch_instance(const VkAccelerationStructureGeometryInstancesDataKHR *instances,
+               const VkAccelerationStructureBuildRangeInfoKHR *range,
+               uint32_t primitive)
+{
+   const uint8_t *data = get_address(instances->data.deviceAddress, range->primitiveOffset);
+
+   if (instances->arrayOfPointers)
+      return (const void *)(uintptr_t)((const uint64_t *)data)[primitive];
+
+   return (const void *)(data + (uint64_t)primitive * sizeof(VkAccelerationStructureInstanceKHR));
+}
+
+/* Instances reference acceleration structures by device address, except in
+ * host builds where they are handles.
+ */
+static const struct lvp_bvh_header *
+instance_bvh(const VkAccelerationStructureInstanceKHR *instance, bool host)
+{
+   uint64_t reference = instance->accelerationStructureReference;
+
+   if (!reference)
+      return NULL;
+
+   if (host) {
+      VK_FROM_HANDLE(vk_acceleration_structure, accel_struct,
+                     (VkAccelerationStructureKHR)(uintptr_t)reference);
+      reference = vk_acceleration_structure_get_va(accel_struct);
+   }
+
+   return (const struct lvp_bvh_header *)(uintptr_t)reference;
+}
+
+static bool
+instance_bounds(const VkAccelerationStructureInstanceKHR *instance, bool host,
+                struct lvp_aabb *bounds)
+{
+   const struct lvp_bvh_header *bvh = instance_bvh(instance, host);
+
+   if (!bvh || bvh->root == LVP_BVH_INVALID_NODE)
+      return false;
+
+   aabb_init(bounds);
+   for (unsigned c = 0; c < 8; c++) {
+      float corner[3] = {
+         (c & 1) ? bvh->max[0] : bvh->min[0],
+         (c & 2) ? bvh->max[1] : bvh->min[1],
+         (c & 4) ? bvh->max[2] : bvh->min[2],
+      };
+      float p[3];
+      for (unsigned r = 0; r < 3; r++) {
+         p[r] = instance->transform.matrix[r][0] * corner[0] +
+                instance->transform.matrix[r][1] * corner[1] +
+                instance->transform.matrix[r][2] * corner[2] +
+                instance->transform.matrix[r][3];
+      }
+      aabb_extend_point(bounds, p);
+   }
+
+   return true;
+}
+
+static void
+gather_prims(struct lvp_bvh_builder *b)
+{
+   const VkAccelerationStructureBuildGeometryInfoKHR *info = b->info;
+
+   b->prim_count = 0;
+   for (uint32_t g = 0; g < info->geometryCount; g++) {
+      const VkAccelerationStructureGeometryKHR *geom = get_geometry(info, g);
+      const VkAccelerationStructureBuildRangeInfoKHR *range = &b->ranges[g];
+
+      for (uint32_t i = 0; i < range->primitiveCount; i++) {
+         struct lvp_bvh_prim *prim = &b->prims[b->prim_count];
+
+         switch (geom->geometryType) {
+         case VK_GEOMETRY_TYPE_TRIANGLES_KHR: {
+            float v[3][3];
+            if (!fetch_triangle(&geom->geometry.triangles, range, i, v))
+               continue;
+            aabb_init(&prim->bounds);
+            for (unsigned k = 0; k < 3; k++)
+               aabb_extend_point(&prim->bounds, v[k]);
+            break;
+         }
+         case VK_GEOMETRY_TYPE_AABBS_KHR: {
+            const VkAabbPositionsKHR *aabb = fetch_aabb(&geom->geometry.aabbs, range, i);
+            /* A NaN minimum X makes the AABB inactive. */
+            if (isnan(aabb->minX))
+               continue;
+            prim->bounds = (struct lvp_aabb) {
+               .min = { aabb->minX, aabb->minY, aabb->minZ },
+               .max = { aabb->maxX, aabb->maxY, aabb->maxZ },
+            };
+            break;
+         }
+         case VK_GEOMETRY_TYPE_INSTANCES_KHR: {
+            const VkAccelerationStructureInstanceKHR *instance =
+               fetch_instance(&geom->geometry.instances, range, i);
+            if (!instance_bounds(instance, b->host, &prim->bounds))
+               continue;
+            break;
+         }
+         default:
+            unreachable("invalid geometry type");
+         }
+
+         prim->geometry_index = g;
+         prim->primitive_index = i;
+         b->prim_count++;
+      }
+   }
+}
+
+static unsigned
+prim_bin(const struct lvp_bvh_prim *prim, unsigned axis, float min, float scale)
+{
+   float bin = (prim_centroid(prim, axis) - min) * scale;
+   return MIN2((unsigned)MAX2(bin, 0.0f), LVP_BVH_SAH_BINS - 1);
+}
+
+/* Moves the nth smallest centroid along axis to nth, with smaller ones
+ * before it and larger ones after it.
+ */
+static void
+select_nth(struct lvp_bvh_prim *prims, uint32_t begin, uint32_t end,
+           uint32_t nth, unsigned axis)
+{
+   while (end - begin > 1) {
+      float pivot = prim_centroid(&prims[begin + (end - begin) / 2], axis);
+      uint32_t lt = begin, i = begin, gt = end;
+
+      while (i < gt) {
+         float c = prim_centroid(&prims[i], axis);
+         if (c < pivot)
+            prim_swap(prims, lt++, i++);
+         else if (c > pivot)
+            prim_swap(prims, i, --gt);
+         else
+            i++;
+      }
+
+      if (nth < lt)
+         end = lt;
+      else if (nth >= gt)
+         begin = gt;
+      else
+         return;
+   }
+}
+
+/* Splits prims[begin, end) in two and returns where the second half starts,
+ * using binned SAH unless a median split is asked for.
+ */
+static uint32_t
+split_range(struct lvp_bvh_prim *prims, uint32_t begin, uint32_t end, bool median)
+{
+   uint32_t count = end - begin;
+   struct lvp_aabb centroids;
+
+   aabb_init(&centroids);
+   for (uint32_t i = begin; i < end; i++) {
+      float c[3] = {
+         prim_centroid(&prims[i], 0),
+         prim_centroid(&prims[i], 1),
+         prim_centroid(&prims[i], 2),
+      };
+      aabb_extend_point(&centroids, c);
+   }
+
+   unsigned axis = 0;
+   float extent[3];
+   for (unsigned a = 0; a < 3; a++) {
+      extent[a] = centroids.max[a] - centroids.min[a];
+      if (extent[a] > extent[axis])
+         axis = a;
+   }
+
+   /* All centroids in one spot, any split is as good as any other. */
+   if (!(extent[axis] > 0.0f))
+      return begin + count / 2;
+
+   if (!median && count > 2) {
+      float best_cost = INFINITY;
+      unsigned best_axis = 0, best_bin = 0;
+
+      for (unsigned a = 0; a < 3; a++) {
+         if (!(extent[a] > 0.0f))
+            continue;
+
+         struct lvp_aabb bin_bounds[LVP_BVH_SAH_BINS];
+         uint32_t bin_count[LVP_BVH_SAH_BINS] = {0};
+         float scale = LVP_BVH_SAH_BINS / extent[a];
+
+         for (unsigned i = 0; i < LVP_BVH_SAH_BINS; i++)
+            aabb_init(&bin_bounds[i]);
+
+         for (uint32_t i = begin; i < end; i++) {
+            unsigned bin = prim_bin(&prims[i], a, centroids.min[a], scale);
+            aabb_extend(&bin_bounds[bin], &prims[i].bounds);
+            bin_count[bin]++;
+         }
+
+         /* right_area[i] is the area of bins [i, LVP_BVH_SAH_BINS) */
+         float right_area[LVP_BVH_SAH_BINS];
+         struct lvp_aabb acc;
+         aabb_init(&acc);
+         for (unsigned i = LVP_BVH_SAH_BINS - 1; i > 0; i--) {
+            aabb_extend(&acc, &bin_bounds[i]);
+            right_area[i] = aabb_half_area(&acc);
+         }
+
+         uint32_t left_count = 0;
+         aabb_init(&acc);
+         for (unsigned i = 1; i < LVP_BVH_SAH_BINS; i++) {
+            aabb_extend(&acc, &bin_bounds[i - 1]);
+            left_count += bin_count[i - 1];
+
+            if (!left_count || left_count == count)
+               continue;
+
+            float cost = aabb_half_area(&acc) * left_count +
+                         right_area[i] * (count - left_count);
+            if (cost < best_cost) {
+               best_cost = cost;
+               best_axis = a;
+               best_bin = i;
+            }
+         }
+      }
+
+      if (best_cost < INFINITY) {
+         float scale = LVP_BVH_SAH_BINS / extent[best_axis];
+         uint32_t i = begin, j = end;
+
+         while (i < j) {
+            if (prim_bin(&prims[i], best_axis, centroids.min[best_axis], scale) < best_bin)
+               i++;
+            else
+               prim_swap(prims, i, --j);
+         }
+
+         if (i != begin && i != end)
+            return i;
+      }
+   }
+
+   uint32_t mid = begin + count / 2;
+   select_nth(prims, begin, end, mid, axis);
+   return mid;
+}
+
+static unsigned
+ceil_log4(uint32_t n)
+{
+   return (util_logbase2_ceil(n) + 1) / 2;
+}
+
+/* Splits prims[begin, end) into up to LVP_BVH_BOX_WIDTH groups for the
+ * children of a box node at the given depth, returning the group count and
+ * their boundaries in split[].
+ */
+static unsigned
+split_node(struct lvp_bvh_prim *prims, uint32_t begin, uint32_t end,
+           unsigned depth, uint32_t split[LVP_BVH_BOX_WIDTH + 1])
+{
+   uint32_t count = end - begin;
+
+   if (count <= LVP_BVH_BOX_WIDTH) {
+      for (uint32_t i = 0; i <= count; i++)
+         split[i] = begin + i;
+      return count;
+   }
+
+   /* Median splits need ceil_log4(count) more levels, fall back to them
+    * once an unbalanced SAH split could exceed LVP_BVH_MAX_DEPTH.
+    */
+   bool median = depth + 1 + ceil_log4(count) > LVP_BVH_MAX_DEPTH;
+
+   uint32_t mid = split_range(prims, begin, end, median);
+   unsigned groups = 0;
+
+   split[groups++] = begin;
+   if (mid - begin > 1)
+      split[groups++] = split_range(prims, begin, mid, median);
+   split[groups++] = mid;
+   if (end - mid > 1)
+      split[groups++] = split_range(prims, mid, end, median);
+   split[groups] = end;
+
+   return groups;
+}
+
+static uint32_t
+build_subtree(struct lvp_bvh_builder *b, uint32_t begin, uint32_t end, unsigned depth);
+
+static void
+build_subtree_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_bvh_job *job = data;
+   *job->child = build_subtree(job->builder, job->begin, job->end, job->depth);
+}
+
+/* Builds the tree for prims[begin, end) with its root at the given depth,
+ * returning the reference to its root.
+ */
+static uint32_t
+build_subtree(struct lvp_bvh_builder *b, uint32_t begin, uint32_t end, unsigned depth)
+{
+   if (end - begin == 1)
+      return LVP_BVH_BUILD_LEAF | begin;
+
+   uint32_t index = p_atomic_inc_return(&b->node_count) - 1;
+   struct lvp_bvh_build_node *node = &b->nodes[index];
+
+   uint32_t split[LVP_BVH_BOX_WIDTH + 1];
+   unsigned groups = split_node(b->prims, begin, end, depth, split);
+
+   for (unsigned i = 0; i < LVP_BVH_BOX_WIDTH; i++) {
+      aabb_init(&node->bounds[i]);
+      node->children[i] = LVP_BVH_INVALID_NODE;
+      if (i >= groups)
+         continue;
+
+      for (uint32_t p = split[i]; p < split[i + 1]; p++)
+         aabb_extend(&node->bounds[i], &b->prims[p].bounds);
+
+      /* Only the top levels are built on this thread, so job_count is
+       * not raced on.
+       */
+      if (depth == LVP_BVH_PARALLEL_DEPTH && b->queue &&
+          split[i + 1] - split[i] >= LVP_BVH_PARALLEL_MIN_PRIMS &&
+          b->job_count < LVP_BVH_MAX_JOBS) {
+         struct lvp_bvh_job *job = &b->jobs[b->job_count++];
+         job->builder = b;
+         job->begin = split[i];
+         job->end = split[i + 1];
+         job->depth = depth + 1;
+         job->child = &node->children[i];
+         util_queue_fence_init(&job->fence);
+         util_queue_add_job(b->queue, job, &job->fence, build_subtree_job, NULL, 0);
+      } else {
+         node->children[i] = build_subtree(b, split[i], split[i + 1], depth + 1);
+      }
+   }
+
+   return index;
+}
+
+static uint32_t
+emit_leaf(struct lvp_bvh_builder *b, const struct lvp_bvh_prim *prim)
+{
+   struct lvp_bvh_header *header = b->header;
+   uint32_t offset = header->leaf_offset + header->leaf_count++ * b->leaf_size;
+   void *dst = b->base + offset;
+
+   const VkAccelerationStructureGeometryKHR *geom = get_geometry(b->info, prim->geometry_index);
+   const VkAccelerationStructureBuildRangeInfoKHR *range = &b->ranges[prim->geometry_index];
+   uint32_t geometry_id_and_flags = prim->geometry_index;
+   if (geom->flags & VK_GEOMETRY_OPAQUE_BIT_KHR)
+      geometry_id_and_flags |= LVP_GEOMETRY_OPAQUE;
+
+   switch (geom->geometryType) {
+   case VK_GEOMETRY_TYPE_TRIANGLES_KHR: {
+      struct lvp_bvh_triangle_node *node = dst;
+      fetch_triangle(&geom->geometry.triangles, range, prim->primitive_index, node->coords);
+      node->primitive_id = prim->primitive_index;
+      node->geometry_id_and_flags = geometry_id_and_flags;
+      node->reserved = 0;
+      return offset | LVP_BVH_NODE_TRIANGLE;
+   }
+   case VK_GEOMETRY_TYPE_AABBS_KHR: {
+      struct lvp_bvh_aabb_node *node = dst;
+      memcpy(node->min, prim->bounds.min, sizeof(node->min));
+      memcpy(node->max, prim->bounds.max, sizeof(node->max));
+      node->primitive_id = prim->primitive_index;
+      node->geometry_id_and_flags = geometry_id_and_flags;
+      return offset | LVP_BVH_NODE_AABB;
+   }
+   case VK_GEOMETRY_TYPE_INSTANCES_KHR: {
+      struct lvp_bvh_instance_node *node = dst;
+      const VkAccelerationStructureInstanceKHR *instance =
+         fetch_instance(&geom->geometry.instances, range, prim->primitive_index);
+
+      float otw[16] = {0}, wto[16];
+      memcpy(otw, instance->transform.matrix, sizeof(instance->transform.matrix));
+      otw[15] = 1.0f;
+      if (!util_invert_mat4x4(wto, otw))
+         memset(wto, 0, sizeof(wto));
+
+      node->bvh_ptr = (uintptr_t)instance_bvh(instance, b->host);
+      node->custom_instance_and_mask = instance->instanceCustomIndex | (instance->mask << 24);
+      node->sbt_offset_and_flags = instance->instanceShaderBindingTableRecordOffset |
+                                   (instance->flags << 24);
+      memcpy(node->wto_matrix, wto, sizeof(node->wto_matrix));
+      memcpy(node->otw_matrix, otw, sizeof(node->otw_matrix));
+      node->instance_id = prim->primitive_index;
+      memset(node->reserved, 0, sizeof(node->reserved));
+      return offset | LVP_BVH_NODE_INSTANCE;
+   }
+   default:
+      unreachable("invalid geometry type");
+   }
+}
+
+static uint32_t
+emit_node(struct lvp_bvh_builder *b, uint32_t child)
+{
+   if (child & LVP_BVH_BUILD_LEAF)
+      return emit_leaf(b, &b->prims[child & ~LVP_BVH_BUILD_LEAF]);
+
+   const struct lvp_bvh_build_node *node = &b->nodes[child];
+   uint32_t offset = b->header->box_offset +
+                     b->header->box_count++ * sizeof(struct lvp_bvh_box_node);
+   struct lvp_bvh_box_node *box = (void *)(b->base + offset);
+
+   for (unsigned i = 0; i < LVP_BVH_BOX_WIDTH; i++) {
+      box->min_x[i] = node->bounds[i].min[0];
+      box->min_y[i] = node->bounds[i].min[1];
+      box->min_z[i] = node->bounds[i].min[2];
+      box->max_x[i] = node->bounds[i].max[0];
+      box->max_y[i] = node->bounds[i].max[1];
+      box->max_z[i] = node->bounds[i].max[2];
+   }
+
+   /* Children after the box itself, so boxes end up in depth first order. */
+   for (unsigned i = 0; i < LVP_BVH_BOX_WIDTH; i++) {
+      box->children[i] = node->children[i] == LVP_BVH_INVALID_NODE ?
+                         LVP_BVH_INVALID_NODE : emit_node(b, node->children[i]);
+   }
+
+   return offset | LVP_BVH_NODE_BOX;
+}
+
+static void
+build_bvh(struct lvp_device *device,
+          const VkAccelerationStructureBuildGeometryInfoKHR *info,
+          const VkAccelerationStructureBuildRangeInfoKHR *ranges,
+          bool host)
+{
+   VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, info->dstAccelerationStructure);
+   VkGeometryTypeKHR geometry_type = get_geometry_type(info);
+   uint64_t max_prims = 0;
+
+   for (uint32_t g = 0; g < info->geometryCount; g++)
+      max_prims += ranges[g].primitiveCount;
+
+   struct lvp_bvh_builder *b = calloc(1, sizeof(*b));
+   if (!b)
+      return;
+
+   b->info = info;
+   b->ranges = ranges;
+   b->host = host;
+   b->prims = get_address(info->scratchData.deviceAddress, 0);
+   b->nodes = (void *)(b->prims + max_prims);
+   b->base = get_address(vk_acceleration_structure_get_va(accel_struct), 0);
+   b->header = (void *)b->base;
+   b->leaf_size = leaf_node_size(geometry_type);
+   if (util_queue_is_initialized(&device->worker_queue))
+      b->queue = &device->worker_queue;
+
+   gather_prims(b);
+
+   uint32_t root = LVP_BVH_INVALID_NODE;
+   if (b->prim_count)
+      root = build_subtree(b, 0, b->prim_count, 1);
+
+   for (unsigned i = 0; i < b->job_count; i++) {
+      util_queue_fence_wait(&b->jobs[i].fence);
+      util_queue_fence_destroy(&b->jobs[i].fence);
+   }
+
+   struct lvp_bvh_header *header = b->header;
+   memset(header, 0, sizeof(*header));
+   header->leaf_type = leaf_node_type(geometry_type);
+   header->leaf_offset = sizeof(struct lvp_bvh_header);
+   header->box_offset = header->leaf_offset + b->prim_count * b->leaf_size;
+
+   struct lvp_aabb bounds;
+   aabb_init(&bounds);
+   for (uint32_t i = 0; i < b->prim_count; i++)
+      aabb_extend(&bounds, &b->prims[i].bounds);
+   memcpy(header->min, bounds.min, sizeof(header->min));
+   memcpy(header->max, bounds.max, sizeof(header->max));
+
+   header->root = root == LVP_BVH_INVALID_NODE ? root : emit_node(b, root);
+   assert(header->leaf_count == b->prim_count);
+
+   header->size = header->box_offset +
+                  (uint64_t)header->box_count * sizeof(struct lvp_bvh_box_node);
+   if (geometry_type == VK_GEOMETRY_TYPE_INSTANCES_KHR)
+      header->instance_count = header->leaf_count;
+
+   free(b);
+}
+
+void
+lvp_build_acceleration_structures(struct lvp_device *device, uint32_t info_count,
+                                  const VkAccelerationStructureBuildGeometryInfoKHR *infos,
+                                  const VkAccelerationStructureBuildRangeInfoKHR *const *ranges,
+                                  bool host)
+{
+   for (uint32_t i = 0; i < info_count; i++)
+      build_bvh(device, &infos[i], ranges[i], host);
+}
+
+static uint64_t
+serialized_header_size(const struct lvp_bvh_header *header)
+{
+   return 2 * VK_UUID_SIZE + 3 * sizeof(uint64_t) + header->instance_count * sizeof(uint64_t);
+}
+
+uint64_t
+lvp_acceleration_structure_query(VkAccelerationStructureKHR _accel_struct, VkQueryType type)
+{
+   VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, _accel_struct);
+   const struct lvp_bvh_header *header =
+      get_address(vk_acceleration_structure_get_va(accel_struct), 0);
+
+   switch (type) {
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR:
+      return header->size;
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR:
+      return serialized_header_size(header) + header->size;
+   default:
+      unreachable("invalid acceleration structure query");
+   }
+}
+
+void
+lvp_copy_acceleration_structure(const VkCopyAccelerationStructureInfoKHR *info)
+{
+   VK_FROM_HANDLE(vk_acceleration_structure, src, info->src);
+   VK_FROM_HANDLE(vk_acceleration_structure, dst, info->dst);
+   const struct lvp_bvh_header *header = get_address(vk_acceleration_structure_get_va(src), 0);
+
+   /* Nodes are addressed relative to the header, so clones and compacted
+    * copies are the same thing.
+    */
+   memcpy(get_address(vk_acceleration_structure_get_va(dst), 0), header, header->size);
+}
+
+static void
+get_serialization_uuids(struct lvp_device *device, uint8_t driver_uuid[VK_UUID_SIZE],
+                        uint8_t compat_uuid[VK_UUID_SIZE])
+{
+   const struct vk_properties *props = &device->physical_device->vk.properties;
+   memcpy(driver_uuid, props->driverUUID, VK_UUID_SIZE);
+   memcpy(compat_uuid, props->pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+/* The serialized form is the header the spec asks for, followed by the
+ * acceleration structure itself.  Host copies pass a host pointer for the
+ * memory side.
+ */
+void
+lvp_copy_acceleration_structure_to_memory(struct lvp_device *device,
+                                          const VkCopyAccelerationStructureToMemoryInfoKHR *info,
+                                          bool host)
+{
+   VK_FROM_HANDLE(vk_acceleration_structure, src, info->src);
+   const struct lvp_bvh_header *header = get_address(vk_acceleration_structure_get_va(src), 0);
+   uint8_t *dst = host ? info->dst.hostAddress : get_address(info->dst.deviceAddress, 0);
+
+   get_serialization_uuids(device, dst, dst + VK_UUID_SIZE);
+
+   uint64_t *sizes = (uint64_t *)(dst + 2 * VK_UUID_SIZE);
+   sizes[0] = serialized_header_size(header) + header->size;
+   sizes[1] = header->size;
+   sizes[2] = header->instance_count;
+
+   uint64_t *handles = &sizes[3];
+   const struct lvp_bvh_instance_node *instances =
+      (const void *)((const uint8_t *)header + header->leaf_offset);
+   for (uint64_t i = 0; i < header->instance_count; i++)
+      handles[i] = instances[i].bvh_ptr;
+
+   memcpy(dst + serialized_header_size(header), header, header->size);
+}
+
+void
+lvp_copy_memory_to_acceleration_structure(struct lvp_device *device,
+                                          const VkCopyMemoryToAccelerationStructureInfoKHR *info,
+                                          bool host)
+{
+   VK_FROM_HANDLE(vk_acceleration_structure, dst, info->dst);
+   const uint8_t *src = host ? info->src.hostAddress : get_address(info->src.deviceAddress, 0);
+   const uint64_t *sizes = (const uint64_t *)(src + 2 * VK_UUID_SIZE);
+   const uint64_t *handles = &sizes[3];
+   struct lvp_bvh_header *header = get_address(vk_acceleration_structure_get_va(dst), 0);
+
+   memcpy(header, src + 2 * VK_UUID_SIZE + 3 * sizeof(uint64_t) + sizes[2] * sizeof(uint64_t),
+          sizes[1]);
+
+   /* The application may have pointed the instances at other copies of the
+    * bottom level structures.
+    */
+   struct lvp_bvh_instance_node *instances =
+      (void *)((uint8_t *)header + header->leaf_offset);
+   for (uint64_t i = 0; i < header->instance_count; i++)
+      instances[i].bvh_ptr = handles[i];
+}
+
+VKAPI_ATTR void VKAPI_CALL
+lvp_GetAccelerationStructureBuildSizesKHR(
+   VkDevice                                    _device,
+   VkAccelerationStructureBuildTypeKHR         buildType,
+   const VkAccelerationStructureBuildGeometryInfoKHR* pBuildInfo,
+   const uint32_t*                             pMaxPrimitiveCounts,
+   VkAccelerationStructureBuildSizesInfoKHR*   pSizeInfo)
+{
+   uint64_t leaf_count = 0;
+
+   for (uint32_t i = 0; i < pBuildInfo->geometryCount; i++)
+      leaf_count += pMaxPrimitiveCounts[i];
+
+   pSizeInfo->accelerationStructureSize = bvh_size(get_geometry_type(pBuildInfo), leaf_count);
+   pSizeInfo->buildScratchSize = scratch_size(leaf_count);
+   pSizeInfo->updateScratchSize = scratch_size(leaf_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+lvp_GetDeviceAccelerationStructureCompatibilityKHR(
+   VkDevice                                    _device,
+   const VkAccelerationStructureVersionInfoKHR* pVersionInfo,
+   VkAccelerationStructureCompatibilityKHR*    pCompatibility)
+{
+   LVP_FROM_HANDLE(lvp_device, device, _device);
+   uint8_t driver_uuid[VK_UUID_SIZE], compat_uuid[VK_UUID_SIZE];
+
+   get_serialization_uuids(device, driver_uuid, compat_uuid);
+
+   bool compatible =
+      !memcmp(pVersionInfo->pVersionData, driver_uuid, VK_UUID_SIZE) &&
+      !memcmp(pVersionInfo->pVersionData + VK_UUID_SIZE, compat_uuid, VK_UUID_SIZE);
+
+   *pCompatibility = compatible ? VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR :
+                                  VK_ACCELERATION_STRUCTURE_COMPATIBILITY_INCOMPATIBLE_KHR;
+}
+
+/* Host commands run right away, deferred operations are never deferred. */
+
+VKAPI_ATTR VkResult VKAPI_CALL
+lvp_BuildAccelerationStructuresKHR(
+   VkDevice                                    _device,
+   VkDeferredOperationKHR                      deferredOperation,
+   uint32_t                                    infoCount,
+   const VkAccelerationStructureBuildGeometryInfoKHR* pInfos,
+   const VkAccelerationStructureBuildRangeInfoKHR* const* ppBuildRangeInfos)
+{
+   LVP_FROM_HANDLE(lvp_device, device, _device);
+   lvp_build_acceleration_structures(device, infoCount, pInfos, ppBuildRangeInfos, true);
+   return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+lvp_CopyAccelerationStructureKHR(
+   VkDevice                                    _device,
+   VkDeferredOperationKHR                      deferredOperation,
+   const VkCopyAccelerationStructureInfoKHR*   pInfo)
+{
+   lvp_copy_acceleration_structure(pInfo);
+   return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+lvp_CopyAccelerationStructureToMemoryKHR(
+   VkDevice                                    _device,
+   VkDeferredOperationKHR                      deferredOperation,
+   const VkCopyAccelerationStructureToMemoryInfoKHR* pInfo)
+{
+   LVP_FROM_HANDLE(lvp_device, device, _device);
+   lvp_copy_acceleration_structure_to_memory(device, pInfo, true);
+   return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+lvp_CopyMemoryToAccelerationStructureKHR(
+   VkDevice                                    _device,
+   VkDeferredOperationKHR                      deferredOperation,
+   const VkCopyMemoryToAccelerationStructureInfoKHR* pInfo)
+{
+   LVP_FROM_HANDLE(lvp_device, device, _device);
+   lvp_copy_memory_to_acceleration_structure(device, pInfo, true);
+   return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+lvp_WriteAccelerationStructuresPropertiesKHR(
+   VkDevice                                    _device,
+   uint32_t                                    accelerationStructureCount,
+   const VkAccelerationStructureKHR*           pAccelerationStructures,
+   VkQueryType                                 queryType,
+   size_t                                      dataSize,
+   void*                                       pData,
+   size_t                                      stride)
+{
+   for (uint32_t i = 0; i < accelerationStructureCount; i++) {
+      uint64_t value = lvp_acceleration_structure_query(pAccelerationStructures[i], queryType);
+      memcpy((uint8_t *)pData + i * stride, &value, sizeof(value));
+   }
+   return VK_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef LVP_ACCELERATION_STRUCTURE_H
+#define LVP_ACCELERATION_STRUCTURE_H
+
+#include <stdint.h>
+
+/*
+ * Acceleration structure memory layout.
+ *
+ * Device addresses are host pointers in lavapipe, so acceleration structures
+ * are built on the CPU directly into the buffer memory they live in, and
+ * traversed by the shaders with plain global loads.
+ *
+ *    struct lvp_bvh_header
+ *    leaves[leaf_count]      all of the same type, in depth first order
+ *    boxes[box_count]        struct lvp_bvh_box_node, in depth first order
+ *
+ * Nodes are referenced by their byte offset from the start of the
+ * acceleration structure with the node type in the low bits, so the
+ * structure can be copied around with memcpy.  Only the BLAS pointers of
+ * instance nodes are absolute.
+ */
+
+#define LVP_BVH_NODE_BOX            0
+#define LVP_BVH_NODE_TRIANGLE       1
+#define LVP_BVH_NODE_AABB           2
+#define LVP_BVH_NODE_INSTANCE       3
+#define LVP_BVH_NODE_TYPE_MASK      0xf
+
+#define LVP_BVH_INVALID_NODE        0xffffffff
+
+/* Children per box node. */
+#define LVP_BVH_BOX_WIDTH           4
+
+/* The builder keeps the tree this shallow, which bounds the traversal
+ * stack: every box level pushes at most LVP_BVH_BOX_WIDTH - 1 entries, for
+ * both the top and the bottom level structure.
+ */
+#define LVP_BVH_MAX_DEPTH           24
+#define LVP_BVH_STACK_SIZE          (2 * LVP_BVH_MAX_DEPTH * (LVP_BVH_BOX_WIDTH - 1) + 2)
+
+/* Flags in the top bits of geometry_id_and_flags. */
+#define LVP_GEOMETRY_OPAQUE         (1u << 31)
+#define LVP_GEOMETRY_ID_MASK        0xffffff
+
+struct lvp_bvh_header {
+   uint32_t root;
+   uint32_t leaf_type;
+   uint32_t leaf_count;
+   uint32_t box_count;
+   uint32_t leaf_offset;
+   uint32_t box_offset;
+
+   /* Bytes used, i.e. the compacted size. */
+   uint64_t size;
+
+   /* Number of BLAS pointers, which are the instance nodes of a TLAS. */
+   uint64_t instance_count;
+
+   /* Bounds of everything in the structure, for instances referencing it. */
+   float min[3];
+   float max[3];
+};
+
+/* Each group of four is one coordinate of the four child boxes, so a ray
+ * can be tested against all of them with vec4 math.  Unused children are
+ * LVP_BVH_INVALID_NODE.
+ */
+struct lvp_bvh_box_node {
+   float min_x[LVP_BVH_BOX_WIDTH];
+   float min_y[LVP_BVH_BOX_WIDTH];
+   float min_z[LVP_BVH_BOX_WIDTH];
+   float max_x[LVP_BVH_BOX_WIDTH];
+   float max_y[LVP_BVH_BOX_WIDTH];
+   float max_z[LVP_BVH_BOX_WIDTH];
+   uint32_t children[LVP_BVH_BOX_WIDTH];
+};
+
+struct lvp_bvh_triangle_node {
+   float coords[3][3];
+   uint32_t primitive_id;
+   uint32_t geometry_id_and_flags;
+   uint32_t reserved;
+};
+
+struct lvp_bvh_aabb_node {
+   float min[3];
+   float max[3];
+   uint32_t primitive_id;
+   uint32_t geometry_id_and_flags;
+};
+
+struct lvp_bvh_instance_node {
+   /* Address of the BLAS header. */
+   uint64_t bvh_ptr;
+
+   /* lower 24 bits are the custom instance index, upper 8 bits the mask */
+   uint32_t custom_instance_and_mask;
+   /* lower 24 bits are the sbt offset, upper 8 bits VkGeometryInstanceFlagsKHR */
+   uint32_t sbt_offset_and_flags;
+
+   float wto_matrix[3][4];
+   float otw_matrix[3][4];
+
+   uint32_t instance_id;
+   uint32_t reserved[3];
+};
+
+#endif
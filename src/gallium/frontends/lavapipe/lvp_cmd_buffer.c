@@ -28,10 +28,14 @@
 #include "vk_common_entrypoints.h"
 
 static void
-lvp_cmd_buffer_destroy(struct vk_command_buffer *cmd_buffer)
+lvp_cmd_buffer_destroy(struct vk_command_buffer *vk_cmd_buffer)
 {
-   vk_command_buffer_finish(cmd_buffer);
-   vk_free(&cmd_buffer->pool->alloc, cmd_buffer);
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(vk_cmd_buffer, struct lvp_cmd_buffer, vk);
+
+   util_dynarray_fini(&cmd_buffer->stream);
+   vk_command_buffer_finish(vk_cmd_buffer);
+   vk_free(&vk_cmd_buffer->pool->alloc, cmd_buffer);
 }
 
 static VkResult
@@ -55,6 +59,8 @@ lvp_create_cmd_buffer(struct vk_command_pool *pool,
    }
 
    cmd_buffer->device = device;
+   util_dynarray_init(&cmd_buffer->stream, NULL);
+   cmd_buffer->stream_valid = false;
 
    *cmd_buffer_out = &cmd_buffer->vk;
 
@@ -65,6 +71,11 @@ static void
 lvp_reset_cmd_buffer(struct vk_command_buffer *vk_cmd_buffer,
                      UNUSED VkCommandBufferResetFlags flags)
 {
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(vk_cmd_buffer, struct lvp_cmd_buffer, vk);
+
+   util_dynarray_clear(&cmd_buffer->stream);
+   cmd_buffer->stream_valid = false;
    vk_command_buffer_reset(vk_cmd_buffer);
 }
 
@@ -90,7 +101,11 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_EndCommandBuffer(
 {
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
 
-   return vk_command_buffer_end(&cmd_buffer->vk);
+   VkResult result = vk_command_buffer_end(&cmd_buffer->vk);
+   if (result == VK_SUCCESS)
+      lvp_compile_cmd_buffer(cmd_buffer);
+
+   return result;
 }
 
 static void
@@ -167,3 +182,71 @@ VKAPI_ATTR void VKAPI_CALL lvp_CmdPushDescriptorSetWithTemplateKHR(
       }
    }
 }
+
+/* The generated enqueue doesn't copy the geometries and build ranges the
+ * build infos point at, so they are copied into the driver data here.
+ */
+VKAPI_ATTR void VKAPI_CALL lvp_CmdBuildAccelerationStructuresKHR(
+   VkCommandBuffer                             commandBuffer,
+   uint32_t                                    infoCount,
+   const VkAccelerationStructureBuildGeometryInfoKHR* pInfos,
+   const VkAccelerationStructureBuildRangeInfoKHR* const* ppBuildRangeInfos)
+{
+   LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
+   const VkAllocationCallbacks *alloc = cmd_buffer->vk.cmd_queue.alloc;
+   struct vk_cmd_queue_entry *cmd = vk_zalloc(alloc,
+                                              vk_cmd_queue_type_sizes[VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR], 8,
+                                              VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   if (!cmd)
+      goto fail;
+
+   cmd->type = VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR;
+
+   size_t geometry_count = 0;
+   for (uint32_t i = 0; i < infoCount; i++)
+      geometry_count += pInfos[i].geometryCount;
+
+   VkAccelerationStructureBuildGeometryInfoKHR *infos =
+      vk_alloc(alloc, sizeof(*infos) * infoCount, 8, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   const VkAccelerationStructureBuildRangeInfoKHR **ranges =
+      vk_alloc(alloc, sizeof(*ranges) * infoCount, 8, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   uint8_t *data = vk_alloc(alloc, MAX2(geometry_count, 1) * (sizeof(VkAccelerationStructureGeometryKHR) +
+                                                             sizeof(VkAccelerationStructureBuildRangeInfoKHR)),
+                            8, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+
+   cmd->u.build_acceleration_structures_khr.info_count = infoCount;
+   cmd->u.build_acceleration_structures_khr.infos = infos;
+   cmd->u.build_acceleration_structures_khr.pp_build_range_infos = ranges;
+   cmd->driver_data = data;
+   if (!infos || !ranges || !data) {
+      vk_free(alloc, infos);
+      vk_free(alloc, ranges);
+      vk_free(alloc, data);
+      vk_free(alloc, cmd);
+      goto fail;
+   }
+
+   VkAccelerationStructureGeometryKHR *geometries = (void *)data;
+   VkAccelerationStructureBuildRangeInfoKHR *range_infos = (void *)(geometries + geometry_count);
+
+   for (uint32_t i = 0; i < infoCount; i++) {
+      infos[i] = pInfos[i];
+      infos[i].pNext = NULL;
+      infos[i].pGeometries = geometries;
+      infos[i].ppGeometries = NULL;
+      ranges[i] = range_infos;
+
+      for (uint32_t g = 0; g < pInfos[i].geometryCount; g++) {
+         *geometries = pInfos[i].pGeometries ? pInfos[i].pGeometries[g] : *pInfos[i].ppGeometries[g];
+         geometries->pNext = NULL;
+         geometries++;
+         *range_infos++ = ppBuildRangeInfos[i][g];
+      }
+   }
+
+   list_addtail(&cmd->cmd_link, &cmd_buffer->vk.cmd_queue.cmds);
+   return;
+
+fail:
+   vk_command_buffer_set_error(&cmd_buffer->vk, VK_ERROR_OUT_OF_HOST_MEMORY);
+}
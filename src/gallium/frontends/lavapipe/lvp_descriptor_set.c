@@ -22,6 +22,7 @@
  */
 
 #include "lvp_private.h"
+#include "vk_acceleration_structure.h"
 #include "vk_descriptors.h"
 #include "vk_util.h"
 #include "util/u_math.h"
@@ -432,6 +433,20 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_FreeDescriptorSets(
    return VK_SUCCESS;
 }
 
+/* Shaders only need the address of the acceleration structure header. */
+static void
+lvp_write_acceleration_structure_descriptor(struct lp_descriptor *desc, VkAccelerationStructureKHR _accel_struct)
+{
+   VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, _accel_struct);
+
+   if (accel_struct) {
+      lp_jit_buffer_from_bda(&desc->buffer, (void *)(uintptr_t)vk_acceleration_structure_get_va(accel_struct),
+                             accel_struct->size);
+   } else {
+      lp_jit_buffer_from_bda(&desc->buffer, NULL, 0);
+   }
+}
+
 VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSets(
     VkDevice                                    _device,
     uint32_t                                    descriptorWriteCount,
@@ -617,6 +632,14 @@ VKAPI_ATTR void VKAPI_CALL lvp_UpdateDescriptorSets(
          }
          break;
 
+      case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR: {
+         const VkWriteDescriptorSetAccelerationStructureKHR *accel_structs =
+            vk_find_struct_const(write->pNext, WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR);
+         for (uint32_t j = 0; j < write->descriptorCount; j++)
+            lvp_write_acceleration_structure_descriptor(&desc[j], accel_structs->pAccelerationStructures[j]);
+         break;
+      }
+
       default:
          break;
       }
@@ -802,6 +825,8 @@ lvp_descriptor_update_template_entry_size(VkDescriptorType type)
    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
       return sizeof(VkBufferView);
+   case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+      return sizeof(VkAccelerationStructureKHR);
    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
@@ -984,6 +1009,9 @@ lvp_descriptor_set_update_with_template(VkDevice _device, VkDescriptorSet descri
             }
             break;
          }
+         case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+            lvp_write_acceleration_structure_descriptor(&desc[idx], *(VkAccelerationStructureKHR *)pSrc);
+            break;
          default:
             break;
          }
@@ -1159,6 +1187,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_GetDescriptorEXT(
       }
       break;
    }
+   case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+      lp_jit_buffer_from_bda(&desc->buffer, (void *)(uintptr_t)pCreateInfo->data.accelerationStructure, 0);
+      break;
    default:
       break;
    }
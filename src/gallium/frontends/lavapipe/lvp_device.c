@@ -40,6 +40,7 @@
 #include "util/os_time.h"
 #include "util/u_thread.h"
 #include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/timespec.h"
 #include "util/ptralloc.h"
 #include "nir.h"
@@ -93,11 +94,13 @@ static const struct vk_instance_extension_table lvp_instance_extensions_supporte
 static const struct vk_device_extension_table lvp_device_extensions_supported = {
    .KHR_8bit_storage                      = true,
    .KHR_16bit_storage                     = true,
+   .KHR_acceleration_structure            = true,
    .KHR_bind_memory2                      = true,
    .KHR_buffer_device_address             = true,
    .KHR_create_renderpass2                = true,
    .KHR_copy_commands2                    = true,
    .KHR_dedicated_allocation              = true,
+   .KHR_deferred_host_operations          = true,
    .KHR_depth_stencil_resolve             = true,
    .KHR_descriptor_update_template        = true,
    .KHR_device_group                      = true,
@@ -127,6 +130,7 @@ static const struct vk_device_extension_table lvp_device_extensions_supported =
    .KHR_multiview                         = true,
    .KHR_push_descriptor                   = true,
    .KHR_pipeline_library                  = true,
+   .KHR_ray_query                         = true,
    .KHR_relaxed_block_layout              = true,
    .KHR_sampler_mirror_clamp_to_edge      = true,
    .KHR_sampler_ycbcr_conversion          = true,
@@ -450,6 +454,16 @@ lvp_get_features(const struct lvp_physical_device *pdevice,
       .shaderSubgroupClock = true,
       .shaderDeviceClock = true,
 
+      /* VK_KHR_acceleration_structure */
+      .accelerationStructure = true,
+      .accelerationStructureCaptureReplay = false,
+      .accelerationStructureIndirectBuild = false,
+      .accelerationStructureHostCommands = true,
+      .descriptorBindingAccelerationStructureUpdateAfterBind = true,
+
+      /* VK_KHR_ray_query */
+      .rayQuery = true,
+
       /* VK_EXT_texel_buffer_alignment */
       .texelBufferAlignment = true,
 
@@ -881,6 +895,16 @@ lvp_get_properties(const struct lvp_physical_device *device, struct vk_propertie
       /* VK_KHR_push_descriptor */
       .maxPushDescriptors = MAX_PUSH_DESCRIPTORS,
 
+      /* VK_KHR_acceleration_structure */
+      .maxGeometryCount = 1 << 24,
+      .maxInstanceCount = 1 << 24,
+      .maxPrimitiveCount = 1 << 29,
+      .maxPerStageDescriptorAccelerationStructures = MAX_DESCRIPTORS,
+      .maxPerStageDescriptorUpdateAfterBindAccelerationStructures = MAX_DESCRIPTORS,
+      .maxDescriptorSetAccelerationStructures = MAX_DESCRIPTORS,
+      .maxDescriptorSetUpdateAfterBindAccelerationStructures = MAX_DESCRIPTORS,
+      .minAccelerationStructureScratchOffsetAlignment = 8,
+
       /* VK_EXT_host_image_copy */
       .pCopySrcLayouts = lvp_host_copy_image_layouts,
       .copySrcLayoutCount = ARRAY_SIZE(lvp_host_copy_image_layouts),
@@ -966,7 +990,7 @@ lvp_get_properties(const struct lvp_physical_device *device, struct vk_propertie
       .storageBufferDescriptorSize = sizeof(struct lp_descriptor),
       .robustStorageBufferDescriptorSize = sizeof(struct lp_descriptor),
       .inputAttachmentDescriptorSize = sizeof(struct lp_descriptor),
-      .accelerationStructureDescriptorSize = 0,
+      .accelerationStructureDescriptorSize = sizeof(struct lp_descriptor),
       .maxSamplerDescriptorBufferRange = 1<<27, //spec minimum
       .maxResourceDescriptorBufferRange = 1<<27, //spec minimum
       .resourceDescriptorBufferAddressSpaceSize = 1<<27, //spec minimum
@@ -1289,6 +1313,16 @@ VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceQueueFamilyProperties2(
          .minImageTransferGranularity = (VkExtent3D) { 1, 1, 1 },
       };
    }
+
+   vk_outarray_append_typed(VkQueueFamilyProperties2, &out, p) {
+      p->queueFamilyProperties = (VkQueueFamilyProperties) {
+         .queueFlags = VK_QUEUE_TRANSFER_BIT,
+         .queueCount = 1,
+         /* queries belong to the general queue's context */
+         .timestampValidBits = 0,
+         .minImageTransferGranularity = (VkExtent3D) { 1, 1, 1 },
+      };
+   }
 }
 
 VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceMemoryProperties(
@@ -1441,48 +1475,65 @@ lvp_queue_submit(struct vk_queue *vk_queue,
    return VK_SUCCESS;
 }
 
+static void
+lvp_queue_finish_context(struct lvp_queue *queue)
+{
+   destroy_pipelines(queue);
+   simple_mtx_destroy(&queue->lock);
+   util_dynarray_fini(&queue->pipeline_destroys);
+
+   u_upload_destroy(queue->uploader);
+   cso_destroy_context(queue->cso);
+   queue->ctx->destroy(queue->ctx);
+}
+
+/* With a NULL create_info only the pipe context is set up, which is how the
+ * general queue exists when the application didn't ask for it.
+ */
 static VkResult
 lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
                const VkDeviceQueueCreateInfo *create_info,
                uint32_t index_in_family)
 {
+   queue->device = device;
+
+   queue->ctx = device->pscreen->context_create(device->pscreen, NULL, PIPE_CONTEXT_ROBUST_BUFFER_ACCESS);
+   queue->cso = cso_create_context(queue->ctx, CSO_NO_VBUF);
+   queue->uploader = u_upload_create(queue->ctx, 1024 * 1024, PIPE_BIND_CONSTANT_BUFFER, PIPE_USAGE_STREAM, 0);
+
+   simple_mtx_init(&queue->lock, mtx_plain);
+   util_dynarray_init(&queue->pipeline_destroys, NULL);
+
+   if (!create_info)
+      return VK_SUCCESS;
+
    VkResult result = vk_queue_init(&queue->vk, &device->vk, create_info,
                                    index_in_family);
-   if (result != VK_SUCCESS)
+   if (result != VK_SUCCESS) {
+      lvp_queue_finish_context(queue);
       return result;
+   }
 
    result = vk_queue_enable_submit_thread(&queue->vk);
    if (result != VK_SUCCESS) {
       vk_queue_finish(&queue->vk);
+      lvp_queue_finish_context(queue);
       return result;
    }
 
-   queue->device = device;
-
-   queue->ctx = device->pscreen->context_create(device->pscreen, NULL, PIPE_CONTEXT_ROBUST_BUFFER_ACCESS);
-   queue->cso = cso_create_context(queue->ctx, CSO_NO_VBUF);
-   queue->uploader = u_upload_create(queue->ctx, 1024 * 1024, PIPE_BIND_CONSTANT_BUFFER, PIPE_USAGE_STREAM, 0);
-
    queue->vk.driver_submit = lvp_queue_submit;
 
-   simple_mtx_init(&queue->lock, mtx_plain);
-   util_dynarray_init(&queue->pipeline_destroys, NULL);
-
    return VK_SUCCESS;
 }
 
 static void
 lvp_queue_finish(struct lvp_queue *queue)
 {
-   vk_queue_finish(&queue->vk);
-
-   destroy_pipelines(queue);
-   simple_mtx_destroy(&queue->lock);
-   util_dynarray_fini(&queue->pipeline_destroys);
+   /* Only queues the application asked for have a vk_queue */
+   if (queue->vk.driver_submit)
+      vk_queue_finish(&queue->vk);
 
-   u_upload_destroy(queue->uploader);
-   cso_destroy_context(queue->cso);
-   queue->ctx->destroy(queue->ctx);
+   lvp_queue_finish_context(queue);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
@@ -1499,12 +1550,13 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    size_t state_size = lvp_get_rendering_state_size();
    device = vk_zalloc2(&physical_device->vk.instance->alloc, pAllocator,
-                       sizeof(*device) + state_size, 8,
+                       sizeof(*device) + state_size * LVP_QUEUE_FAMILY_COUNT, 8,
                        VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
    if (!device)
       return vk_error(instance, VK_ERROR_OUT_OF_HOST_MEMORY);
 
    device->queue.state = device + 1;
+   device->transfer_queue.state = (uint8_t *)(device + 1) + state_size;
    device->poison_mem = debug_get_bool_option("LVP_POISON_MEMORY", false);
    device->print_cmds = debug_get_bool_option("LVP_CMD_DEBUG", false);
 
@@ -1531,15 +1583,38 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    device->pscreen = physical_device->pscreen;
 
-   assert(pCreateInfo->queueCreateInfoCount == 1);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex == 0);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueCount == 1);
-   result = lvp_queue_init(device, &device->queue, pCreateInfo->pQueueCreateInfos, 0);
+   const VkDeviceQueueCreateInfo *general_info = NULL;
+   const VkDeviceQueueCreateInfo *transfer_info = NULL;
+   for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++) {
+      const VkDeviceQueueCreateInfo *info = &pCreateInfo->pQueueCreateInfos[i];
+
+      assert(info->queueCount == 1);
+      if (info->queueFamilyIndex == LVP_QUEUE_FAMILY_TRANSFER)
+         transfer_info = info;
+      else
+         general_info = info;
+   }
+
+   /* The general queue's context is used for all object creation, so its
+    * context is always created.  It only becomes a VkQueue if requested.
+    */
+   result = lvp_queue_init(device, &device->queue, general_info, 0);
    if (result != VK_SUCCESS) {
+      vk_device_finish(&device->vk);
       vk_free(&device->vk.alloc, device);
       return result;
    }
 
+   if (transfer_info) {
+      result = lvp_queue_init(device, &device->transfer_queue, transfer_info, 0);
+      if (result != VK_SUCCESS) {
+         lvp_queue_finish(&device->queue);
+         vk_device_finish(&device->vk);
+         vk_free(&device->vk.alloc, device);
+         return result;
+      }
+   }
+
    nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_FRAGMENT, NULL, "dummy_frag");
    struct pipe_shader_state shstate = {0};
    shstate.type = PIPE_SHADER_IR_NIR;
@@ -1559,6 +1634,16 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
    util_dynarray_init(&device->bda_texture_handles, NULL);
    util_dynarray_init(&device->bda_image_handles, NULL);
 
+   /* Acceleration structure builds and large copies get spread over the
+    * cores, see lvp_acceleration_structure.c and lvp_copy_box().
+    */
+   unsigned num_cpus = util_get_cpu_caps()->nr_cpus;
+   if (num_cpus > 1) {
+      util_queue_init(&device->worker_queue, "lvpwork", 32, MIN2(num_cpus, 16),
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL);
+   }
+
    *pDevice = lvp_device_to_handle(device);
 
    return VK_SUCCESS;
@@ -1588,10 +1673,17 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
 
    if (device->queue.last_fence)
       device->pscreen->fence_reference(device->pscreen, &device->queue.last_fence, NULL);
+   if (device->transfer_queue.last_fence)
+      device->pscreen->fence_reference(device->pscreen, &device->transfer_queue.last_fence, NULL);
    ralloc_free(device->bda.table);
    simple_mtx_destroy(&device->bda_lock);
    pipe_resource_reference(&device->zero_buffer, NULL);
 
+   if (util_queue_is_initialized(&device->worker_queue))
+      util_queue_destroy(&device->worker_queue);
+
+   if (device->transfer_queue.ctx)
+      lvp_queue_finish(&device->transfer_queue);
    lvp_queue_finish(&device->queue);
    vk_device_finish(&device->vk);
    vk_free(&device->vk.alloc, device);
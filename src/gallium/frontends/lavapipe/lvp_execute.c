@@ -1814,14 +1814,70 @@ handle_begin_rendering(struct vk_cmd_queue_entry *cmd,
       render_clear_fast(state);
 }
 
+/* Whether the attachment can be thrown away as a whole at the end of the
+ * render pass: invalidation drops everything still pending in the scene
+ * for the resource, not just what this render pass wrote.  That's only
+ * fine if the render area covers all of it and the earlier contents
+ * weren't loaded, so nothing queued before the render pass is needed.
+ */
+static bool
+can_discard_attachment(const struct rendering_state *state,
+                       const struct pipe_resource *pres,
+                       VkAttachmentLoadOp load_op)
+{
+   return pres->target == PIPE_TEXTURE_2D && pres->depth0 == 1 &&
+          pres->array_size == 1 && pres->last_level == 0 &&
+          load_op != VK_ATTACHMENT_LOAD_OP_LOAD &&
+          state->render_area.offset.x == 0 &&
+          state->render_area.offset.y == 0 &&
+          state->render_area.extent.width >= pres->width0 &&
+          state->render_area.extent.height >= pres->height0;
+}
+
+/* Let the driver skip writing back attachments with STORE_OP_DONT_CARE. */
+static void
+discard_attachments(struct rendering_state *state)
+{
+   if (!state->pctx->invalidate_resource)
+      return;
+
+   for (unsigned i = 0; i < state->framebuffer.nr_cbufs; i++) {
+      struct pipe_surface *surf = state->framebuffer.cbufs[i];
+
+      if (state->color_att[i].imgv && surf &&
+          state->color_att[i].store_op == VK_ATTACHMENT_STORE_OP_DONT_CARE &&
+          can_discard_attachment(state, surf->texture,
+                                 state->color_att[i].load_op))
+         state->pctx->invalidate_resource(state->pctx, surf->texture);
+   }
+
+   /* depth and stencil share the resource */
+   struct pipe_surface *zsbuf = state->framebuffer.zsbuf;
+   const bool depth_dont_care = !state->depth_att.imgv ||
+      (!state->depth_att.read_only &&
+       state->depth_att.load_op != VK_ATTACHMENT_LOAD_OP_LOAD &&
+       state->depth_att.store_op == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+   const bool stencil_dont_care = !state->stencil_att.imgv ||
+      (!state->stencil_att.read_only &&
+       state->stencil_att.load_op != VK_ATTACHMENT_LOAD_OP_LOAD &&
+       state->stencil_att.store_op == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+   if (zsbuf && depth_dont_care && stencil_dont_care &&
+       can_discard_attachment(state, zsbuf->texture,
+                              VK_ATTACHMENT_LOAD_OP_DONT_CARE))
+      state->pctx->invalidate_resource(state->pctx, zsbuf->texture);
+}
+
 static void handle_end_rendering(struct vk_cmd_queue_entry *cmd,
                                  struct rendering_state *state)
 {
    if (state->suspending)
       return;
    render_resolve(state);
-   if (!state->poison_mem)
+   if (!state->poison_mem) {
+      discard_attachments(state);
       return;
+   }
 
    union pipe_color_union color_clear_val;
    memset(color_clear_val.ui, rand() % UINT8_MAX, sizeof(color_clear_val.ui));
@@ -2231,14 +2287,14 @@ static void handle_copy_image_to_buffer2(struct vk_cmd_queue_entry *cmd,
                         box.depth,
                         src_data, src_format, src_t->stride, src_t->layer_stride, 0, 0, 0);
       } else {
-         util_copy_box((uint8_t *)dst_data, src_format,
-                       buffer_layout.row_stride_B,
-                       buffer_layout.image_stride_B,
-                       0, 0, 0,
-                       region->imageExtent.width,
-                       region->imageExtent.height,
-                       box.depth,
-                       src_data, src_t->stride, src_t->layer_stride, 0, 0, 0);
+         lvp_copy_box(state->device, src_format,
+                      dst_data,
+                      buffer_layout.row_stride_B,
+                      buffer_layout.image_stride_B,
+                      src_data, src_t->stride, src_t->layer_stride,
+                      region->imageExtent.width,
+                      region->imageExtent.height,
+                      box.depth);
       }
       state->pctx->texture_unmap(state->pctx, src_t);
       state->pctx->buffer_unmap(state->pctx, dst_t);
@@ -2280,13 +2336,6 @@ static void handle_copy_buffer_to_image(struct vk_cmd_queue_entry *cmd,
       box.height = region->imageExtent.height;
       box.depth = dst_image->vk.image_type == VK_IMAGE_TYPE_3D ? region->imageExtent.depth : subresource_layercount(dst_image, &region->imageSubresource);
 
-      dst_data = state->pctx->texture_map(state->pctx,
-                                           dst_image->planes[plane].bo,
-                                           region->imageSubresource.mipLevel,
-                                           PIPE_MAP_WRITE,
-                                           &box,
-                                           &dst_t);
-
       enum pipe_format dst_format = dst_image->planes[plane].bo->format;
       enum pipe_format src_format = dst_format;
       if (util_format_is_depth_or_stencil(dst_format)) {
@@ -2297,6 +2346,20 @@ static void handle_copy_buffer_to_image(struct vk_cmd_queue_entry *cmd,
          }
       }
 
+      /* Unless only one aspect of a packed depth/stencil format is written,
+       * the whole box is overwritten and its old contents are not needed.
+       */
+      unsigned usage = PIPE_MAP_WRITE;
+      if (src_format == dst_format)
+         usage |= PIPE_MAP_DISCARD_RANGE;
+
+      dst_data = state->pctx->texture_map(state->pctx,
+                                           dst_image->planes[plane].bo,
+                                           region->imageSubresource.mipLevel,
+                                           usage,
+                                           &box,
+                                           &dst_t);
+
       const struct vk_image_buffer_layout buffer_layout =
          vk_image_buffer_copy_layout(&dst_image->vk, &copycmd->pRegions[i]);
       if (src_format != dst_format) {
@@ -2311,16 +2374,14 @@ static void handle_copy_buffer_to_image(struct vk_cmd_queue_entry *cmd,
                         buffer_layout.image_stride_B,
                         0, 0, 0);
       } else {
-         util_copy_box(dst_data, dst_format,
-                       dst_t->stride, dst_t->layer_stride,
-                       0, 0, 0,
-                       region->imageExtent.width,
-                       region->imageExtent.height,
-                       box.depth,
-                       src_data,
-                       buffer_layout.row_stride_B,
-                       buffer_layout.image_stride_B,
-                       0, 0, 0);
+         lvp_copy_box(state->device, dst_format,
+                      dst_data, dst_t->stride, dst_t->layer_stride,
+                      src_data,
+                      buffer_layout.row_stride_B,
+                      buffer_layout.image_stride_B,
+                      region->imageExtent.width,
+                      region->imageExtent.height,
+                      box.depth);
       }
       state->pctx->buffer_unmap(state->pctx, src_t);
       state->pctx->texture_unmap(state->pctx, dst_t);
@@ -2840,6 +2901,8 @@ static void handle_reset_query_pool(struct vk_cmd_queue_entry *cmd,
    struct vk_cmd_reset_query_pool *qcmd = &cmd->u.reset_query_pool;
    LVP_FROM_HANDLE(lvp_query_pool, pool, qcmd->query_pool);
    for (unsigned i = qcmd->first_query; i < qcmd->first_query + qcmd->query_count; i++) {
+      if (pool->data)
+         pool->data[i] = 0;
       if (pool->queries[i]) {
          state->pctx->destroy_query(state->pctx, pool->queries[i]);
          pool->queries[i] = NULL;
@@ -2878,7 +2941,33 @@ static void handle_copy_query_pool_results(struct vk_cmd_queue_entry *cmd,
    unsigned result_size = copycmd->flags & VK_QUERY_RESULT_64_BIT ? 8 : 4;
    for (unsigned i = copycmd->first_query; i < copycmd->first_query + copycmd->query_count; i++) {
       unsigned offset = copycmd->dst_offset + (copycmd->stride * (i - copycmd->first_query));
-      if (pool->queries[i]) {
+      if (pool->data) {
+         /* acceleration structure queries are written by the CPU */
+         struct pipe_transfer *dst_t;
+         struct pipe_box box = {0};
+         box.x = offset;
+         box.width = 2 * result_size;
+         box.height = 1;
+         box.depth = 1;
+         uint8_t *map = state->pctx->buffer_map(state->pctx,
+                                                lvp_buffer_from_handle(copycmd->dst_buffer)->bo, 0,
+                                                PIPE_MAP_WRITE, &box, &dst_t);
+         uint64_t value = pool->data[i];
+         bool ready = value != 0;
+         if (ready || (copycmd->flags & VK_QUERY_RESULT_PARTIAL_BIT)) {
+            if (result_size == 8)
+               memcpy(map, &value, 8);
+            else
+               *(uint32_t *)map = (uint32_t)MIN2(value, UINT32_MAX);
+         }
+         if (copycmd->flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) {
+            if (result_size == 8)
+               *(uint64_t *)(map + 8) = ready;
+            else
+               *(uint32_t *)(map + 4) = ready;
+         }
+         state->pctx->buffer_unmap(state->pctx, dst_t);
+      } else if (pool->queries[i]) {
          unsigned num_results = 0;
          if (copycmd->flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) {
             if (pool->type == VK_QUERY_TYPE_PIPELINE_STATISTICS) {
@@ -4259,6 +4348,58 @@ handle_dispatch_graph(struct vk_cmd_queue_entry *cmd, struct rendering_state *st
 }
 #endif
 
+/* Acceleration structures are built and copied on the CPU, so the commands
+ * writing them wait for everything in flight that might write their inputs.
+ */
+static void
+handle_build_acceleration_structures(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
+{
+   struct vk_cmd_build_acceleration_structures_khr *build = &cmd->u.build_acceleration_structures_khr;
+
+   finish_fence(state);
+   lvp_build_acceleration_structures(state->device, build->info_count, build->infos,
+                                     build->pp_build_range_infos, false);
+}
+
+static void
+handle_copy_acceleration_structure(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
+{
+   finish_fence(state);
+   lvp_copy_acceleration_structure(cmd->u.copy_acceleration_structure_khr.info);
+}
+
+static void
+handle_copy_acceleration_structure_to_memory(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
+{
+   finish_fence(state);
+   lvp_copy_acceleration_structure_to_memory(state->device,
+                                             cmd->u.copy_acceleration_structure_to_memory_khr.info,
+                                             false);
+}
+
+static void
+handle_copy_memory_to_acceleration_structure(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
+{
+   finish_fence(state);
+   lvp_copy_memory_to_acceleration_structure(state->device,
+                                             cmd->u.copy_memory_to_acceleration_structure_khr.info,
+                                             false);
+}
+
+static void
+handle_write_acceleration_structures_properties(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
+{
+   struct vk_cmd_write_acceleration_structures_properties_khr *write =
+      &cmd->u.write_acceleration_structures_properties_khr;
+   LVP_FROM_HANDLE(lvp_query_pool, pool, write->query_pool);
+
+   finish_fence(state);
+   for (uint32_t i = 0; i < write->acceleration_structure_count; i++) {
+      pool->data[write->first_query + i] =
+         lvp_acceleration_structure_query(write->acceleration_structures[i], write->query_type);
+   }
+}
+
 void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
 {
    struct vk_device_dispatch_table cmd_enqueue_dispatch;
@@ -4269,7 +4410,7 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
    assert(cmd_enqueue_dispatch.CmdName != NULL); \
    disp->CmdName = cmd_enqueue_dispatch.CmdName;
 
-   /* This list needs to match what's in lvp_execute_cmd_buffer exactly */
+   /* This list needs to match what's in lvp_execute_cmd exactly */
    ENQUEUE_CMD(CmdBindPipeline)
    ENQUEUE_CMD(CmdSetViewport)
    ENQUEUE_CMD(CmdSetViewportWithCount)
@@ -4391,6 +4532,11 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
    ENQUEUE_CMD(CmdPreprocessGeneratedCommandsNV)
    ENQUEUE_CMD(CmdExecuteGeneratedCommandsNV)
 
+   ENQUEUE_CMD(CmdCopyAccelerationStructureKHR)
+   ENQUEUE_CMD(CmdCopyAccelerationStructureToMemoryKHR)
+   ENQUEUE_CMD(CmdCopyMemoryToAccelerationStructureKHR)
+   ENQUEUE_CMD(CmdWriteAccelerationStructuresPropertiesKHR)
+
 #ifdef VK_ENABLE_BETA_EXTENSIONS
    ENQUEUE_CMD(CmdInitializeGraphScratchMemoryAMDX)
    ENQUEUE_CMD(CmdDispatchGraphIndirectCountAMDX)
@@ -4401,6 +4547,378 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
 #undef ENQUEUE_CMD
 }
 
+static void lvp_execute_cmd(struct vk_cmd_queue_entry *cmd,
+                            struct rendering_state *state, bool print_cmds)
+{
+   if (print_cmds)
+      fprintf(stderr, "%s\n", vk_cmd_queue_type_names[cmd->type]);
+   switch (cmd->type) {
+   case VK_CMD_BIND_PIPELINE:
+      handle_pipeline(cmd, state);
+      break;
+   case VK_CMD_SET_VIEWPORT:
+      handle_set_viewport(cmd, state);
+      break;
+   case VK_CMD_SET_VIEWPORT_WITH_COUNT:
+      handle_set_viewport_with_count(cmd, state);
+      break;
+   case VK_CMD_SET_SCISSOR:
+      handle_set_scissor(cmd, state);
+      break;
+   case VK_CMD_SET_SCISSOR_WITH_COUNT:
+      handle_set_scissor_with_count(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_WIDTH:
+      handle_set_line_width(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BIAS:
+      handle_set_depth_bias(cmd, state);
+      break;
+   case VK_CMD_SET_BLEND_CONSTANTS:
+      handle_set_blend_constants(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BOUNDS:
+      handle_set_depth_bounds(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_COMPARE_MASK:
+      handle_set_stencil_compare_mask(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_WRITE_MASK:
+      handle_set_stencil_write_mask(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_REFERENCE:
+      handle_set_stencil_reference(cmd, state);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_SETS:
+      handle_descriptor_sets(cmd, state);
+      break;
+   case VK_CMD_BIND_INDEX_BUFFER:
+      handle_index_buffer(cmd, state);
+      break;
+   case VK_CMD_BIND_INDEX_BUFFER2_KHR:
+      handle_index_buffer2(cmd, state);
+      break;
+   case VK_CMD_BIND_VERTEX_BUFFERS2:
+      handle_vertex_buffers2(cmd, state);
+      break;
+   case VK_CMD_DRAW:
+      emit_state(state);
+      handle_draw(cmd, state);
+      break;
+   case VK_CMD_DRAW_MULTI_EXT:
+      emit_state(state);
+      handle_draw_multi(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDEXED:
+      emit_state(state);
+      handle_draw_indexed(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDIRECT:
+      emit_state(state);
+      handle_draw_indirect(cmd, state, false);
+      break;
+   case VK_CMD_DRAW_INDEXED_INDIRECT:
+      emit_state(state);
+      handle_draw_indirect(cmd, state, true);
+      break;
+   case VK_CMD_DRAW_MULTI_INDEXED_EXT:
+      emit_state(state);
+      handle_draw_multi_indexed(cmd, state);
+      break;
+   case VK_CMD_DISPATCH:
+      emit_compute_state(state);
+      handle_dispatch(cmd, state);
+      break;
+   case VK_CMD_DISPATCH_BASE:
+      emit_compute_state(state);
+      handle_dispatch_base(cmd, state);
+      break;
+   case VK_CMD_DISPATCH_INDIRECT:
+      emit_compute_state(state);
+      handle_dispatch_indirect(cmd, state);
+      break;
+   case VK_CMD_COPY_BUFFER2:
+      handle_copy_buffer(cmd, state);
+      break;
+   case VK_CMD_COPY_IMAGE2:
+      handle_copy_image(cmd, state);
+      break;
+   case VK_CMD_BLIT_IMAGE2:
+      handle_blit_image(cmd, state);
+      break;
+   case VK_CMD_COPY_BUFFER_TO_IMAGE2:
+      handle_copy_buffer_to_image(cmd, state);
+      break;
+   case VK_CMD_COPY_IMAGE_TO_BUFFER2:
+      handle_copy_image_to_buffer2(cmd, state);
+      break;
+   case VK_CMD_UPDATE_BUFFER:
+      handle_update_buffer(cmd, state);
+      break;
+   case VK_CMD_FILL_BUFFER:
+      handle_fill_buffer(cmd, state);
+      break;
+   case VK_CMD_CLEAR_COLOR_IMAGE:
+      handle_clear_color_image(cmd, state);
+      break;
+   case VK_CMD_CLEAR_DEPTH_STENCIL_IMAGE:
+      handle_clear_ds_image(cmd, state);
+      break;
+   case VK_CMD_CLEAR_ATTACHMENTS:
+      handle_clear_attachments(cmd, state);
+      break;
+   case VK_CMD_RESOLVE_IMAGE2:
+      handle_resolve_image(cmd, state);
+      break;
+   case VK_CMD_PIPELINE_BARRIER2:
+      handle_pipeline_barrier(cmd, state);
+      break;
+   case VK_CMD_BEGIN_QUERY_INDEXED_EXT:
+      handle_begin_query_indexed_ext(cmd, state);
+      break;
+   case VK_CMD_END_QUERY_INDEXED_EXT:
+      handle_end_query_indexed_ext(cmd, state);
+      break;
+   case VK_CMD_BEGIN_QUERY:
+      handle_begin_query(cmd, state);
+      break;
+   case VK_CMD_END_QUERY:
+      handle_end_query(cmd, state);
+      break;
+   case VK_CMD_RESET_QUERY_POOL:
+      handle_reset_query_pool(cmd, state);
+      break;
+   case VK_CMD_COPY_QUERY_POOL_RESULTS:
+      handle_copy_query_pool_results(cmd, state);
+      break;
+   case VK_CMD_PUSH_CONSTANTS:
+      handle_push_constants(cmd, state);
+      break;
+   case VK_CMD_EXECUTE_COMMANDS:
+      handle_execute_commands(cmd, state, print_cmds);
+      break;
+   case VK_CMD_DRAW_INDIRECT_COUNT:
+      emit_state(state);
+      handle_draw_indirect_count(cmd, state, false);
+      break;
+   case VK_CMD_DRAW_INDEXED_INDIRECT_COUNT:
+      emit_state(state);
+      handle_draw_indirect_count(cmd, state, true);
+      break;
+   case VK_CMD_PUSH_DESCRIPTOR_SET_KHR:
+      handle_push_descriptor_set(cmd, state);
+      break;
+   case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE_KHR:
+      handle_push_descriptor_set_with_template(cmd, state);
+      break;
+   case VK_CMD_BIND_TRANSFORM_FEEDBACK_BUFFERS_EXT:
+      handle_bind_transform_feedback_buffers(cmd, state);
+      break;
+   case VK_CMD_BEGIN_TRANSFORM_FEEDBACK_EXT:
+      handle_begin_transform_feedback(cmd, state);
+      break;
+   case VK_CMD_END_TRANSFORM_FEEDBACK_EXT:
+      handle_end_transform_feedback(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDIRECT_BYTE_COUNT_EXT:
+      emit_state(state);
+      handle_draw_indirect_byte_count(cmd, state);
+      break;
+   case VK_CMD_BEGIN_CONDITIONAL_RENDERING_EXT:
+      handle_begin_conditional_rendering(cmd, state);
+      break;
+   case VK_CMD_END_CONDITIONAL_RENDERING_EXT:
+      handle_end_conditional_rendering(state);
+      break;
+   case VK_CMD_SET_VERTEX_INPUT_EXT:
+      handle_set_vertex_input(cmd, state);
+      break;
+   case VK_CMD_SET_CULL_MODE:
+      handle_set_cull_mode(cmd, state);
+      break;
+   case VK_CMD_SET_FRONT_FACE:
+      handle_set_front_face(cmd, state);
+      break;
+   case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
+      handle_set_primitive_topology(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_TEST_ENABLE:
+      handle_set_depth_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_WRITE_ENABLE:
+      handle_set_depth_write_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_COMPARE_OP:
+      handle_set_depth_compare_op(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
+      handle_set_depth_bounds_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_TEST_ENABLE:
+      handle_set_stencil_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_OP:
+      handle_set_stencil_op(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_STIPPLE_EXT:
+      handle_set_line_stipple(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BIAS_ENABLE:
+      handle_set_depth_bias_enable(cmd, state);
+      break;
+   case VK_CMD_SET_LOGIC_OP_EXT:
+      handle_set_logic_op(cmd, state);
+      break;
+   case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
+      handle_set_patch_control_points(cmd, state);
+      break;
+   case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
+      handle_set_primitive_restart_enable(cmd, state);
+      break;
+   case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
+      handle_set_rasterizer_discard_enable(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_WRITE_ENABLE_EXT:
+      handle_set_color_write_enable(cmd, state);
+      break;
+   case VK_CMD_BEGIN_RENDERING:
+      handle_begin_rendering(cmd, state);
+      break;
+   case VK_CMD_END_RENDERING:
+      handle_end_rendering(cmd, state);
+      break;
+   case VK_CMD_SET_DEVICE_MASK:
+      /* no-op */
+      break;
+   case VK_CMD_RESET_EVENT2:
+      handle_event_reset2(cmd, state);
+      break;
+   case VK_CMD_SET_EVENT2:
+      handle_event_set2(cmd, state);
+      break;
+   case VK_CMD_WAIT_EVENTS2:
+      handle_wait_events2(cmd, state);
+      break;
+   case VK_CMD_WRITE_TIMESTAMP2:
+      handle_write_timestamp2(cmd, state);
+      break;
+   case VK_CMD_SET_POLYGON_MODE_EXT:
+      handle_set_polygon_mode(cmd, state);
+      break;
+   case VK_CMD_SET_TESSELLATION_DOMAIN_ORIGIN_EXT:
+      handle_set_tessellation_domain_origin(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT:
+      handle_set_depth_clamp_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
+      handle_set_depth_clip_enable(cmd, state);
+      break;
+   case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
+      handle_set_logic_op_enable(cmd, state);
+      break;
+   case VK_CMD_SET_SAMPLE_MASK_EXT:
+      handle_set_sample_mask(cmd, state);
+      break;
+   case VK_CMD_SET_RASTERIZATION_SAMPLES_EXT:
+      handle_set_samples(cmd, state);
+      break;
+   case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
+      handle_set_alpha_to_coverage(cmd, state);
+      break;
+   case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
+      handle_set_alpha_to_one(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
+      handle_set_halfz(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
+      handle_set_line_rasterization_mode(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
+      handle_set_line_stipple_enable(cmd, state);
+      break;
+   case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
+      handle_set_provoking_vertex_mode(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_BLEND_ENABLE_EXT:
+      handle_set_color_blend_enable(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_WRITE_MASK_EXT:
+      handle_set_color_write_mask(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_BLEND_EQUATION_EXT:
+      handle_set_color_blend_equation(cmd, state);
+      break;
+   case VK_CMD_BIND_SHADERS_EXT:
+      handle_shaders(cmd, state);
+      break;
+   case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks(cmd, state);
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks_indirect(cmd, state);
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_COUNT_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks_indirect_count(cmd, state);
+      break;
+   case VK_CMD_BIND_PIPELINE_SHADER_GROUP_NV:
+      handle_graphics_pipeline_group(cmd, state);
+      break;
+   case VK_CMD_PREPROCESS_GENERATED_COMMANDS_NV:
+      handle_preprocess_generated_commands(cmd, state);
+      break;
+   case VK_CMD_EXECUTE_GENERATED_COMMANDS_NV:
+      handle_execute_generated_commands(cmd, state, print_cmds);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_BUFFERS_EXT:
+      handle_descriptor_buffers(cmd, state);
+      break;
+   case VK_CMD_SET_DESCRIPTOR_BUFFER_OFFSETS_EXT:
+      handle_descriptor_buffer_offsets(cmd, state);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_BUFFER_EMBEDDED_SAMPLERS_EXT:
+      handle_descriptor_buffer_embedded_samplers(cmd, state);
+      break;
+   case VK_CMD_BUILD_ACCELERATION_STRUCTURES_KHR:
+      handle_build_acceleration_structures(cmd, state);
+      break;
+   case VK_CMD_COPY_ACCELERATION_STRUCTURE_KHR:
+      handle_copy_acceleration_structure(cmd, state);
+      break;
+   case VK_CMD_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_KHR:
+      handle_copy_acceleration_structure_to_memory(cmd, state);
+      break;
+   case VK_CMD_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_KHR:
+      handle_copy_memory_to_acceleration_structure(cmd, state);
+      break;
+   case VK_CMD_WRITE_ACCELERATION_STRUCTURES_PROPERTIES_KHR:
+      handle_write_acceleration_structures_properties(cmd, state);
+      break;
+#ifdef VK_ENABLE_BETA_EXTENSIONS
+   case VK_CMD_INITIALIZE_GRAPH_SCRATCH_MEMORY_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_COUNT_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_AMDX:
+      handle_dispatch_graph(cmd, state);
+      break;
+#endif
+   default:
+      fprintf(stderr, "Unsupported command %s\n", vk_cmd_queue_type_names[cmd->type]);
+      unreachable("Unsupported command");
+      break;
+   }
+
+}
+
 static void lvp_execute_cmd_buffer(struct list_head *cmds,
                                    struct rendering_state *state, bool print_cmds)
 {
@@ -4408,367 +4926,148 @@ static void lvp_execute_cmd_buffer(struct list_head *cmds,
    bool did_flush = false;
 
    LIST_FOR_EACH_ENTRY(cmd, cmds, cmd_link) {
-      if (print_cmds)
-         fprintf(stderr, "%s\n", vk_cmd_queue_type_names[cmd->type]);
-      switch (cmd->type) {
-      case VK_CMD_BIND_PIPELINE:
-         handle_pipeline(cmd, state);
-         break;
-      case VK_CMD_SET_VIEWPORT:
-         handle_set_viewport(cmd, state);
-         break;
-      case VK_CMD_SET_VIEWPORT_WITH_COUNT:
-         handle_set_viewport_with_count(cmd, state);
-         break;
-      case VK_CMD_SET_SCISSOR:
-         handle_set_scissor(cmd, state);
-         break;
-      case VK_CMD_SET_SCISSOR_WITH_COUNT:
-         handle_set_scissor_with_count(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_WIDTH:
-         handle_set_line_width(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BIAS:
-         handle_set_depth_bias(cmd, state);
-         break;
-      case VK_CMD_SET_BLEND_CONSTANTS:
-         handle_set_blend_constants(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BOUNDS:
-         handle_set_depth_bounds(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_COMPARE_MASK:
-         handle_set_stencil_compare_mask(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_WRITE_MASK:
-         handle_set_stencil_write_mask(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_REFERENCE:
-         handle_set_stencil_reference(cmd, state);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_SETS:
-         handle_descriptor_sets(cmd, state);
-         break;
-      case VK_CMD_BIND_INDEX_BUFFER:
-         handle_index_buffer(cmd, state);
-         break;
-      case VK_CMD_BIND_INDEX_BUFFER2_KHR:
-         handle_index_buffer2(cmd, state);
-         break;
-      case VK_CMD_BIND_VERTEX_BUFFERS2:
-         handle_vertex_buffers2(cmd, state);
-         break;
-      case VK_CMD_DRAW:
-         emit_state(state);
-         handle_draw(cmd, state);
-         break;
-      case VK_CMD_DRAW_MULTI_EXT:
-         emit_state(state);
-         handle_draw_multi(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDEXED:
-         emit_state(state);
-         handle_draw_indexed(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDIRECT:
-         emit_state(state);
-         handle_draw_indirect(cmd, state, false);
-         break;
-      case VK_CMD_DRAW_INDEXED_INDIRECT:
-         emit_state(state);
-         handle_draw_indirect(cmd, state, true);
-         break;
-      case VK_CMD_DRAW_MULTI_INDEXED_EXT:
-         emit_state(state);
-         handle_draw_multi_indexed(cmd, state);
-         break;
-      case VK_CMD_DISPATCH:
-         emit_compute_state(state);
-         handle_dispatch(cmd, state);
-         break;
-      case VK_CMD_DISPATCH_BASE:
-         emit_compute_state(state);
-         handle_dispatch_base(cmd, state);
-         break;
-      case VK_CMD_DISPATCH_INDIRECT:
-         emit_compute_state(state);
-         handle_dispatch_indirect(cmd, state);
-         break;
-      case VK_CMD_COPY_BUFFER2:
-         handle_copy_buffer(cmd, state);
-         break;
-      case VK_CMD_COPY_IMAGE2:
-         handle_copy_image(cmd, state);
-         break;
-      case VK_CMD_BLIT_IMAGE2:
-         handle_blit_image(cmd, state);
-         break;
-      case VK_CMD_COPY_BUFFER_TO_IMAGE2:
-         handle_copy_buffer_to_image(cmd, state);
-         break;
-      case VK_CMD_COPY_IMAGE_TO_BUFFER2:
-         handle_copy_image_to_buffer2(cmd, state);
-         break;
-      case VK_CMD_UPDATE_BUFFER:
-         handle_update_buffer(cmd, state);
-         break;
-      case VK_CMD_FILL_BUFFER:
-         handle_fill_buffer(cmd, state);
-         break;
-      case VK_CMD_CLEAR_COLOR_IMAGE:
-         handle_clear_color_image(cmd, state);
-         break;
-      case VK_CMD_CLEAR_DEPTH_STENCIL_IMAGE:
-         handle_clear_ds_image(cmd, state);
-         break;
-      case VK_CMD_CLEAR_ATTACHMENTS:
-         handle_clear_attachments(cmd, state);
-         break;
-      case VK_CMD_RESOLVE_IMAGE2:
-         handle_resolve_image(cmd, state);
-         break;
-      case VK_CMD_PIPELINE_BARRIER2:
-         /* flushes are actually stalls, so multiple flushes are redundant */
-         if (did_flush)
-            continue;
-         handle_pipeline_barrier(cmd, state);
-         did_flush = true;
-         continue;
-      case VK_CMD_BEGIN_QUERY_INDEXED_EXT:
-         handle_begin_query_indexed_ext(cmd, state);
-         break;
-      case VK_CMD_END_QUERY_INDEXED_EXT:
-         handle_end_query_indexed_ext(cmd, state);
-         break;
-      case VK_CMD_BEGIN_QUERY:
-         handle_begin_query(cmd, state);
-         break;
-      case VK_CMD_END_QUERY:
-         handle_end_query(cmd, state);
-         break;
-      case VK_CMD_RESET_QUERY_POOL:
-         handle_reset_query_pool(cmd, state);
-         break;
-      case VK_CMD_COPY_QUERY_POOL_RESULTS:
-         handle_copy_query_pool_results(cmd, state);
-         break;
-      case VK_CMD_PUSH_CONSTANTS:
-         handle_push_constants(cmd, state);
-         break;
-      case VK_CMD_EXECUTE_COMMANDS:
-         handle_execute_commands(cmd, state, print_cmds);
-         break;
-      case VK_CMD_DRAW_INDIRECT_COUNT:
-         emit_state(state);
-         handle_draw_indirect_count(cmd, state, false);
-         break;
-      case VK_CMD_DRAW_INDEXED_INDIRECT_COUNT:
-         emit_state(state);
-         handle_draw_indirect_count(cmd, state, true);
-         break;
-      case VK_CMD_PUSH_DESCRIPTOR_SET_KHR:
-         handle_push_descriptor_set(cmd, state);
-         break;
-      case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE_KHR:
-         handle_push_descriptor_set_with_template(cmd, state);
-         break;
-      case VK_CMD_BIND_TRANSFORM_FEEDBACK_BUFFERS_EXT:
-         handle_bind_transform_feedback_buffers(cmd, state);
-         break;
-      case VK_CMD_BEGIN_TRANSFORM_FEEDBACK_EXT:
-         handle_begin_transform_feedback(cmd, state);
-         break;
-      case VK_CMD_END_TRANSFORM_FEEDBACK_EXT:
-         handle_end_transform_feedback(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDIRECT_BYTE_COUNT_EXT:
-         emit_state(state);
-         handle_draw_indirect_byte_count(cmd, state);
-         break;
-      case VK_CMD_BEGIN_CONDITIONAL_RENDERING_EXT:
-         handle_begin_conditional_rendering(cmd, state);
-         break;
-      case VK_CMD_END_CONDITIONAL_RENDERING_EXT:
-         handle_end_conditional_rendering(state);
-         break;
-      case VK_CMD_SET_VERTEX_INPUT_EXT:
-         handle_set_vertex_input(cmd, state);
-         break;
-      case VK_CMD_SET_CULL_MODE:
-         handle_set_cull_mode(cmd, state);
-         break;
-      case VK_CMD_SET_FRONT_FACE:
-         handle_set_front_face(cmd, state);
-         break;
-      case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
-         handle_set_primitive_topology(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_TEST_ENABLE:
-         handle_set_depth_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_WRITE_ENABLE:
-         handle_set_depth_write_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_COMPARE_OP:
-         handle_set_depth_compare_op(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
-         handle_set_depth_bounds_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_TEST_ENABLE:
-         handle_set_stencil_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_OP:
-         handle_set_stencil_op(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_STIPPLE_EXT:
-         handle_set_line_stipple(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BIAS_ENABLE:
-         handle_set_depth_bias_enable(cmd, state);
-         break;
-      case VK_CMD_SET_LOGIC_OP_EXT:
-         handle_set_logic_op(cmd, state);
-         break;
-      case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
-         handle_set_patch_control_points(cmd, state);
-         break;
-      case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
-         handle_set_primitive_restart_enable(cmd, state);
-         break;
-      case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
-         handle_set_rasterizer_discard_enable(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_WRITE_ENABLE_EXT:
-         handle_set_color_write_enable(cmd, state);
-         break;
-      case VK_CMD_BEGIN_RENDERING:
-         handle_begin_rendering(cmd, state);
-         break;
-      case VK_CMD_END_RENDERING:
-         handle_end_rendering(cmd, state);
-         break;
-      case VK_CMD_SET_DEVICE_MASK:
-         /* no-op */
-         break;
-      case VK_CMD_RESET_EVENT2:
-         handle_event_reset2(cmd, state);
-         break;
-      case VK_CMD_SET_EVENT2:
-         handle_event_set2(cmd, state);
-         break;
-      case VK_CMD_WAIT_EVENTS2:
-         handle_wait_events2(cmd, state);
-         break;
-      case VK_CMD_WRITE_TIMESTAMP2:
-         handle_write_timestamp2(cmd, state);
-         break;
-      case VK_CMD_SET_POLYGON_MODE_EXT:
-         handle_set_polygon_mode(cmd, state);
-         break;
-      case VK_CMD_SET_TESSELLATION_DOMAIN_ORIGIN_EXT:
-         handle_set_tessellation_domain_origin(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT:
-         handle_set_depth_clamp_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
-         handle_set_depth_clip_enable(cmd, state);
-         break;
-      case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
-         handle_set_logic_op_enable(cmd, state);
-         break;
-      case VK_CMD_SET_SAMPLE_MASK_EXT:
-         handle_set_sample_mask(cmd, state);
-         break;
-      case VK_CMD_SET_RASTERIZATION_SAMPLES_EXT:
-         handle_set_samples(cmd, state);
-         break;
-      case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
-         handle_set_alpha_to_coverage(cmd, state);
-         break;
-      case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
-         handle_set_alpha_to_one(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
-         handle_set_halfz(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
-         handle_set_line_rasterization_mode(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
-         handle_set_line_stipple_enable(cmd, state);
-         break;
-      case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
-         handle_set_provoking_vertex_mode(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_BLEND_ENABLE_EXT:
-         handle_set_color_blend_enable(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_WRITE_MASK_EXT:
-         handle_set_color_write_mask(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_BLEND_EQUATION_EXT:
-         handle_set_color_blend_equation(cmd, state);
-         break;
-      case VK_CMD_BIND_SHADERS_EXT:
-         handle_shaders(cmd, state);
-         break;
-      case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks(cmd, state);
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_INDIRECT_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks_indirect(cmd, state);
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_INDIRECT_COUNT_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks_indirect_count(cmd, state);
-         break;
-      case VK_CMD_BIND_PIPELINE_SHADER_GROUP_NV:
-         handle_graphics_pipeline_group(cmd, state);
-         break;
-      case VK_CMD_PREPROCESS_GENERATED_COMMANDS_NV:
-         handle_preprocess_generated_commands(cmd, state);
-         break;
-      case VK_CMD_EXECUTE_GENERATED_COMMANDS_NV:
-         handle_execute_generated_commands(cmd, state, print_cmds);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_BUFFERS_EXT:
-         handle_descriptor_buffers(cmd, state);
-         break;
-      case VK_CMD_SET_DESCRIPTOR_BUFFER_OFFSETS_EXT:
-         handle_descriptor_buffer_offsets(cmd, state);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_BUFFER_EMBEDDED_SAMPLERS_EXT:
-         handle_descriptor_buffer_embedded_samplers(cmd, state);
-         break;
-#ifdef VK_ENABLE_BETA_EXTENSIONS
-      case VK_CMD_INITIALIZE_GRAPH_SCRATCH_MEMORY_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_INDIRECT_COUNT_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_INDIRECT_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_AMDX:
-         handle_dispatch_graph(cmd, state);
-         break;
-#endif
-      default:
-         fprintf(stderr, "Unsupported command %s\n", vk_cmd_queue_type_names[cmd->type]);
-         unreachable("Unsupported command");
-         break;
-      }
-      did_flush = false;
+      const bool is_flush = cmd->type == VK_CMD_PIPELINE_BARRIER2;
+
+      /* flushes are actually stalls, so multiple flushes are redundant */
+      if (!is_flush || !did_flush)
+         lvp_execute_cmd(cmd, state, print_cmds);
+      did_flush = is_flush;
       if (!cmd->cmd_link.next)
          break;
    }
 }
 
+/* Dynamic state commands which only overwrite their own fields of the
+ * rendering state, whatever the state was before, so that of several of
+ * the same type with nothing else but other such commands in between,
+ * only the last one needs to be executed.
+ */
+static bool
+cmd_is_overridable_state(enum vk_cmd_type type)
+{
+   switch (type) {
+   case VK_CMD_SET_LINE_WIDTH:
+   case VK_CMD_SET_DEPTH_BIAS:
+   case VK_CMD_SET_BLEND_CONSTANTS:
+   case VK_CMD_SET_DEPTH_BOUNDS:
+   case VK_CMD_SET_CULL_MODE:
+   case VK_CMD_SET_FRONT_FACE:
+   case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
+   case VK_CMD_SET_DEPTH_TEST_ENABLE:
+   case VK_CMD_SET_DEPTH_WRITE_ENABLE:
+   case VK_CMD_SET_DEPTH_COMPARE_OP:
+   case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
+   case VK_CMD_SET_STENCIL_TEST_ENABLE:
+   case VK_CMD_SET_LINE_STIPPLE_EXT:
+   case VK_CMD_SET_DEPTH_BIAS_ENABLE:
+   case VK_CMD_SET_LOGIC_OP_EXT:
+   case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
+   case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
+   case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
+   case VK_CMD_SET_POLYGON_MODE_EXT:
+   case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
+   case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
+   case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
+   case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
+   case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
+   case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
+      return true;
+   default:
+      return false;
+   }
+}
+
+struct cmd_stream_builder {
+   struct util_dynarray *stream;
+   /* first entry of the current run of overridable state commands */
+   unsigned run_start;
+   bool oom;
+};
+
+static void
+cmd_stream_add(struct cmd_stream_builder *b, struct vk_cmd_queue_entry *cmd)
+{
+   struct vk_cmd_queue_entry **entries = b->stream->data;
+   unsigned count = util_dynarray_num_elements(b->stream, struct vk_cmd_queue_entry *);
+
+   switch (cmd->type) {
+   case VK_CMD_SET_DEVICE_MASK:
+   case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
+      /* no-op */
+      return;
+   case VK_CMD_PIPELINE_BARRIER2:
+      /* flushes are actually stalls, so multiple flushes are redundant */
+      if (count && entries[count - 1]->type == VK_CMD_PIPELINE_BARRIER2)
+         return;
+      break;
+   case VK_CMD_EXECUTE_COMMANDS: {
+      bool inlined = true;
+      for (unsigned i = 0; i < cmd->u.execute_commands.command_buffer_count; i++) {
+         LVP_FROM_HANDLE(lvp_cmd_buffer, secondary, cmd->u.execute_commands.command_buffers[i]);
+         inlined &= secondary->stream_valid;
+      }
+      /* A secondary has to be re-recorded along with every primary it's
+       * executed from, so it can be inlined here.
+       */
+      if (inlined) {
+         for (unsigned i = 0; i < cmd->u.execute_commands.command_buffer_count; i++) {
+            LVP_FROM_HANDLE(lvp_cmd_buffer, secondary, cmd->u.execute_commands.command_buffers[i]);
+            util_dynarray_foreach(&secondary->stream, struct vk_cmd_queue_entry *, sec_cmd)
+               cmd_stream_add(b, *sec_cmd);
+         }
+         return;
+      }
+      break;
+   }
+   default:
+      break;
+   }
+
+   if (cmd_is_overridable_state(cmd->type)) {
+      for (unsigned i = b->run_start; i < count; i++) {
+         if (entries[i]->type == cmd->type) {
+            entries[i] = cmd;
+            return;
+         }
+      }
+   }
+
+   struct vk_cmd_queue_entry **entry =
+      util_dynarray_grow(b->stream, struct vk_cmd_queue_entry *, 1);
+   if (!entry) {
+      b->oom = true;
+      return;
+   }
+   *entry = cmd;
+
+   if (!cmd_is_overridable_state(cmd->type))
+      b->run_start = count + 1;
+}
+
+/* Flatten the command list into an array, inlining secondary command
+ * buffers and dropping commands which would have no effect, so that
+ * command buffers which are submitted over and over don't pay for this
+ * every time.
+ */
+void
+lvp_compile_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer)
+{
+   struct cmd_stream_builder b = {
+      .stream = &cmd_buffer->stream,
+      .run_start = 0,
+      .oom = false,
+   };
+   struct vk_cmd_queue_entry *cmd;
+
+   util_dynarray_clear(&cmd_buffer->stream);
+
+   LIST_FOR_EACH_ENTRY(cmd, &cmd_buffer->vk.cmd_queue.cmds, cmd_link)
+      cmd_stream_add(&b, cmd);
+
+   /* If that failed to allocate, just walk the list. */
+   cmd_buffer->stream_valid = !b.oom;
+}
+
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer)
@@ -4807,7 +5106,12 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    state->blend_state.independent_blend_enable = true;
 
    /* create a gallium context */
-   lvp_execute_cmd_buffer(&cmd_buffer->vk.cmd_queue.cmds, state, device->print_cmds);
+   if (cmd_buffer->stream_valid) {
+      util_dynarray_foreach(&cmd_buffer->stream, struct vk_cmd_queue_entry *, cmd)
+         lvp_execute_cmd(*cmd, state, device->print_cmds);
+   } else {
+      lvp_execute_cmd_buffer(&cmd_buffer->vk.cmd_queue.cmds, state, device->print_cmds);
+   }
 
    state->start_vb = -1;
    state->num_vb = 0;
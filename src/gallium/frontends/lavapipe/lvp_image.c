@@ -683,10 +683,27 @@ lvp_CopyMemoryToImageEXT(VkDevice _device, const VkCopyMemoryToImageInfoEXT *pCo
          break;
       }
 
-      unsigned stride = util_format_get_stride(image->planes[plane].bo->format, copy->memoryRowLength ? copy->memoryRowLength : box.width);
-      unsigned layer_stride = util_format_get_2d_size(image->planes[plane].bo->format, stride, copy->memoryImageHeight ? copy->memoryImageHeight : box.height);
-      device->queue.ctx->texture_subdata(device->queue.ctx, image->planes[plane].bo, copy->imageSubresource.mipLevel, 0,
-                                         &box, copy->pHostPointer, stride, layer_stride);
+      /* The application guarantees the image is not in use, write straight
+       * into its backing instead of going through texture_subdata().
+       */
+      struct pipe_transfer *xfer;
+      uint8_t *data = device->queue.ctx->texture_map(device->queue.ctx, image->planes[plane].bo, copy->imageSubresource.mipLevel,
+                                                     PIPE_MAP_WRITE | PIPE_MAP_DISCARD_RANGE | PIPE_MAP_UNSYNCHRONIZED | PIPE_MAP_THREAD_SAFE,
+                                                     &box, &xfer);
+      if (!data)
+         return VK_ERROR_MEMORY_MAP_FAILED;
+
+      unsigned stride, layer_stride;
+      if (pCopyMemoryToImageInfo->flags & VK_HOST_IMAGE_COPY_MEMCPY_EXT) {
+         stride = xfer->stride;
+         layer_stride = xfer->layer_stride;
+      } else {
+         stride = util_format_get_stride(image->planes[plane].bo->format, copy->memoryRowLength ? copy->memoryRowLength : box.width);
+         layer_stride = util_format_get_2d_size(image->planes[plane].bo->format, stride, copy->memoryImageHeight ? copy->memoryImageHeight : box.height);
+      }
+      lvp_copy_box(device, image->planes[plane].bo->format, data, xfer->stride, xfer->layer_stride,
+                   copy->pHostPointer, stride, layer_stride, box.width, box.height, box.depth);
+      pipe_texture_unmap(device->queue.ctx, xfer);
    }
    return VK_SUCCESS;
 }
@@ -733,11 +750,17 @@ lvp_CopyImageToMemoryEXT(VkDevice _device, const VkCopyImageToMemoryInfoEXT *pCo
       if (!data)
          return VK_ERROR_MEMORY_MAP_FAILED;
 
-      unsigned stride = util_format_get_stride(image->planes[plane].bo->format, copy->memoryRowLength ? copy->memoryRowLength : box.width);
-      unsigned layer_stride = util_format_get_2d_size(image->planes[plane].bo->format, stride, copy->memoryImageHeight ? copy->memoryImageHeight : box.height);
-      util_copy_box(copy->pHostPointer, image->planes[plane].bo->format, stride, layer_stride,
-                    /* offsets are all zero because texture_map handles the offset */
-                    0, 0, 0, box.width, box.height, box.depth, data, xfer->stride, xfer->layer_stride, 0, 0, 0);
+      unsigned stride, layer_stride;
+      if (pCopyImageToMemoryInfo->flags & VK_HOST_IMAGE_COPY_MEMCPY_EXT) {
+         stride = xfer->stride;
+         layer_stride = xfer->layer_stride;
+      } else {
+         stride = util_format_get_stride(image->planes[plane].bo->format, copy->memoryRowLength ? copy->memoryRowLength : box.width);
+         layer_stride = util_format_get_2d_size(image->planes[plane].bo->format, stride, copy->memoryImageHeight ? copy->memoryImageHeight : box.height);
+      }
+      /* offsets are all zero because texture_map handles the offset */
+      lvp_copy_box(device, image->planes[plane].bo->format, copy->pHostPointer, stride, layer_stride,
+                   data, xfer->stride, xfer->layer_stride, box.width, box.height, box.depth);
       pipe_texture_unmap(device->queue.ctx, xfer);
    }
    return VK_SUCCESS;
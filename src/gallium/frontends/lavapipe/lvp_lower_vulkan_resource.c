@@ -63,6 +63,14 @@ static nir_def *lower_vri_intrin_vri(struct nir_builder *b,
    const struct lvp_descriptor_set_binding_layout *binding =
       get_binding_layout(data_cb, desc_set_idx, binding_idx);
 
+   /* Acceleration structures are a single 64-bit address, so their index
+    * is packed into one 64-bit value.
+    */
+   if (nir_intrinsic_desc_type(intrin) == VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR) {
+      return nir_pack_64_2x32_split(b, nir_imm_int(b, desc_set_idx + 1),
+                                    nir_iadd_imm(b, intrin->src[0].ssa, binding->descriptor_index));
+   }
+
    return nir_vec3(b, nir_imm_int(b, desc_set_idx + 1),
                    nir_iadd_imm(b, intrin->src[0].ssa, binding->descriptor_index),
                    nir_imm_int(b, 0));
@@ -74,6 +82,12 @@ static nir_def *lower_vri_intrin_vrri(struct nir_builder *b,
    nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
    nir_def *old_index = intrin->src[0].ssa;
    nir_def *delta = intrin->src[1].ssa;
+
+   if (nir_intrinsic_desc_type(intrin) == VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR) {
+      return nir_pack_64_2x32_split(b, nir_unpack_64_2x32_split_x(b, old_index),
+                                    nir_iadd(b, nir_unpack_64_2x32_split_y(b, old_index), delta));
+   }
+
    return nir_vec3(b, nir_channel(b, old_index, 0),
                    nir_iadd(b, nir_channel(b, old_index, 1), delta),
                    nir_channel(b, old_index, 2));
@@ -83,6 +97,19 @@ static nir_def *lower_vri_intrin_lvd(struct nir_builder *b,
                                          nir_instr *instr, void *data_cb)
 {
    nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+
+   /* The address is at the start of the descriptor, see
+    * lvp_write_acceleration_structure_descriptor().
+    */
+   if (nir_intrinsic_desc_type(intrin) == VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR) {
+      nir_def *index = intrin->src[0].ssa;
+      nir_def *offset = nir_imul_imm(b, nir_unpack_64_2x32_split_y(b, index),
+                                     sizeof(struct lp_descriptor));
+      nir_def *addr = nir_load_ubo(b, 2, 32, nir_unpack_64_2x32_split_x(b, index), offset,
+                                   .align_mul = 8, .align_offset = 0, .range = ~0);
+      return nir_pack_64_2x32(b, addr);
+   }
+
    return intrin->src[0].ssa;
 }
 
@@ -0,0 +1,956 @@
+/*
+ * Copyright © 2022 Konstantin Seurer
+ * Copyright © 2026 agent
+ *
+ * Derived from src/amd/vulkan/nir/radv_nir_lower_ray_queries.c, adapted
+ * to the lavapipe BVH layout.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "lvp_private.h"
+#include "lvp_acceleration_structure.h"
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "compiler/spirv/spirv.h"
+#include "util/hash_table.h"
+
+/*
+ * Lowers ray queries to a plain software traversal of the BVH built by
+ * lvp_acceleration_structure.c.
+ *
+ * The whole query state lives in shader_temp variables, which gallivm keeps
+ * in registers, i.e. one lane per invocation.  The traversal is a stack
+ * based depth first walk, nearest child first, testing a ray against all
+ * four children of a box node at once.
+ */
+
+typedef struct {
+   nir_variable *variable;
+   unsigned array_length;
+} rq_variable;
+
+static rq_variable *
+rq_variable_create(void *ctx, nir_shader *shader, unsigned array_length, const struct glsl_type *type, const char *name)
+{
+   rq_variable *result = ralloc(ctx, rq_variable);
+   result->array_length = array_length;
+
+   const struct glsl_type *variable_type = type;
+   if (array_length != 1)
+      variable_type = glsl_array_type(type, array_length, glsl_get_explicit_stride(type));
+
+   result->variable = nir_variable_create(shader, nir_var_shader_temp, variable_type, name);
+
+   return result;
+}
+
+static nir_def *
+nir_load_array(nir_builder *b, nir_variable *array, nir_def *index)
+{
+   return nir_load_deref(b, nir_build_deref_array(b, nir_build_deref_var(b, array), index));
+}
+
+static void
+nir_store_array(nir_builder *b, nir_variable *array, nir_def *index, nir_def *value, unsigned writemask)
+{
+   nir_store_deref(b, nir_build_deref_array(b, nir_build_deref_var(b, array), index), value, writemask);
+}
+
+static nir_def *
+rq_load_var(nir_builder *b, nir_def *index, rq_variable *var)
+{
+   if (var->array_length == 1)
+      return nir_load_var(b, var->variable);
+
+   return nir_load_array(b, var->variable, index);
+}
+
+static void
+rq_store_var(nir_builder *b, nir_def *index, rq_variable *var, nir_def *value, unsigned writemask)
+{
+   if (var->array_length == 1) {
+      nir_store_var(b, var->variable, value, writemask);
+   } else {
+      nir_store_array(b, var->variable, index, value, writemask);
+   }
+}
+
+static void
+rq_copy_var(nir_builder *b, nir_def *index, rq_variable *dst, rq_variable *src, unsigned mask)
+{
+   rq_store_var(b, index, dst, rq_load_var(b, index, src), mask);
+}
+
+static nir_deref_instr *
+rq_deref_array(nir_builder *b, nir_def *index, rq_variable *var, nir_def *array_index)
+{
+   nir_deref_instr *deref = nir_build_deref_var(b, var->variable);
+   if (var->array_length != 1)
+      deref = nir_build_deref_array(b, deref, index);
+
+   return nir_build_deref_array(b, deref, array_index);
+}
+
+struct ray_query_traversal_vars {
+   /* The ray in the space of the structure being traversed. */
+   rq_variable *origin;
+   rq_variable *direction;
+
+   rq_variable *bvh_base;
+   rq_variable *stack;
+   rq_variable *stack_ptr;
+   /* Stack pointer when the current instance was entered, or
+    * LVP_BVH_INVALID_NODE while traversing the top level.
+    */
+   rq_variable *instance_stack_base;
+   rq_variable *current_node;
+};
+
+struct ray_query_intersection_vars {
+   rq_variable *primitive_id;
+   rq_variable *geometry_id_and_flags;
+   rq_variable *instance_addr;
+   rq_variable *intersection_type;
+   rq_variable *opaque;
+   rq_variable *frontface;
+   rq_variable *sbt_offset_and_flags;
+   rq_variable *barycentrics;
+   rq_variable *t;
+};
+
+struct ray_query_vars {
+   rq_variable *root_bvh_base;
+   rq_variable *flags;
+   rq_variable *cull_mask;
+   rq_variable *origin;
+   rq_variable *tmin;
+   rq_variable *direction;
+
+   rq_variable *incomplete;
+
+   struct ray_query_intersection_vars closest;
+   struct ray_query_intersection_vars candidate;
+
+   struct ray_query_traversal_vars trav;
+};
+
+#define VAR_NAME(name) strcat(strcpy(ralloc_size(ctx, strlen(base_name) + strlen(name) + 1), base_name), name)
+
+static struct ray_query_traversal_vars
+init_ray_query_traversal_vars(void *ctx, nir_shader *shader, unsigned array_length, const char *base_name)
+{
+   struct ray_query_traversal_vars result;
+
+   const struct glsl_type *vec3_type = glsl_vector_type(GLSL_TYPE_FLOAT, 3);
+
+   result.origin = rq_variable_create(ctx, shader, array_length, vec3_type, VAR_NAME("_origin"));
+   result.direction = rq_variable_create(ctx, shader, array_length, vec3_type, VAR_NAME("_direction"));
+
+   result.bvh_base = rq_variable_create(ctx, shader, array_length, glsl_uint64_t_type(), VAR_NAME("_bvh_base"));
+   result.stack = rq_variable_create(ctx, shader, array_length,
+                                     glsl_array_type(glsl_uint_type(), LVP_BVH_STACK_SIZE, 0), VAR_NAME("_stack"));
+   result.stack_ptr = rq_variable_create(ctx, shader, array_length, glsl_uint_type(), VAR_NAME("_stack_ptr"));
+   result.instance_stack_base =
+      rq_variable_create(ctx, shader, array_length, glsl_uint_type(), VAR_NAME("_instance_stack_base"));
+   result.current_node = rq_variable_create(ctx, shader, array_length, glsl_uint_type(), VAR_NAME("_current_node"));
+   return result;
+}
+
+static struct ray_query_intersection_vars
+init_ray_query_intersection_vars(void *ctx, nir_shader *shader, unsigned array_length, const char *base_name)
+{
+   struct ray_query_intersection_vars result;
+
+   const struct glsl_type *vec2_type = glsl_vector_type(GLSL_TYPE_FLOAT, 2);
+
+   result.primitive_id = rq_variable_create(ctx, shader, array_length, glsl_uint_type(), VAR_NAME("_primitive_id"));
+   result.geometry_id_and_flags =
+      rq_variable_create(ctx, shader, array_length, glsl_uint_type(), VAR_NAME("_geometry_id_and_flags"));
+   result.instance_addr =
+      rq_variable_create(ctx, shader, array_length, glsl_uint64_t_type(), VAR_NAME("_instance_addr"));
+   result.intersection_type =
+      rq_variable_create(ctx, shader, array_length, glsl_uint_type(), VAR_NAME("_intersection_type"));
+   result.opaque = rq_variable_create(ctx, shader, array_length, glsl_bool_type(), VAR_NAME("_opaque"));
+   result.frontface = rq_variable_create(ctx, shader, array_length, glsl_bool_type(), VAR_NAME("_frontface"));
+   result.sbt_offset_and_flags =
+      rq_variable_create(ctx, shader, array_length, glsl_uint_type(), VAR_NAME("_sbt_offset_and_flags"));
+   result.barycentrics = rq_variable_create(ctx, shader, array_length, vec2_type, VAR_NAME("_barycentrics"));
+   result.t = rq_variable_create(ctx, shader, array_length, glsl_float_type(), VAR_NAME("_t"));
+
+   return result;
+}
+
+static void
+init_ray_query_vars(nir_shader *shader, unsigned array_length, struct ray_query_vars *dst, const char *base_name)
+{
+   void *ctx = dst;
+   const struct glsl_type *vec3_type = glsl_vector_type(GLSL_TYPE_FLOAT, 3);
+
+   dst->root_bvh_base = rq_variable_create(dst, shader, array_length, glsl_uint64_t_type(), VAR_NAME("_root_bvh_base"));
+   dst->flags = rq_variable_create(dst, shader, array_length, glsl_uint_type(), VAR_NAME("_flags"));
+   dst->cull_mask = rq_variable_create(dst, shader, array_length, glsl_uint_type(), VAR_NAME("_cull_mask"));
+   dst->origin = rq_variable_create(dst, shader, array_length, vec3_type, VAR_NAME("_origin"));
+   dst->tmin = rq_variable_create(dst, shader, array_length, glsl_float_type(), VAR_NAME("_tmin"));
+   dst->direction = rq_variable_create(dst, shader, array_length, vec3_type, VAR_NAME("_direction"));
+
+   dst->incomplete = rq_variable_create(dst, shader, array_length, glsl_bool_type(), VAR_NAME("_incomplete"));
+
+   dst->closest = init_ray_query_intersection_vars(dst, shader, array_length, VAR_NAME("_closest"));
+   dst->candidate = init_ray_query_intersection_vars(dst, shader, array_length, VAR_NAME("_candidate"));
+
+   dst->trav = init_ray_query_traversal_vars(dst, shader, array_length, VAR_NAME("_trav"));
+}
+
+#undef VAR_NAME
+
+static void
+lower_ray_query(nir_shader *shader, nir_variable *ray_query, struct hash_table *ht)
+{
+   struct ray_query_vars *vars = ralloc(ht, struct ray_query_vars);
+
+   unsigned array_length = 1;
+   if (glsl_type_is_array(ray_query->type))
+      array_length = glsl_get_length(ray_query->type);
+
+   init_ray_query_vars(shader, array_length, vars, ray_query->name == NULL ? "" : ray_query->name);
+
+   _mesa_hash_table_insert(ht, ray_query, vars);
+}
+
+enum rq_intersection_type { intersection_type_none, intersection_type_triangle, intersection_type_aabb };
+
+static void
+copy_candidate_to_closest(nir_builder *b, nir_def *index, struct ray_query_vars *vars)
+{
+   rq_copy_var(b, index, vars->closest.barycentrics, vars->candidate.barycentrics, 0x3);
+   rq_copy_var(b, index, vars->closest.geometry_id_and_flags, vars->candidate.geometry_id_and_flags, 0x1);
+   rq_copy_var(b, index, vars->closest.instance_addr, vars->candidate.instance_addr, 0x1);
+   rq_copy_var(b, index, vars->closest.intersection_type, vars->candidate.intersection_type, 0x1);
+   rq_copy_var(b, index, vars->closest.opaque, vars->candidate.opaque, 0x1);
+   rq_copy_var(b, index, vars->closest.frontface, vars->candidate.frontface, 0x1);
+   rq_copy_var(b, index, vars->closest.sbt_offset_and_flags, vars->candidate.sbt_offset_and_flags, 0x1);
+   rq_copy_var(b, index, vars->closest.primitive_id, vars->candidate.primitive_id, 0x1);
+   rq_copy_var(b, index, vars->closest.t, vars->candidate.t, 0x1);
+}
+
+static void
+insert_terminate_on_first_hit(nir_builder *b, nir_def *index, struct ray_query_vars *vars, bool break_on_terminate)
+{
+   nir_push_if(b, nir_test_mask(b, rq_load_var(b, index, vars->flags), SpvRayFlagsTerminateOnFirstHitKHRMask));
+   {
+      rq_store_var(b, index, vars->incomplete, nir_imm_false(b), 0x1);
+      if (break_on_terminate)
+         nir_jump(b, nir_jump_break);
+   }
+   nir_pop_if(b, NULL);
+}
+
+static void
+lower_rq_confirm_intersection(nir_builder *b, nir_def *index, nir_intrinsic_instr *instr, struct ray_query_vars *vars)
+{
+   copy_candidate_to_closest(b, index, vars);
+   insert_terminate_on_first_hit(b, index, vars, false);
+}
+
+static void
+lower_rq_generate_intersection(nir_builder *b, nir_def *index, nir_intrinsic_instr *instr, struct ray_query_vars *vars)
+{
+   nir_push_if(b, nir_iand(b, nir_fge(b, rq_load_var(b, index, vars->closest.t), instr->src[1].ssa),
+                           nir_fge(b, instr->src[1].ssa, rq_load_var(b, index, vars->tmin))));
+   {
+      copy_candidate_to_closest(b, index, vars);
+      insert_terminate_on_first_hit(b, index, vars, false);
+      rq_store_var(b, index, vars->closest.t, instr->src[1].ssa, 0x1);
+   }
+   nir_pop_if(b, NULL);
+}
+
+static void
+lower_rq_initialize(nir_builder *b, nir_def *index, nir_intrinsic_instr *instr, struct ray_query_vars *vars)
+{
+   rq_store_var(b, index, vars->flags, instr->src[2].ssa, 0x1);
+   rq_store_var(b, index, vars->cull_mask, nir_iand_imm(b, instr->src[3].ssa, 0xff), 0x1);
+
+   rq_store_var(b, index, vars->origin, instr->src[4].ssa, 0x7);
+   rq_store_var(b, index, vars->trav.origin, instr->src[4].ssa, 0x7);
+
+   rq_store_var(b, index, vars->tmin, instr->src[5].ssa, 0x1);
+
+   rq_store_var(b, index, vars->direction, instr->src[6].ssa, 0x7);
+   rq_store_var(b, index, vars->trav.direction, instr->src[6].ssa, 0x7);
+
+   rq_store_var(b, index, vars->closest.t, instr->src[7].ssa, 0x1);
+   rq_store_var(b, index, vars->closest.intersection_type, nir_imm_int(b, intersection_type_none), 0x1);
+   rq_store_var(b, index, vars->candidate.intersection_type, nir_imm_int(b, intersection_type_none), 0x1);
+
+   nir_def *accel_struct = instr->src[1].ssa;
+
+   /* Keep instance data loads valid even if nothing is ever hit. */
+   rq_store_var(b, index, vars->closest.instance_addr, accel_struct, 0x1);
+   rq_store_var(b, index, vars->candidate.instance_addr, accel_struct, 0x1);
+
+   rq_store_var(b, index, vars->root_bvh_base, accel_struct, 0x1);
+   rq_store_var(b, index, vars->trav.bvh_base, accel_struct, 0x1);
+   rq_store_var(b, index, vars->trav.stack_ptr, nir_imm_int(b, 0), 0x1);
+   rq_store_var(b, index, vars->trav.instance_stack_base, nir_imm_int(b, LVP_BVH_INVALID_NODE), 0x1);
+
+   /* Null acceleration structures are allowed and never hit anything. */
+   nir_def *valid = nir_ine_imm(b, accel_struct, 0);
+   nir_push_if(b, valid);
+   nir_def *root = nir_build_load_global(b, 1, 32, nir_iadd_imm(b, accel_struct, offsetof(struct lvp_bvh_header, root)));
+   nir_pop_if(b, NULL);
+   root = nir_if_phi(b, root, nir_imm_int(b, LVP_BVH_INVALID_NODE));
+
+   rq_store_var(b, index, vars->trav.current_node, root, 0x1);
+   rq_store_var(b, index, vars->incomplete, valid, 0x1);
+}
+
+static void
+load_wto_matrix(nir_builder *b, nir_def *instance_addr, nir_def **out)
+{
+   for (unsigned r = 0; r < 3; r++) {
+      out[r] = nir_build_load_global(
+         b, 4, 32, nir_iadd_imm(b, instance_addr, offsetof(struct lvp_bvh_instance_node, wto_matrix) + r * 16));
+   }
+}
+
+static nir_def *
+mat3x4_mul(nir_builder *b, nir_def *vec, nir_def **matrix, bool translation)
+{
+   nir_def *result[3];
+   for (unsigned r = 0; r < 3; r++) {
+      result[r] = nir_fdot3(b, nir_trim_vector(b, matrix[r], 3), vec);
+      if (translation)
+         result[r] = nir_fadd(b, result[r], nir_channel(b, matrix[r], 3));
+   }
+   return nir_vec(b, result, 3);
+}
+
+static nir_def *
+lower_rq_load(nir_builder *b, nir_def *index, nir_intrinsic_instr *instr, struct ray_query_vars *vars)
+{
+   bool committed = nir_intrinsic_committed(instr);
+   struct ray_query_intersection_vars *intersection = committed ? &vars->closest : &vars->candidate;
+
+   uint32_t column = nir_intrinsic_column(instr);
+
+   nir_ray_query_value value = nir_intrinsic_ray_query_value(instr);
+   switch (value) {
+   case nir_ray_query_value_flags:
+      return rq_load_var(b, index, vars->flags);
+   case nir_ray_query_value_intersection_barycentrics:
+      return rq_load_var(b, index, intersection->barycentrics);
+   case nir_ray_query_value_intersection_candidate_aabb_opaque:
+      return nir_iand(b, rq_load_var(b, index, vars->candidate.opaque),
+                      nir_ieq_imm(b, rq_load_var(b, index, vars->candidate.intersection_type), intersection_type_aabb));
+   case nir_ray_query_value_intersection_front_face:
+      return rq_load_var(b, index, intersection->frontface);
+   case nir_ray_query_value_intersection_geometry_index:
+      return nir_iand_imm(b, rq_load_var(b, index, intersection->geometry_id_and_flags), LVP_GEOMETRY_ID_MASK);
+   case nir_ray_query_value_intersection_instance_custom_index: {
+      nir_def *instance_node_addr = rq_load_var(b, index, intersection->instance_addr);
+      return nir_iand_imm(
+         b,
+         nir_build_load_global(
+            b, 1, 32,
+            nir_iadd_imm(b, instance_node_addr, offsetof(struct lvp_bvh_instance_node, custom_instance_and_mask))),
+         0xFFFFFF);
+   }
+   case nir_ray_query_value_intersection_instance_id: {
+      nir_def *instance_node_addr = rq_load_var(b, index, intersection->instance_addr);
+      return nir_build_load_global(
+         b, 1, 32, nir_iadd_imm(b, instance_node_addr, offsetof(struct lvp_bvh_instance_node, instance_id)));
+   }
+   case nir_ray_query_value_intersection_instance_sbt_index:
+      return nir_iand_imm(b, rq_load_var(b, index, intersection->sbt_offset_and_flags), 0xFFFFFF);
+   case nir_ray_query_value_intersection_object_ray_direction: {
+      nir_def *instance_node_addr = rq_load_var(b, index, intersection->instance_addr);
+      nir_def *wto_matrix[3];
+      load_wto_matrix(b, instance_node_addr, wto_matrix);
+      return mat3x4_mul(b, rq_load_var(b, index, vars->direction), wto_matrix, false);
+   }
+   case nir_ray_query_value_intersection_object_ray_origin: {
+      nir_def *instance_node_addr = rq_load_var(b, index, intersection->instance_addr);
+      nir_def *wto_matrix[3];
+      load_wto_matrix(b, instance_node_addr, wto_matrix);
+      return mat3x4_mul(b, rq_load_var(b, index, vars->origin), wto_matrix, true);
+   }
+   case nir_ray_query_value_intersection_object_to_world: {
+      nir_def *instance_node_addr = rq_load_var(b, index, intersection->instance_addr);
+      nir_def *rows[3];
+      for (unsigned r = 0; r < 3; ++r)
+         rows[r] = nir_build_load_global(
+            b, 4, 32,
+            nir_iadd_imm(b, instance_node_addr, offsetof(struct lvp_bvh_instance_node, otw_matrix) + r * 16));
+
+      return nir_vec3(b, nir_channel(b, rows[0], column), nir_channel(b, rows[1], column),
+                      nir_channel(b, rows[2], column));
+   }
+   case nir_ray_query_value_intersection_primitive_index:
+      return rq_load_var(b, index, intersection->primitive_id);
+   case nir_ray_query_value_intersection_t:
+      return rq_load_var(b, index, intersection->t);
+   case nir_ray_query_value_intersection_type: {
+      nir_def *intersection_type = rq_load_var(b, index, intersection->intersection_type);
+      if (!committed)
+         intersection_type = nir_iadd_imm(b, intersection_type, -1);
+
+      return intersection_type;
+   }
+   case nir_ray_query_value_intersection_world_to_object: {
+      nir_def *instance_node_addr = rq_load_var(b, index, intersection->instance_addr);
+
+      nir_def *wto_matrix[3];
+      load_wto_matrix(b, instance_node_addr, wto_matrix);
+
+      nir_def *vals[3];
+      for (unsigned i = 0; i < 3; ++i)
+         vals[i] = nir_channel(b, wto_matrix[i], column);
+
+      return nir_vec(b, vals, 3);
+   }
+   case nir_ray_query_value_tmin:
+      return rq_load_var(b, index, vars->tmin);
+   case nir_ray_query_value_world_ray_direction:
+      return rq_load_var(b, index, vars->direction);
+   case nir_ray_query_value_world_ray_origin:
+      return rq_load_var(b, index, vars->origin);
+   default:
+      unreachable("Invalid nir_ray_query_value!");
+   }
+
+   return NULL;
+}
+
+struct traversal_state {
+   nir_def *index;
+   struct ray_query_vars *vars;
+
+   nir_def *flags;
+   nir_def *tmin;
+};
+
+static void
+push_node(nir_builder *b, struct traversal_state *state, nir_def *node)
+{
+   struct ray_query_vars *vars = state->vars;
+   nir_def *stack_ptr = rq_load_var(b, state->index, vars->trav.stack_ptr);
+
+   nir_store_deref(b, rq_deref_array(b, state->index, vars->trav.stack, stack_ptr), node, 0x1);
+   rq_store_var(b, state->index, vars->trav.stack_ptr, nir_iadd_imm(b, stack_ptr, 1), 0x1);
+}
+
+static nir_def *
+pop_node(nir_builder *b, struct traversal_state *state)
+{
+   struct ray_query_vars *vars = state->vars;
+   nir_def *stack_ptr = nir_iadd_imm(b, rq_load_var(b, state->index, vars->trav.stack_ptr), -1);
+
+   rq_store_var(b, state->index, vars->trav.stack_ptr, stack_ptr, 0x1);
+   return nir_load_deref(b, rq_deref_array(b, state->index, vars->trav.stack, stack_ptr));
+}
+
+static nir_def *
+test_ray_flag(nir_builder *b, struct traversal_state *state, uint32_t flag)
+{
+   return nir_test_mask(b, state->flags, flag);
+}
+
+static nir_def *
+hit_is_opaque(nir_builder *b, struct traversal_state *state, nir_def *geometry_id_and_flags)
+{
+   nir_def *instance_flags =
+      nir_ushr_imm(b, rq_load_var(b, state->index, state->vars->candidate.sbt_offset_and_flags), 24);
+
+   nir_def *opaque = nir_test_mask(b, geometry_id_and_flags, LVP_GEOMETRY_OPAQUE);
+   opaque = nir_bcsel(b, nir_test_mask(b, instance_flags, VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR),
+                      nir_imm_true(b), opaque);
+   opaque = nir_bcsel(b, nir_test_mask(b, instance_flags, VK_GEOMETRY_INSTANCE_FORCE_NO_OPAQUE_BIT_KHR),
+                      nir_imm_false(b), opaque);
+   opaque = nir_bcsel(b, test_ray_flag(b, state, SpvRayFlagsOpaqueKHRMask), nir_imm_true(b), opaque);
+   opaque = nir_bcsel(b, test_ray_flag(b, state, SpvRayFlagsNoOpaqueKHRMask), nir_imm_false(b), opaque);
+   return opaque;
+}
+
+static nir_def *
+opaque_not_culled(nir_builder *b, struct traversal_state *state, nir_def *opaque)
+{
+   return nir_bcsel(b, opaque,
+                    nir_inot(b, test_ray_flag(b, state, SpvRayFlagsCullOpaqueKHRMask)),
+                    nir_inot(b, test_ray_flag(b, state, SpvRayFlagsCullNoOpaqueKHRMask)));
+}
+
+/* Slab test of the ray against all four children at once, pushing every
+ * child hit but the nearest one, which is traversed next.
+ */
+static void
+visit_box(nir_builder *b, struct traversal_state *state, nir_def *node_addr)
+{
+   struct ray_query_vars *vars = state->vars;
+   nir_def *index = state->index;
+
+   nir_def *origin = rq_load_var(b, index, vars->trav.origin);
+   nir_def *inv_dir = nir_frcp(b, rq_load_var(b, index, vars->trav.direction));
+   nir_def *tmax = rq_load_var(b, index, vars->closest.t);
+
+   nir_def *tnear = nir_replicate(b, state->tmin, 4);
+   nir_def *tfar = nir_replicate(b, tmax, 4);
+
+   for (unsigned axis = 0; axis < 3; axis++) {
+      nir_def *min = nir_build_load_global(
+         b, 4, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_box_node, min_x) + axis * 16));
+      nir_def *max = nir_build_load_global(
+         b, 4, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_box_node, max_x) + axis * 16));
+
+      nir_def *o = nir_replicate(b, nir_channel(b, origin, axis), 4);
+      nir_def *inv = nir_replicate(b, nir_channel(b, inv_dir, axis), 4);
+
+      nir_def *t0 = nir_fmul(b, nir_fsub(b, min, o), inv);
+      nir_def *t1 = nir_fmul(b, nir_fsub(b, max, o), inv);
+
+      tnear = nir_fmax(b, tnear, nir_fmin(b, t0, t1));
+      tfar = nir_fmin(b, tfar, nir_fmax(b, t0, t1));
+   }
+
+   nir_def *children = nir_build_load_global(
+      b, 4, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_box_node, children)));
+   nir_def *hits = nir_iand(b, nir_fge(b, tfar, tnear), nir_ine_imm(b, children, LVP_BVH_INVALID_NODE));
+
+   nir_variable *best = nir_local_variable_create(b->impl, glsl_uint_type(), "best_child");
+   nir_variable *best_t = nir_local_variable_create(b->impl, glsl_float_type(), "best_child_t");
+   nir_store_var(b, best, nir_imm_int(b, LVP_BVH_INVALID_NODE), 0x1);
+   nir_store_var(b, best_t, nir_imm_float(b, INFINITY), 0x1);
+
+   for (unsigned i = 0; i < LVP_BVH_BOX_WIDTH; i++) {
+      nir_def *child = nir_channel(b, children, i);
+      nir_def *child_t = nir_channel(b, tnear, i);
+
+      nir_push_if(b, nir_channel(b, hits, i));
+      {
+         nir_push_if(b, nir_flt(b, child_t, nir_load_var(b, best_t)));
+         {
+            nir_def *prev = nir_load_var(b, best);
+            nir_push_if(b, nir_ine_imm(b, prev, LVP_BVH_INVALID_NODE));
+            push_node(b, state, prev);
+            nir_pop_if(b, NULL);
+
+            nir_store_var(b, best, child, 0x1);
+            nir_store_var(b, best_t, child_t, 0x1);
+         }
+         nir_push_else(b, NULL);
+         {
+            push_node(b, state, child);
+         }
+         nir_pop_if(b, NULL);
+      }
+      nir_pop_if(b, NULL);
+   }
+
+   rq_store_var(b, index, vars->trav.current_node, nir_load_var(b, best), 0x1);
+}
+
+/* Moves the ray into the instance's object space and continues with the
+ * root of its bottom level structure.
+ */
+static void
+visit_instance(nir_builder *b, struct traversal_state *state, nir_def *node_addr)
+{
+   struct ray_query_vars *vars = state->vars;
+   nir_def *index = state->index;
+
+   nir_def *info = nir_build_load_global(
+      b, 2, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_instance_node, custom_instance_and_mask)));
+   nir_def *mask = nir_ushr_imm(b, nir_channel(b, info, 0), 24);
+
+   nir_push_if(b, nir_ine_imm(b, nir_iand(b, mask, rq_load_var(b, index, vars->cull_mask)), 0));
+   {
+      nir_def *bvh_ptr = nir_build_load_global(
+         b, 1, 64, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_instance_node, bvh_ptr)));
+
+      nir_def *wto_matrix[3];
+      load_wto_matrix(b, node_addr, wto_matrix);
+
+      rq_store_var(b, index, vars->trav.origin,
+                   mat3x4_mul(b, rq_load_var(b, index, vars->origin), wto_matrix, true), 0x7);
+      rq_store_var(b, index, vars->trav.direction,
+                   mat3x4_mul(b, rq_load_var(b, index, vars->direction), wto_matrix, false), 0x7);
+      rq_store_var(b, index, vars->trav.bvh_base, bvh_ptr, 0x1);
+      rq_store_var(b, index, vars->trav.instance_stack_base,
+                   rq_load_var(b, index, vars->trav.stack_ptr), 0x1);
+
+      rq_store_var(b, index, vars->candidate.instance_addr, node_addr, 0x1);
+      rq_store_var(b, index, vars->candidate.sbt_offset_and_flags, nir_channel(b, info, 1), 0x1);
+
+      nir_def *root = nir_build_load_global(b, 1, 32, nir_iadd_imm(b, bvh_ptr, offsetof(struct lvp_bvh_header, root)));
+      rq_store_var(b, index, vars->trav.current_node, root, 0x1);
+   }
+   nir_pop_if(b, NULL);
+}
+
+/* Watertight ray/triangle intersection, see
+ * http://jcgt.org/published/0002/01/05/paper.pdf
+ */
+static void
+visit_triangle(nir_builder *b, struct traversal_state *state, nir_def *node_addr)
+{
+   struct ray_query_vars *vars = state->vars;
+   nir_def *index = state->index;
+
+   bool old_exact = b->exact;
+   b->exact = true;
+
+   nir_def *origin = rq_load_var(b, index, vars->trav.origin);
+   nir_def *dir = rq_load_var(b, index, vars->trav.direction);
+
+   nir_def *coords[3];
+   for (unsigned i = 0; i < 3; i++) {
+      coords[i] = nir_build_load_global(
+         b, 3, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_triangle_node, coords[i])));
+   }
+
+   /* The dimension where the ray direction is largest becomes z. */
+   nir_def *abs_dir = nir_fabs(b, dir);
+   nir_def *abs_dirs[3] = {
+      nir_channel(b, abs_dir, 0),
+      nir_channel(b, abs_dir, 1),
+      nir_channel(b, abs_dir, 2),
+   };
+   nir_def *kz = nir_bcsel(b, nir_fge(b, abs_dirs[0], abs_dirs[1]),
+                           nir_bcsel(b, nir_fge(b, abs_dirs[0], abs_dirs[2]), nir_imm_int(b, 0), nir_imm_int(b, 2)),
+                           nir_bcsel(b, nir_fge(b, abs_dirs[1], abs_dirs[2]), nir_imm_int(b, 1), nir_imm_int(b, 2)));
+   nir_def *kx = nir_imod_imm(b, nir_iadd_imm(b, kz, 1), 3);
+   nir_def *ky = nir_imod_imm(b, nir_iadd_imm(b, kx, 1), 3);
+
+   /* Swap kx and ky to preserve the winding order. */
+   nir_def *swap = nir_flt_imm(b, nir_vector_extract(b, dir, kz), 0.0f);
+   nir_def *tmp = kx;
+   kx = nir_bcsel(b, swap, ky, kx);
+   ky = nir_bcsel(b, swap, tmp, ky);
+
+   nir_def *sz = nir_frcp(b, nir_vector_extract(b, dir, kz));
+   nir_def *sx = nir_fmul(b, nir_vector_extract(b, dir, kx), sz);
+   nir_def *sy = nir_fmul(b, nir_vector_extract(b, dir, ky), sz);
+
+   nir_def *sheared_x[3], *sheared_y[3], *scaled_z[3];
+   for (unsigned i = 0; i < 3; i++) {
+      nir_def *v = nir_fsub(b, coords[i], origin);
+      nir_def *vz = nir_vector_extract(b, v, kz);
+      sheared_x[i] = nir_fsub(b, nir_vector_extract(b, v, kx), nir_fmul(b, sx, vz));
+      sheared_y[i] = nir_fsub(b, nir_vector_extract(b, v, ky), nir_fmul(b, sy, vz));
+      scaled_z[i] = nir_fmul(b, sz, vz);
+   }
+
+   nir_def *u = nir_fsub(b, nir_fmul(b, sheared_x[2], sheared_y[1]), nir_fmul(b, sheared_y[2], sheared_x[1]));
+   nir_def *v = nir_fsub(b, nir_fmul(b, sheared_x[0], sheared_y[2]), nir_fmul(b, sheared_y[0], sheared_x[2]));
+   nir_def *w = nir_fsub(b, nir_fmul(b, sheared_x[1], sheared_y[0]), nir_fmul(b, sheared_y[1], sheared_x[0]));
+
+   nir_def *cond_back = nir_ior(b, nir_ior(b, nir_flt_imm(b, u, 0.0f), nir_flt_imm(b, v, 0.0f)), nir_flt_imm(b, w, 0.0f));
+   nir_def *cond_front = nir_ior(b, nir_ior(b, nir_fgt_imm(b, u, 0.0f), nir_fgt_imm(b, v, 0.0f)), nir_fgt_imm(b, w, 0.0f));
+
+   nir_def *det = nir_fadd(b, u, nir_fadd(b, v, w));
+   nir_def *t = nir_fadd(b, nir_fadd(b, nir_fmul(b, u, scaled_z[0]), nir_fmul(b, v, scaled_z[1])),
+                         nir_fmul(b, w, scaled_z[2]));
+
+   nir_def *hit = nir_inot(b, nir_iand(b, cond_back, cond_front));
+   hit = nir_iand(b, hit, nir_inot(b, test_ray_flag(b, state, SpvRayFlagsSkipTrianglesKHRMask)));
+   hit = nir_iand(b, hit, nir_fneu_imm(b, det, 0.0f));
+   hit = nir_iand(b, hit, nir_fge_imm(b, nir_fmul(b, nir_fsign(b, det), t), 0.0f));
+
+   t = nir_fdiv(b, t, det);
+   hit = nir_iand(b, hit, nir_iand(b, nir_fge(b, t, state->tmin),
+                                   nir_flt(b, t, rq_load_var(b, index, vars->closest.t))));
+
+   b->exact = old_exact;
+
+   nir_def *instance_flags =
+      nir_ushr_imm(b, rq_load_var(b, index, vars->candidate.sbt_offset_and_flags), 24);
+   nir_def *frontface = nir_ixor(b, nir_fgt_imm(b, det, 0.0f),
+                                 nir_test_mask(b, instance_flags, VK_GEOMETRY_INSTANCE_TRIANGLE_FLIP_FACING_BIT_KHR));
+
+   nir_def *facing_culled = nir_bcsel(b, frontface,
+                                      test_ray_flag(b, state, SpvRayFlagsCullFrontFacingTrianglesKHRMask),
+                                      test_ray_flag(b, state, SpvRayFlagsCullBackFacingTrianglesKHRMask));
+   facing_culled = nir_iand(b, facing_culled,
+                            nir_inot(b, nir_test_mask(b, instance_flags,
+                                                      VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR)));
+   hit = nir_iand(b, hit, nir_inot(b, facing_culled));
+
+   nir_push_if(b, hit);
+   {
+      nir_def *info = nir_build_load_global(
+         b, 2, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_triangle_node, primitive_id)));
+      nir_def *geometry_id_and_flags = nir_channel(b, info, 1);
+      nir_def *opaque = hit_is_opaque(b, state, geometry_id_and_flags);
+
+      nir_push_if(b, opaque_not_culled(b, state, opaque));
+      {
+         rq_store_var(b, index, vars->candidate.barycentrics,
+                      nir_fdiv(b, nir_vec2(b, v, w), nir_replicate(b, det, 2)), 0x3);
+         rq_store_var(b, index, vars->candidate.primitive_id, nir_channel(b, info, 0), 0x1);
+         rq_store_var(b, index, vars->candidate.geometry_id_and_flags, geometry_id_and_flags, 0x1);
+         rq_store_var(b, index, vars->candidate.t, t, 0x1);
+         rq_store_var(b, index, vars->candidate.opaque, opaque, 0x1);
+         rq_store_var(b, index, vars->candidate.frontface, frontface, 0x1);
+         rq_store_var(b, index, vars->candidate.intersection_type, nir_imm_int(b, intersection_type_triangle), 0x1);
+
+         nir_push_if(b, opaque);
+         {
+            copy_candidate_to_closest(b, index, vars);
+            insert_terminate_on_first_hit(b, index, vars, true);
+         }
+         nir_push_else(b, NULL);
+         {
+            nir_jump(b, nir_jump_break);
+         }
+         nir_pop_if(b, NULL);
+      }
+      nir_pop_if(b, NULL);
+   }
+   nir_pop_if(b, NULL);
+}
+
+/* AABBs are handed to the shader as candidates whenever the ray passes
+ * through their box, the shader decides about the actual hit.
+ */
+static void
+visit_aabb(nir_builder *b, struct traversal_state *state, nir_def *node_addr)
+{
+   struct ray_query_vars *vars = state->vars;
+   nir_def *index = state->index;
+
+   nir_def *origin = rq_load_var(b, index, vars->trav.origin);
+   nir_def *inv_dir = nir_frcp(b, rq_load_var(b, index, vars->trav.direction));
+
+   nir_def *min = nir_build_load_global(b, 3, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_aabb_node, min)));
+   nir_def *max = nir_build_load_global(b, 3, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_aabb_node, max)));
+
+   nir_def *t0 = nir_fmul(b, nir_fsub(b, min, origin), inv_dir);
+   nir_def *t1 = nir_fmul(b, nir_fsub(b, max, origin), inv_dir);
+   nir_def *tmins = nir_fmin(b, t0, t1);
+   nir_def *tmaxs = nir_fmax(b, t0, t1);
+
+   nir_def *tnear = state->tmin;
+   nir_def *tfar = rq_load_var(b, index, vars->closest.t);
+   for (unsigned axis = 0; axis < 3; axis++) {
+      tnear = nir_fmax(b, tnear, nir_channel(b, tmins, axis));
+      tfar = nir_fmin(b, tfar, nir_channel(b, tmaxs, axis));
+   }
+
+   nir_def *hit = nir_iand(b, nir_fge(b, tfar, tnear),
+                           nir_inot(b, test_ray_flag(b, state, SpvRayFlagsSkipAABBsKHRMask)));
+
+   nir_push_if(b, hit);
+   {
+      nir_def *info = nir_build_load_global(
+         b, 2, 32, nir_iadd_imm(b, node_addr, offsetof(struct lvp_bvh_aabb_node, primitive_id)));
+      nir_def *geometry_id_and_flags = nir_channel(b, info, 1);
+      nir_def *opaque = hit_is_opaque(b, state, geometry_id_and_flags);
+
+      nir_push_if(b, opaque_not_culled(b, state, opaque));
+      {
+         rq_store_var(b, index, vars->candidate.primitive_id, nir_channel(b, info, 0), 0x1);
+         rq_store_var(b, index, vars->candidate.geometry_id_and_flags, geometry_id_and_flags, 0x1);
+         rq_store_var(b, index, vars->candidate.opaque, opaque, 0x1);
+         rq_store_var(b, index, vars->candidate.intersection_type, nir_imm_int(b, intersection_type_aabb), 0x1);
+
+         nir_jump(b, nir_jump_break);
+      }
+      nir_pop_if(b, NULL);
+   }
+   nir_pop_if(b, NULL);
+}
+
+static nir_def *
+lower_rq_proceed(nir_builder *b, nir_def *index, nir_intrinsic_instr *instr, struct ray_query_vars *vars)
+{
+   nir_push_if(b, rq_load_var(b, index, vars->incomplete));
+   {
+      struct traversal_state state = {
+         .index = index,
+         .vars = vars,
+         .flags = rq_load_var(b, index, vars->flags),
+         .tmin = rq_load_var(b, index, vars->tmin),
+      };
+
+      nir_push_loop(b);
+      {
+         nir_push_if(b, nir_ieq_imm(b, rq_load_var(b, index, vars->trav.current_node), LVP_BVH_INVALID_NODE));
+         {
+            nir_def *stack_ptr = rq_load_var(b, index, vars->trav.stack_ptr);
+
+            /* Done with the instance, back to the top level. */
+            nir_push_if(b, nir_ieq(b, stack_ptr, rq_load_var(b, index, vars->trav.instance_stack_base)));
+            {
+               rq_copy_var(b, index, vars->trav.origin, vars->origin, 0x7);
+               rq_copy_var(b, index, vars->trav.direction, vars->direction, 0x7);
+               rq_copy_var(b, index, vars->trav.bvh_base, vars->root_bvh_base, 0x1);
+               rq_store_var(b, index, vars->trav.instance_stack_base, nir_imm_int(b, LVP_BVH_INVALID_NODE), 0x1);
+            }
+            nir_pop_if(b, NULL);
+
+            nir_push_if(b, nir_ieq_imm(b, stack_ptr, 0));
+            {
+               rq_store_var(b, index, vars->incomplete, nir_imm_false(b), 0x1);
+               nir_jump(b, nir_jump_break);
+            }
+            nir_pop_if(b, NULL);
+
+            rq_store_var(b, index, vars->trav.current_node, pop_node(b, &state), 0x1);
+         }
+         nir_pop_if(b, NULL);
+
+         nir_def *node = rq_load_var(b, index, vars->trav.current_node);
+         rq_store_var(b, index, vars->trav.current_node, nir_imm_int(b, LVP_BVH_INVALID_NODE), 0x1);
+
+         nir_def *node_type = nir_iand_imm(b, node, LVP_BVH_NODE_TYPE_MASK);
+         nir_def *node_addr = nir_iadd(b, rq_load_var(b, index, vars->trav.bvh_base),
+                                       nir_u2u64(b, nir_iand_imm(b, node, ~LVP_BVH_NODE_TYPE_MASK)));
+
+         nir_push_if(b, nir_ieq_imm(b, node_type, LVP_BVH_NODE_BOX));
+         {
+            visit_box(b, &state, node_addr);
+         }
+         nir_push_else(b, NULL);
+         nir_push_if(b, nir_ieq_imm(b, node_type, LVP_BVH_NODE_INSTANCE));
+         {
+            visit_instance(b, &state, node_addr);
+         }
+         nir_push_else(b, NULL);
+         nir_push_if(b, nir_ieq_imm(b, node_type, LVP_BVH_NODE_TRIANGLE));
+         {
+            visit_triangle(b, &state, node_addr);
+         }
+         nir_push_else(b, NULL);
+         {
+            visit_aabb(b, &state, node_addr);
+         }
+         nir_pop_if(b, NULL);
+         nir_pop_if(b, NULL);
+         nir_pop_if(b, NULL);
+      }
+      nir_pop_loop(b, NULL);
+   }
+   nir_pop_if(b, NULL);
+
+   return rq_load_var(b, index, vars->incomplete);
+}
+
+static void
+lower_rq_terminate(nir_builder *b, nir_def *index, nir_intrinsic_instr *instr, struct ray_query_vars *vars)
+{
+   rq_store_var(b, index, vars->incomplete, nir_imm_false(b), 0x1);
+}
+
+bool
+lvp_nir_lower_ray_queries(nir_shader *shader)
+{
+   bool progress = false;
+   struct hash_table *query_ht = _mesa_pointer_hash_table_create(NULL);
+
+   nir_foreach_variable_in_list (var, &shader->variables) {
+      if (!var->data.ray_query)
+         continue;
+
+      lower_ray_query(shader, var, query_ht);
+
+      progress = true;
+   }
+
+   nir_foreach_function_impl (impl, shader) {
+      nir_builder builder = nir_builder_create(impl);
+
+      nir_foreach_variable_in_list (var, &impl->locals) {
+         if (!var->data.ray_query)
+            continue;
+
+         lower_ray_query(shader, var, query_ht);
+
+         progress = true;
+      }
+
+      nir_foreach_block (block, impl) {
+         nir_foreach_instr_safe (instr, block) {
+            if (instr->type != nir_instr_type_intrinsic)
+               continue;
+
+            nir_intrinsic_instr *intrinsic = nir_instr_as_intrinsic(instr);
+
+            if (!nir_intrinsic_is_ray_query(intrinsic->intrinsic))
+               continue;
+
+            nir_deref_instr *ray_query_deref = nir_instr_as_deref(intrinsic->src[0].ssa->parent_instr);
+            nir_def *index = NULL;
+
+            if (ray_query_deref->deref_type == nir_deref_type_array) {
+               index = ray_query_deref->arr.index.ssa;
+               ray_query_deref = nir_instr_as_deref(ray_query_deref->parent.ssa->parent_instr);
+            }
+
+            assert(ray_query_deref->deref_type == nir_deref_type_var);
+
+            struct ray_query_vars *vars =
+               (struct ray_query_vars *)_mesa_hash_table_search(query_ht, ray_query_deref->var)->data;
+
+            builder.cursor = nir_before_instr(instr);
+
+            nir_def *new_dest = NULL;
+
+            switch (intrinsic->intrinsic) {
+            case nir_intrinsic_rq_confirm_intersection:
+               lower_rq_confirm_intersection(&builder, index, intrinsic, vars);
+               break;
+            case nir_intrinsic_rq_generate_intersection:
+               lower_rq_generate_intersection(&builder, index, intrinsic, vars);
+               break;
+            case nir_intrinsic_rq_initialize:
+               lower_rq_initialize(&builder, index, intrinsic, vars);
+               break;
+            case nir_intrinsic_rq_load:
+               new_dest = lower_rq_load(&builder, index, intrinsic, vars);
+               break;
+            case nir_intrinsic_rq_proceed:
+               new_dest = lower_rq_proceed(&builder, index, intrinsic, vars);
+               break;
+            case nir_intrinsic_rq_terminate:
+               lower_rq_terminate(&builder, index, intrinsic, vars);
+               break;
+            default:
+               unreachable("Unsupported ray query intrinsic!");
+            }
+
+            if (new_dest)
+               nir_def_rewrite_uses(&intrinsic->def, new_dest);
+
+            nir_instr_remove(instr);
+            nir_instr_free(instr);
+
+            progress = true;
+         }
+      }
+
+      nir_metadata_preserve(impl, nir_metadata_none);
+   }
+
+   ralloc_free(query_ht);
+
+   return progress;
+}
@@ -42,6 +42,24 @@
 
 typedef void (*cso_destroy_func)(struct pipe_context*, void*);
 
+/* Drops a reference to a lvp_pipeline_nir along with its cso, the caller
+ * must hold the queue lock.
+ */
+static void
+pipeline_nir_release(struct lvp_device *device, struct lvp_pipeline_nir **pipeline_nir,
+                     cso_destroy_func destroy)
+{
+   struct lvp_pipeline_nir *old = *pipeline_nir;
+   *pipeline_nir = NULL;
+   if (!old || !p_atomic_dec_zero(&old->ref_cnt))
+      return;
+
+   if (old->cso)
+      destroy(device->queue.ctx, old->cso);
+   ralloc_free(old->nir);
+   ralloc_free(old);
+}
+
 static void
 shader_destroy(struct lvp_device *device, struct lvp_shader *shader, bool locked)
 {
@@ -69,16 +87,16 @@ shader_destroy(struct lvp_device *device, struct lvp_shader *shader, bool locked
    }
    ralloc_free(shader->inlines.variants.table);
 
-   if (shader->shader_cso)
+   if (shader->shader_cso && shader->shader_cso != shader->pipeline_nir->cso)
       destroy[stage](device->queue.ctx, shader->shader_cso);
-   if (shader->tess_ccw_cso)
+   if (shader->tess_ccw_cso && shader->tess_ccw_cso != shader->tess_ccw->cso)
       destroy[stage](device->queue.ctx, shader->tess_ccw_cso);
 
+   pipeline_nir_release(device, &shader->pipeline_nir, destroy[stage]);
+   pipeline_nir_release(device, &shader->tess_ccw, destroy[stage]);
+
    if (!locked)
       simple_mtx_unlock(&device->queue.lock);
-
-   lvp_pipeline_nir_ref(&shader->pipeline_nir, NULL);
-   lvp_pipeline_nir_ref(&shader->tess_ccw, NULL);
 }
 
 void
@@ -277,6 +295,7 @@ create_pipeline_nir(nir_shader *nir)
    struct lvp_pipeline_nir *pipeline_nir = ralloc(NULL, struct lvp_pipeline_nir);
    pipeline_nir->nir = nir;
    pipeline_nir->ref_cnt = 1;
+   pipeline_nir->cso = NULL;
    return pipeline_nir;
 }
 
@@ -322,6 +341,9 @@ compile_spirv(struct lvp_device *pdevice, const VkPipelineShaderStageCreateInfo
          .multiview = true,
          .physical_storage_buffer_address = true,
          .int64_atomics = true,
+         .ray_cull_mask = true,
+         .ray_query = true,
+         .ray_traversal_primitive_culling = true,
          .subgroup_arithmetic = true,
          .subgroup_basic = true,
          .subgroup_ballot = true,
@@ -411,6 +433,13 @@ lvp_shader_lower(struct lvp_device *pdevice, struct lvp_pipeline *pipeline, nir_
    NIR_PASS_V(nir, lower_demote);
    NIR_PASS_V(nir, nir_lower_compute_system_values, NULL);
 
+   nir_shader_gather_info(nir, nir_shader_get_entrypoint(nir));
+   if (nir->info.ray_queries > 0) {
+      NIR_PASS(_, nir, nir_opt_ray_queries);
+      NIR_PASS(_, nir, nir_opt_ray_query_ranges);
+      NIR_PASS(_, nir, lvp_nir_lower_ray_queries);
+   }
+
    NIR_PASS_V(nir, nir_remove_dead_variables,
               nir_var_uniform | nir_var_image, NULL);
 
@@ -767,14 +796,84 @@ merge_layouts(struct vk_device *device, struct lvp_pipeline *dst, struct lvp_pip
    dst->layout->push_constant_stages |= src->push_constant_stages;
 }
 
+struct lvp_stage_job {
+   struct util_queue_fence fence;
+   struct lvp_pipeline *pipeline;
+   const VkPipelineShaderStageCreateInfo *sinfo;
+   gl_shader_stage stage;
+   /* finalized copies of the stage's NIR still missing a cso */
+   nir_shader *nir;
+   nir_shader *tess_ccw_nir;
+   VkResult result;
+};
+
+static void
+compile_to_ir_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_stage_job *job = data;
+   job->result = lvp_shader_compile_to_ir(job->pipeline, job->sinfo);
+}
+
+/* Only the driver's NIR finalization runs on the worker threads: creating
+ * the cso needs the queue lock, which the queue thread may hold while it
+ * waits for the worker threads itself.
+ */
+static void
+finalize_nir_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_stage_job *job = data;
+   struct lvp_shader *shader = &job->pipeline->shaders[job->stage];
+   struct pipe_screen *pscreen = job->pipeline->device->physical_device->pscreen;
+
+   if (!shader->pipeline_nir->cso) {
+      job->nir = nir_shader_clone(NULL, shader->pipeline_nir->nir);
+      pscreen->finalize_nir(pscreen, job->nir);
+   }
+   if (shader->tess_ccw && !shader->tess_ccw->cso) {
+      job->tess_ccw_nir = nir_shader_clone(NULL, shader->tess_ccw->nir);
+      pscreen->finalize_nir(pscreen, job->tess_ccw_nir);
+   }
+}
+
+/* Stages are independent up to linking, so with more than one of them
+ * spread the work over the device worker threads.
+ */
+static void
+run_stage_jobs(struct lvp_device *device, struct lvp_stage_job *jobs, unsigned count,
+               util_queue_execute_func execute, bool threaded)
+{
+   threaded &= count > 1 && util_queue_is_initialized(&device->worker_queue);
+
+   for (unsigned i = 0; i < count; i++) {
+      /* the calling thread takes the last stage */
+      if (threaded && i < count - 1) {
+         util_queue_fence_init(&jobs[i].fence);
+         util_queue_add_job(&device->worker_queue, &jobs[i], &jobs[i].fence,
+                            execute, NULL, 0);
+      } else {
+         execute(&jobs[i], NULL, 0);
+      }
+   }
+
+   if (threaded) {
+      for (unsigned i = 0; i < count - 1; i++) {
+         util_queue_fence_wait(&jobs[i].fence);
+         util_queue_fence_destroy(&jobs[i].fence);
+      }
+   }
+}
+
 static void
 copy_shader_sanitized(struct lvp_shader *dst, const struct lvp_shader *src)
 {
    *dst = *src;
    dst->pipeline_nir = NULL; //this gets handled later
    dst->tess_ccw = NULL; //this gets handled later
-   assert(!dst->shader_cso);
-   assert(!dst->tess_ccw_cso);
+   /* the library's csos belong to the shared lvp_pipeline_nir and are
+    * picked up from there when the pipeline is compiled
+    */
+   dst->shader_cso = NULL;
+   dst->tess_ccw_cso = NULL;
    if (src->inlines.can_inline)
       _mesa_set_init(&dst->inlines.variants, NULL, NULL, inline_variant_equals);
 }
@@ -865,6 +964,8 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
 
    pipeline->device = device;
 
+   struct lvp_stage_job jobs[LVP_SHADER_STAGES];
+   unsigned job_count = 0;
    for (uint32_t i = 0; i < pCreateInfo->stageCount; i++) {
       const VkPipelineShaderStageCreateInfo *sinfo = &pCreateInfo->pStages[i];
       gl_shader_stage stage = vk_to_mesa_shader_stage(sinfo->stage);
@@ -875,18 +976,25 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          if (!(pipeline->stages & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
             continue;
       }
-      result = lvp_shader_compile_to_ir(pipeline, sinfo);
-      if (result != VK_SUCCESS)
-         goto fail;
+      jobs[job_count++] = (struct lvp_stage_job) {
+         .pipeline = pipeline,
+         .sinfo = sinfo,
+         .stage = stage,
+      };
+   }
+   run_stage_jobs(device, jobs, job_count, compile_to_ir_job, true);
 
-      switch (stage) {
-      case MESA_SHADER_FRAGMENT:
-         if (pipeline->shaders[MESA_SHADER_FRAGMENT].pipeline_nir->nir->info.fs.uses_sample_shading)
-            pipeline->force_min_sample = true;
-         break;
-      default: break;
-      }
+   result = VK_SUCCESS;
+   for (unsigned i = 0; i < job_count; i++) {
+      if (jobs[i].result != VK_SUCCESS)
+         result = jobs[i].result;
    }
+   if (result != VK_SUCCESS)
+      goto fail;
+
+   if (pipeline->shaders[MESA_SHADER_FRAGMENT].pipeline_nir &&
+       pipeline->shaders[MESA_SHADER_FRAGMENT].pipeline_nir->nir->info.fs.uses_sample_shading)
+      pipeline->force_min_sample = true;
    if (pCreateInfo->stageCount && pipeline->shaders[MESA_SHADER_TESS_EVAL].pipeline_nir) {
       nir_lower_patch_vertices(pipeline->shaders[MESA_SHADER_TESS_EVAL].pipeline_nir->nir, pipeline->shaders[MESA_SHADER_TESS_CTRL].pipeline_nir->nir->info.tess.tcs_vertices_out, NULL);
       merge_tess_info(&pipeline->shaders[MESA_SHADER_TESS_EVAL].pipeline_nir->nir->info, &pipeline->shaders[MESA_SHADER_TESS_CTRL].pipeline_nir->nir->info);
@@ -929,8 +1037,10 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          pipeline->line_rectangular = true;
       lvp_pipeline_xfb_init(pipeline);
    }
-   if (!libstate && !pipeline->library)
-      lvp_pipeline_shaders_compile(pipeline, false);
+   /* Libraries compile their stages right away so that linking them only
+    * has to pick up the shader states.
+    */
+   lvp_pipeline_shaders_compile(pipeline, false);
 
    return VK_SUCCESS;
 
@@ -948,21 +1058,48 @@ lvp_pipeline_shaders_compile(struct lvp_pipeline *pipeline, bool locked)
 {
    if (pipeline->compiled)
       return;
+
+   struct lvp_stage_job jobs[LVP_SHADER_STAGES];
+   unsigned job_count = 0;
    for (uint32_t i = 0; i < ARRAY_SIZE(pipeline->shaders); i++) {
-      if (!pipeline->shaders[i].pipeline_nir)
+      struct lvp_shader *shader = &pipeline->shaders[i];
+      if (!shader->pipeline_nir || shader->inlines.can_inline)
          continue;
 
       gl_shader_stage stage = i;
-      assert(stage == pipeline->shaders[i].pipeline_nir->nir->info.stage);
-
-      if (!pipeline->shaders[stage].inlines.can_inline) {
-         pipeline->shaders[stage].shader_cso = lvp_shader_compile(pipeline->device, &pipeline->shaders[stage],
-            nir_shader_clone(NULL, pipeline->shaders[stage].pipeline_nir->nir), locked);
-         if (pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw)
-            pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw_cso = lvp_shader_compile(pipeline->device, &pipeline->shaders[stage],
-               nir_shader_clone(NULL, pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw->nir), locked);
+      assert(stage == shader->pipeline_nir->nir->info.stage);
+
+      /* shaders linked from a library were compiled by the library */
+      if (!shader->pipeline_nir->cso || (shader->tess_ccw && !shader->tess_ccw->cso)) {
+         jobs[job_count++] = (struct lvp_stage_job) {
+            .pipeline = pipeline,
+            .stage = stage,
+         };
       }
    }
+   run_stage_jobs(pipeline->device, jobs, job_count, finalize_nir_job, true);
+
+   if (job_count && !locked)
+      simple_mtx_lock(&pipeline->device->queue.lock);
+   for (unsigned i = 0; i < job_count; i++) {
+      struct lvp_shader *shader = &pipeline->shaders[jobs[i].stage];
+      if (jobs[i].nir)
+         shader->pipeline_nir->cso = lvp_shader_compile_stage(pipeline->device, shader, jobs[i].nir);
+      if (jobs[i].tess_ccw_nir)
+         shader->tess_ccw->cso = lvp_shader_compile_stage(pipeline->device, shader, jobs[i].tess_ccw_nir);
+   }
+   if (job_count && !locked)
+      simple_mtx_unlock(&pipeline->device->queue.lock);
+
+   for (uint32_t i = 0; i < ARRAY_SIZE(pipeline->shaders); i++) {
+      struct lvp_shader *shader = &pipeline->shaders[i];
+      if (!shader->pipeline_nir || shader->inlines.can_inline)
+         continue;
+
+      shader->shader_cso = shader->pipeline_nir->cso;
+      if (shader->tess_ccw)
+         shader->tess_ccw_cso = shader->tess_ccw->cso;
+   }
    pipeline->compiled = true;
 }
 
@@ -171,6 +171,17 @@ void lvp_finish_wsi(struct lvp_physical_device *physical_device);
 bool lvp_physical_device_extension_supported(struct lvp_physical_device *dev,
                                               const char *name);
 
+/* Transfer-only queues get their own context, so their copies can run
+ * alongside whatever the general queue is doing.  Shader CSOs belong to
+ * the general queue's context, which is why the other queue families
+ * can't be offered the same way.
+ */
+enum lvp_queue_family {
+   LVP_QUEUE_FAMILY_GENERAL,
+   LVP_QUEUE_FAMILY_TRANSFER,
+   LVP_QUEUE_FAMILY_COUNT,
+};
+
 struct lvp_queue {
    struct vk_queue vk;
    struct lvp_device *                         device;
@@ -193,6 +204,7 @@ struct lvp_device {
    struct vk_device vk;
 
    struct lvp_queue queue;
+   struct lvp_queue transfer_queue;
    struct lvp_instance *                       instance;
    struct lvp_physical_device *physical_device;
    struct pipe_screen *pscreen;
@@ -207,6 +219,11 @@ struct lvp_device {
    struct lp_texture_handle *null_image_handle;
    struct util_dynarray bda_texture_handles;
    struct util_dynarray bda_image_handles;
+
+   /* Threads for CPU side work big enough to be split up, like building
+    * acceleration structures or large copies.
+    */
+   struct util_queue worker_queue;
 };
 
 void lvp_device_get_cache_uuid(void *uuid);
@@ -426,6 +443,10 @@ lvp_pipeline_layout_create(struct lvp_device *device,
 struct lvp_pipeline_nir {
    int ref_cnt;
    nir_shader *nir;
+   /* Shader state compiled without inlined uniforms, shared by every pipeline
+    * referencing this nir, e.g. all pipelines linked from a library.
+    */
+   void *cso;
 };
 
 static inline void
@@ -436,6 +457,8 @@ lvp_pipeline_nir_ref(struct lvp_pipeline_nir **dst, struct lvp_pipeline_nir *src
       return;
 
    if (old_dst && p_atomic_dec_zero(&old_dst->ref_cnt)) {
+      /* csos are freed through shader_destroy() */
+      assert(!old_dst->cso);
       ralloc_free(old_dst->nir);
       ralloc_free(old_dst);
    }
@@ -572,6 +595,8 @@ struct lvp_query_pool {
    uint32_t count;
    VkQueryPipelineStatisticFlags pipeline_stats;
    enum pipe_query_type base_type;
+   /* Results of acceleration structure queries, 0 while unavailable. */
+   uint64_t *data;
    struct pipe_query *queries[0];
 };
 
@@ -581,6 +606,12 @@ struct lvp_cmd_buffer {
    struct lvp_device *                          device;
 
    uint8_t push_constants[MAX_PUSH_CONSTANTS_SIZE];
+
+   /* Flat array of the vk_cmd_queue_entry pointers to execute, built at
+    * vkEndCommandBuffer, see lvp_compile_cmd_buffer().
+    */
+   struct util_dynarray stream;
+   bool stream_valid;
 };
 
 struct lvp_indirect_command_layout {
@@ -655,6 +686,7 @@ VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_indirect_command_layout, base, VkIndirectComm
 
 void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp);
 
+void lvp_compile_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer);
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer);
@@ -704,6 +736,12 @@ lvp_image_aspects_to_plane(ASSERTED const struct lvp_image *image,
 void
 lvp_pipeline_destroy(struct lvp_device *device, struct lvp_pipeline *pipeline, bool locked);
 
+void
+lvp_copy_box(struct lvp_device *device, enum pipe_format format,
+             uint8_t *dst, unsigned dst_stride, uint64_t dst_slice_stride,
+             const uint8_t *src, unsigned src_stride, uint64_t src_slice_stride,
+             unsigned width, unsigned height, unsigned depth);
+
 void
 queue_thread_noop(void *data, void *gdata, int thread_index);
 
@@ -717,6 +755,26 @@ void *
 lvp_shader_compile(struct lvp_device *device, struct lvp_shader *shader, nir_shader *nir, bool locked);
 enum vk_cmd_type
 lvp_nv_dgc_token_to_cmd_type(const VkIndirectCommandsLayoutTokenNV *token);
+
+void
+lvp_build_acceleration_structures(struct lvp_device *device, uint32_t info_count,
+                                  const VkAccelerationStructureBuildGeometryInfoKHR *infos,
+                                  const VkAccelerationStructureBuildRangeInfoKHR *const *ranges,
+                                  bool host);
+void
+lvp_copy_acceleration_structure(const VkCopyAccelerationStructureInfoKHR *info);
+void
+lvp_copy_acceleration_structure_to_memory(struct lvp_device *device,
+                                          const VkCopyAccelerationStructureToMemoryInfoKHR *info,
+                                          bool host);
+void
+lvp_copy_memory_to_acceleration_structure(struct lvp_device *device,
+                                          const VkCopyMemoryToAccelerationStructureInfoKHR *info,
+                                          bool host);
+uint64_t
+lvp_acceleration_structure_query(VkAccelerationStructureKHR accel_struct, VkQueryType type);
+bool
+lvp_nir_lower_ray_queries(nir_shader *shader);
 #ifdef __cplusplus
 }
 #endif
@@ -50,6 +50,11 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
    case VK_QUERY_TYPE_MESH_PRIMITIVES_GENERATED_EXT:
       pipeq = PIPE_QUERY_PRIMITIVES_GENERATED;
       break;
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR:
+   case VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR:
+      /* written on the CPU into pool->data */
+      pipeq = PIPE_QUERY_TYPES;
+      break;
    default:
       return VK_ERROR_FEATURE_NOT_PRESENT;
    }
@@ -57,6 +62,8 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
    struct lvp_query_pool *pool;
    size_t pool_size = sizeof(*pool)
       + pCreateInfo->queryCount * sizeof(struct pipe_query *);
+   if (pipeq == PIPE_QUERY_TYPES)
+      pool_size += pCreateInfo->queryCount * sizeof(uint64_t);
 
    pool = vk_zalloc2(&device->vk.alloc, pAllocator,
                     pool_size, 8,
@@ -70,6 +77,8 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
    pool->count = pCreateInfo->queryCount;
    pool->base_type = pipeq;
    pool->pipeline_stats = pCreateInfo->pipelineStatistics;
+   if (pipeq == PIPE_QUERY_TYPES)
+      pool->data = (uint64_t *)&pool->queries[pool->count];
 
    *pQueryPool = lvp_query_pool_to_handle(pool);
    return VK_SUCCESS;
@@ -114,7 +123,10 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_GetQueryPoolResults(
       union pipe_query_result result;
       bool ready = false;
 
-      if (pool->queries[i]) {
+      if (pool->data) {
+         result.u64 = pool->data[i];
+         ready = result.u64 != 0;
+      } else if (pool->queries[i]) {
          ready = device->queue.ctx->get_query_result(device->queue.ctx,
                                                      pool->queries[i],
                                                      (flags & VK_QUERY_RESULT_WAIT_BIT),
@@ -197,6 +209,8 @@ VKAPI_ATTR void VKAPI_CALL lvp_ResetQueryPool(
    for (uint32_t i = 0; i < queryCount; i++) {
       uint32_t idx = i + firstQuery;
 
+      if (pool->data)
+         pool->data[idx] = 0;
       if (pool->queries[idx]) {
          device->queue.ctx->destroy_query(device->queue.ctx, pool->queries[idx]);
          pool->queries[idx] = NULL;
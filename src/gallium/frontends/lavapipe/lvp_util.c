@@ -23,6 +23,7 @@
 
 #include "lvp_private.h"
 #include "vk_enum_to_str.h"
+#include "util/format/u_format.h"
 void lvp_printflike(3, 4)
 __lvp_finishme(const char *file, int line, const char *format, ...)
 {
@@ -35,3 +36,117 @@ __lvp_finishme(const char *file, int line, const char *format, ...)
 
    fprintf(stderr, "%s:%d: FINISHME: %s\n", file, line, buffer);
 }
+
+/* Copies below this size are not worth waking up the worker threads for. */
+#define LVP_PARALLEL_COPY_MIN_SIZE (4 * 1024 * 1024)
+#define LVP_PARALLEL_COPY_MAX_JOBS 16
+
+struct lvp_copy_job {
+   struct util_queue_fence fence;
+
+   uint8_t *dst;
+   const uint8_t *src;
+   unsigned dst_stride, src_stride;
+   uint64_t dst_slice_stride, src_slice_stride;
+   unsigned row_size;
+   unsigned rows_per_slice;
+   /* Rows and slices follow each other without gaps on both sides. */
+   bool contiguous;
+
+   unsigned first_row;
+   unsigned row_count;
+};
+
+static void
+lvp_copy_rows(void *data, void *gdata, int thread_index)
+{
+   struct lvp_copy_job *job = data;
+
+   if (job->contiguous) {
+      uint64_t offset = (uint64_t)job->first_row * job->row_size;
+      memcpy(job->dst + offset, job->src + offset,
+             (size_t)job->row_count * job->row_size);
+      return;
+   }
+
+   for (unsigned i = job->first_row; i < job->first_row + job->row_count; i++) {
+      unsigned slice = i / job->rows_per_slice;
+      unsigned row = i % job->rows_per_slice;
+      memcpy(job->dst + slice * job->dst_slice_stride + row * job->dst_stride,
+             job->src + slice * job->src_slice_stride + row * job->src_stride,
+             job->row_size);
+   }
+}
+
+/*
+ * Like util_copy_box() with all offsets zero, but uses a single memcpy when
+ * the box is contiguous in both source and destination, and spreads large
+ * copies over the device worker threads.
+ */
+void
+lvp_copy_box(struct lvp_device *device, enum pipe_format format,
+             uint8_t *dst, unsigned dst_stride, uint64_t dst_slice_stride,
+             const uint8_t *src, unsigned src_stride, uint64_t src_slice_stride,
+             unsigned width, unsigned height, unsigned depth)
+{
+   unsigned row_size = util_format_get_stride(format, width);
+   unsigned rows = util_format_get_nblocksy(format, height);
+   uint64_t slice_size = (uint64_t)row_size * rows;
+   uint64_t size = slice_size * depth;
+
+   if (!size)
+      return;
+
+   struct lvp_copy_job job = {
+      .dst = dst,
+      .src = src,
+      .dst_stride = dst_stride,
+      .src_stride = src_stride,
+      .dst_slice_stride = dst_slice_stride,
+      .src_slice_stride = src_slice_stride,
+      .row_size = row_size,
+      .rows_per_slice = rows,
+      .contiguous = dst_stride == row_size && src_stride == row_size &&
+                    (depth == 1 || (dst_slice_stride == slice_size &&
+                                    src_slice_stride == slice_size)),
+      .first_row = 0,
+      .row_count = rows * depth,
+   };
+
+   unsigned job_count = 1;
+   if (util_queue_is_initialized(&device->worker_queue) &&
+       size >= LVP_PARALLEL_COPY_MIN_SIZE) {
+      job_count = MIN3(device->worker_queue.num_threads + 1,
+                       LVP_PARALLEL_COPY_MAX_JOBS, job.row_count);
+   }
+
+   if (job_count <= 1) {
+      lvp_copy_rows(&job, NULL, 0);
+      return;
+   }
+
+   /* The calling thread takes the last share. */
+   struct lvp_copy_job jobs[LVP_PARALLEL_COPY_MAX_JOBS];
+   unsigned rows_per_job = DIV_ROUND_UP(job.row_count, job_count);
+   unsigned queued = 0;
+   for (unsigned first_row = 0; first_row < job.row_count; first_row += rows_per_job) {
+      struct lvp_copy_job *j = &jobs[queued];
+      *j = job;
+      j->first_row = first_row;
+      j->row_count = MIN2(rows_per_job, job.row_count - first_row);
+
+      if (first_row + j->row_count < job.row_count) {
+         util_queue_fence_init(&j->fence);
+         util_queue_add_job(&device->worker_queue, j, &j->fence,
+                            lvp_copy_rows, NULL, 0);
+         queued++;
+      } else {
+         lvp_copy_rows(j, NULL, 0);
+      }
+   }
+
+   for (unsigned i = 0; i < queued; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
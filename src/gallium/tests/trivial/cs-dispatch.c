@@ -0,0 +1,147 @@
+/*
+ * Copyright 2026 agent
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Compute dispatch overhead benchmark.
+ *
+ * Launches back to back grids of a trivial compute shader and prints the
+ * time per dispatch for a range of grid sizes.  For small grids this is
+ * dominated by how quickly the driver gets work to and back from its
+ * threads rather than by the shader itself.
+ *
+ * Usage: GALLIUM_DRIVER=llvmpipe cs-dispatch [dispatches]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipe/p_state.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_defines.h"
+#include "tgsi/tgsi_text.h"
+#include "util/os_time.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "pipe-loader/pipe_loader.h"
+
+#define BLOCK_SIZE 64
+
+static const char *cs_text =
+	"COMP\n"
+	"PROPERTY CS_FIXED_BLOCK_WIDTH 64\n"
+	"PROPERTY CS_FIXED_BLOCK_HEIGHT 1\n"
+	"PROPERTY CS_FIXED_BLOCK_DEPTH 1\n"
+	"DCL SV[0], THREAD_ID\n"
+	"DCL SV[1], BLOCK_ID\n"
+	"DCL TEMP[0]\n"
+	"UADD TEMP[0].x, SV[0].xxxx, SV[1].xxxx\n"
+	"END\n";
+
+static const unsigned grid_sizes[] = { 1, 2, 4, 16, 64, 256, 1024 };
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+
+	void *cs;
+};
+
+static void init_prog(struct program *p)
+{
+	struct tgsi_token tokens[1024];
+	struct pipe_compute_state state;
+	ASSERTED int ret;
+
+	ret = pipe_loader_probe(&p->dev, 1, false);
+	assert(ret);
+
+	p->screen = pipe_loader_create_screen(p->dev);
+	assert(p->screen);
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+
+	ret = tgsi_text_translate(cs_text, tokens, ARRAY_SIZE(tokens));
+	assert(ret);
+
+	memset(&state, 0, sizeof(state));
+	state.ir_type = PIPE_SHADER_IR_TGSI;
+	state.prog = tokens;
+	p->cs = p->pipe->create_compute_state(p->pipe, &state);
+	assert(p->cs);
+
+	p->pipe->bind_compute_state(p->pipe, p->cs);
+}
+
+static void close_prog(struct program *p)
+{
+	p->pipe->bind_compute_state(p->pipe, NULL);
+	p->pipe->delete_compute_state(p->pipe, p->cs);
+
+	p->pipe->destroy(p->pipe);
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+}
+
+static void finish(struct program *p)
+{
+	struct pipe_fence_handle *fence = NULL;
+
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, OS_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+}
+
+static void dispatch(struct program *p, unsigned groups, unsigned count)
+{
+	struct pipe_grid_info info;
+
+	memset(&info, 0, sizeof(info));
+	info.work_dim = 1;
+	info.block[0] = BLOCK_SIZE;
+	info.block[1] = 1;
+	info.block[2] = 1;
+	info.grid[0] = groups;
+	info.grid[1] = 1;
+	info.grid[2] = 1;
+
+	for (unsigned i = 0; i < count; i++)
+		p->pipe->launch_grid(p->pipe, &info);
+}
+
+int main(int argc, char** argv)
+{
+	struct program prog;
+	unsigned dispatches;
+
+	dispatches = argc > 1 ? atoi(argv[1]) : 10000;
+
+	memset(&prog, 0, sizeof(prog));
+	init_prog(&prog);
+
+	/* warm up, so shader compilation isn't measured */
+	dispatch(&prog, 1, 1);
+	finish(&prog);
+
+	printf("%u dispatches per grid size, %u invocations per group\n",
+	       dispatches, BLOCK_SIZE);
+	printf("  groups  us/dispatch\n");
+
+	for (unsigned i = 0; i < ARRAY_SIZE(grid_sizes); i++) {
+		int64_t start = os_time_get_nano();
+		dispatch(&prog, grid_sizes[i], dispatches);
+		finish(&prog);
+		int64_t end = os_time_get_nano();
+
+		printf("%8u %12.2f\n", grid_sizes[i],
+		       (end - start) / 1000.0 / MAX2(dispatches, 1));
+	}
+
+	close_prog(&prog);
+
+	return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2026 agent
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Rasterizer thread scaling benchmark for llvmpipe.
+ *
+ * Renders the same blended, heavily overlapping triangle soup with 1 up
+ * to N rasterizer threads and prints frames per second for each thread
+ * count.  A fresh screen is created for every step because llvmpipe
+ * reads LP_NUM_THREADS at screen creation.
+ *
+ * Usage: GALLIUM_DRIVER=llvmpipe rast-scaling [max_threads] [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipe/p_state.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "cso_cache/cso_context.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_draw_quad.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "pipe-loader/pipe_loader.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define NUM_TRIS 20000
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+
+	union pipe_color_union clear_color;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+static float rand_unit(unsigned *seed)
+{
+	*seed = *seed * 1103515245u + 12345u;
+	return (float)((*seed >> 8) & 0xffff) / 65535.0f;
+}
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+	ASSERTED int ret;
+
+	ret = pipe_loader_probe(&p->dev, 1, false);
+	assert(ret);
+
+	p->screen = pipe_loader_create_screen(p->dev);
+	assert(p->screen);
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	p->clear_color.f[3] = 1.0;
+
+	/* triangle soup, same for every run */
+	{
+		const unsigned size = NUM_TRIS * 3 * 2 * 4 * sizeof(float);
+		float *vertices = MALLOC(size);
+		float *v = vertices;
+		unsigned seed = 1;
+
+		for (unsigned t = 0; t < NUM_TRIS; t++) {
+			float cx = rand_unit(&seed) * 2.0f - 1.0f;
+			float cy = rand_unit(&seed) * 2.0f - 1.0f;
+			float r = 0.02f + rand_unit(&seed) * 0.2f;
+
+			for (unsigned i = 0; i < 3; i++) {
+				*v++ = cx + (rand_unit(&seed) - 0.5f) * r * 2.0f;
+				*v++ = cy + (rand_unit(&seed) - 0.5f) * r * 2.0f;
+				*v++ = 0.0f;
+				*v++ = 1.0f;
+				*v++ = rand_unit(&seed);
+				*v++ = rand_unit(&seed);
+				*v++ = rand_unit(&seed);
+				*v++ = 0.5f;
+			}
+		}
+
+		p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+					     PIPE_USAGE_DEFAULT, size);
+		pipe_buffer_write(p->pipe, p->vbuf, 0, size, vertices);
+		FREE(vertices);
+	}
+
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* alpha blending so that every fragment does a read-modify-write */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].blend_enable = 1;
+	p->blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+	p->blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+	p->blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+	p->blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+	p->blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+	p->blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ZERO;
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip_near = 1;
+	p->rasterizer.depth_clip_far = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	memset(&p->viewport, 0, sizeof(p->viewport));
+	p->viewport.scale[0] = WIDTH / 2.0f;
+	p->viewport.scale[1] = HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.translate[0] = WIDTH / 2.0f;
+	p->viewport.translate[1] = HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+	p->viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	p->viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	p->viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	p->viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+	for (unsigned i = 0; i < 2; i++) {
+		p->velem.velems[i].src_offset = i * 4 * sizeof(float);
+		p->velem.velems[i].vertex_buffer_index = 0;
+		p->velem.velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+		p->velem.velems[i].src_stride = 2 * 4 * sizeof(float);
+	}
+
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, false);
+	}
+
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+		TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, true);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+}
+
+static void draw_frame(struct program *p)
+{
+	struct pipe_fence_handle *fence = NULL;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, NULL, &p->clear_color, 0, 0);
+
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+
+	util_draw_vertex_buffer(p->pipe, p->cso, p->vbuf, 0,
+				MESA_PRIM_TRIANGLES,
+				NUM_TRIS * 3, /* verts */
+				2);           /* attribs/vert */
+
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, OS_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned max_threads, frames;
+
+	max_threads = argc > 1 ? atoi(argv[1]) : util_get_cpu_caps()->nr_cpus;
+	frames = argc > 2 ? atoi(argv[2]) : 50;
+
+	printf("%dx%d, %u blended triangles/frame, %u frames\n",
+	       WIDTH, HEIGHT, NUM_TRIS, frames);
+	printf("threads      fps  speedup\n");
+
+	double base_fps = 0.0;
+	for (unsigned threads = 1; threads <= MAX2(max_threads, 1); threads++) {
+		struct program prog;
+		char value[16];
+
+		memset(&prog, 0, sizeof(prog));
+		snprintf(value, sizeof(value), "%u", threads);
+		setenv("LP_NUM_THREADS", value, 1);
+
+		init_prog(&prog);
+
+		/* warm up, so shader compilation isn't measured */
+		draw_frame(&prog);
+
+		int64_t start = os_time_get_nano();
+		for (unsigned f = 0; f < frames; f++)
+			draw_frame(&prog);
+		int64_t end = os_time_get_nano();
+
+		double fps = frames * 1e9 / (double)(end - start);
+		if (threads == 1)
+			base_fps = fps;
+		printf("%7u %8.2f %7.2fx\n", threads, fps, fps / base_fps);
+
+		close_prog(&prog);
+	}
+
+	return 0;
+}
@@ -137,6 +137,9 @@ push_descriptors_set_free(struct vk_cmd_queue *queue,
     case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
        vk_free(queue->alloc, (void *)entry->pTexelBufferView);
        break;
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+       vk_free(queue->alloc, (void *)entry->pNext);
+       break;
     case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
     case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
     case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
@@ -210,6 +213,29 @@ vk_cmd_enqueue_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
                    pDescriptorWrites[i].pTexelBufferView,
                    sizeof(VkBufferView) * pds->descriptor_writes[i].descriptorCount);
             break;
+         case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR: {
+            const VkWriteDescriptorSetAccelerationStructureKHR *accel_structs =
+               vk_find_struct_const(pDescriptorWrites[i].pNext, WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR);
+            uint32_t count = pds->descriptor_writes[i].descriptorCount;
+            VkWriteDescriptorSetAccelerationStructureKHR *copy =
+               vk_zalloc(cmd_buffer->cmd_queue.alloc,
+                         sizeof(*copy) + sizeof(VkAccelerationStructureKHR) * count, 8,
+                         VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+            if (!copy) {
+               /* Don't leave the application's struct for the free callback. */
+               pds->descriptor_writes[i].pNext = NULL;
+               vk_command_buffer_set_error(cmd_buffer, VK_ERROR_OUT_OF_HOST_MEMORY);
+               break;
+            }
+            copy->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+            copy->accelerationStructureCount = count;
+            copy->pAccelerationStructures = (const void *)(copy + 1);
+            memcpy((VkAccelerationStructureKHR *)copy->pAccelerationStructures,
+                   accel_structs->pAccelerationStructures,
+                   sizeof(VkAccelerationStructureKHR) * count);
+            pds->descriptor_writes[i].pNext = copy;
+            break;
+         }
          case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
          case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
          case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC: